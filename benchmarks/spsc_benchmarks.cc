@@ -5,17 +5,48 @@
 #include "boost_spsc/sender.hh"
 #include "fixed_size/receiver/receiver.hh"
 #include "fixed_size/sender/sender.hh"
+#include "variable_size/receiver/receiver.hh"
+#include "variable_size/sender/sender.hh"
+#include "packed/receiver/receiver.hh"
+#include "packed/sender/sender.hh"
+#include "mpsc/receiver/receiver.hh"
+#include "mpsc/sender/sender.hh"
+#include "broadcast/receiver/receiver.hh"
+#include "broadcast/sender/sender.hh"
+#include "spmc/receiver/receiver.hh"
+#include "spmc/sender/sender.hh"
+#include "mpmc/receiver/receiver.hh"
+#include "mpmc/sender/sender.hh"
+#include "lossy/receiver/receiver.hh"
+#include "lossy/sender/sender.hh"
+#include "snapshot/receiver/receiver.hh"
+#include "snapshot/sender/sender.hh"
+#include "conflating/receiver/receiver.hh"
+#include "conflating/sender/sender.hh"
+#include "lanes/receiver/receiver.hh"
+#include "lanes/sender/sender.hh"
+#include "mux/koi_mux/koi_mux.hh"
 #include "utils.hh"
+#include "koi_affinity.hh"
 
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/spdlog.h>
 #include <benchmark/benchmark.h>
+#include <poll.h>
+#include <sys/resource.h>
 #include <cassert>
 #include <iostream>
 #include <thread>
+#include <array>
 #include <atomic>
 #include <optional>
 #include <chrono>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 template <size_t message_size>
 struct Message
@@ -34,6 +65,56 @@ std::ostream &operator<<(std::ostream &os, Message<message_size> &msg)
     return os;
 }
 
+// Number of messages held by a Koi queue of `queue_bytes`, used as the compile time `Capacity` of
+// the Koi queue variants which are benchmarked next to the runtime sized queue
+template <size_t queue_bytes, size_t message_size>
+constexpr size_t koi_capacity = queue_bytes / KoiQueue<Message<message_size>>::message_block_sz_bytes();
+template <size_t queue_bytes, size_t message_size>
+using StaticKoiSender = koi::KoiSender<Message<message_size>, koi_capacity<queue_bytes, message_size>>;
+template <size_t queue_bytes, size_t message_size>
+using StaticKoiReceiver = koi::KoiReceiver<Message<message_size>, koi_capacity<queue_bytes, message_size>>;
+
+// Koi configured with `KoiQueueOptions`: the sender probes `lookahead` slots ahead for free space and the receiver
+// releases consumed slots in groups of `release_batch`
+template <typename T, size_t lookahead>
+class LookaheadKoiSender : public koi::KoiSender<T>
+{
+public:
+    LookaheadKoiSender(const std::string name, size_t buffer_bytes)
+        : koi::KoiSender<T>(name, buffer_bytes, KoiQueueOptions{.send_lookahead = lookahead})
+    {
+    }
+};
+template <typename T, size_t release_batch>
+class BatchedReleaseKoiReceiver : public koi::KoiReceiver<T>
+{
+public:
+    BatchedReleaseKoiReceiver(const std::string name, size_t buffer_bytes)
+        : koi::KoiReceiver<T>(name, buffer_bytes, KoiQueueOptions{.release_batch = release_batch})
+    {
+    }
+};
+
+// Koi with both sides mapping the segment prefaulted, with or without huge pages
+template <typename T, bool huge_pages>
+class MappedKoiSender : public koi::KoiSender<T>
+{
+public:
+    MappedKoiSender(const std::string name, size_t buffer_bytes)
+        : koi::KoiSender<T>(name, buffer_bytes, KoiQueueOptions{.mapping = {.huge_pages = huge_pages, .prefault = true}})
+    {
+    }
+};
+template <typename T, bool huge_pages>
+class MappedKoiReceiver : public koi::KoiReceiver<T>
+{
+public:
+    MappedKoiReceiver(const std::string name, size_t buffer_bytes)
+        : koi::KoiReceiver<T>(name, buffer_bytes, KoiQueueOptions{.mapping = {.huge_pages = huge_pages, .prefault = true}})
+    {
+    }
+};
+
 // Randomly generated name for the queue, unique to each benchmark
 std::string shm_name;
 
@@ -82,11 +163,74 @@ void BM_SingleThread_Empty_PingPong(benchmark::State &state)
 
 // Indicates sender is done setting up. Sender must be initialized before the receiver in some implementations
 std::atomic<bool> two_thread_setup_done = false;
+// Set by receivers which must finish their own setup before the sender starts
+std::atomic<bool> receiver_setup_done = false;
+// Number of receivers which have attached, for benchmarks with several receivers
+std::atomic<int> receivers_attached = 0;
+// Number of threads which have tried to pin themselves, and whether any of them failed, so all threads skip together
+std::atomic<int> threads_pinned = 0;
+std::atomic<bool> pin_failed = false;
 
 static void TeardownTwoThread(const benchmark::State &state)
 {
     // Reset the setup done flag
     two_thread_setup_done = false;
+    receiver_setup_done = false;
+    receivers_attached = 0;
+    threads_pinned = 0;
+    pin_failed = false;
+}
+
+// Benchmarks creating a queue with a ring of `state.range(0)` bytes, which should take constant time.
+// Destroying the queue and unlinking its segment is not timed.
+template <size_t message_size>
+void BM_Startup(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    const size_t queue_size = static_cast<size_t>(state.range(0));
+    size_t created = 0;
+    for (auto _ : state)
+    {
+        std::optional<KoiQueueRAII<Message<message_size>>> queue;
+        queue.emplace(shm_name + "_" + std::to_string(created++), queue_size);
+        benchmark::DoNotOptimize(queue->capacity());
+        state.PauseTiming();
+        queue.reset();
+        state.ResumeTiming();
+    }
+}
+
+// Benchmarks the first lap around a freshly created queue: each iteration creates a new segment of `queue_size`
+// bytes, then sends and receives one message per slot. Without `prefault` every slot's page is faulted in on the
+// hot path, and with `huge_pages` there are 512 times fewer pages to fault and to cache in the TLB.
+// Creating and cleaning up the segment is not timed. Throughput is reported as messages / sec (`items_per_second`).
+template <size_t queue_size, size_t message_size, bool huge_pages, bool prefault>
+void BM_SingleThread_FirstLap(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    const KoiQueueOptions options{.mapping = {.huge_pages = huge_pages, .prefault = prefault}};
+    Message<message_size> msg = {};
+    size_t lap = 0;
+    size_t capacity = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        {
+            KoiQueueRAII<Message<message_size>> queue(shm_name + "_" + std::to_string(lap++), queue_size, options);
+            capacity = queue.capacity();
+            state.ResumeTiming();
+            for (size_t i = 0; i < capacity; i++)
+            {
+                queue.send(msg);
+                benchmark::DoNotOptimize(queue.recv());
+            }
+            state.PauseTiming();
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * capacity);
 }
 
 // Benchmarks high contention for read and write in an empty queue
@@ -166,6 +310,178 @@ void BM_TwoThread_Empty_PingPong(benchmark::State &state)
     }
 }
 
+// Benchmarks the empty queue ping pong where the sender encodes a new message on every iteration.
+// With `zero_copy` the message is encoded directly into the shared memory slot with `reserve()`/`commit()`,
+// otherwise it is encoded on the stack and copied in by `send()`.
+template <typename Tx, typename Rx, size_t queue_size, size_t message_size, bool zero_copy>
+void BM_TwoThread_Empty_Encode_PingPong(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+
+    spdlog::info("Running encode ping-pong benchmark with message size: {}, queue size: {}, zero copy: {}, and test name {}",
+                 message_size, queue_size, zero_copy, shm_name);
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{Tx(shm_name, queue_size)};
+        two_thread_setup_done = true;
+
+        unsigned char fill = 0;
+        for (auto _ : state)
+        {
+            fill++;
+            if constexpr (zero_copy)
+            {
+                Message<message_size> *slot;
+                while ((slot = sender.reserve()) == nullptr)
+                {
+                }
+                std::memset(slot->data, fill, message_size);
+                sender.commit();
+            }
+            else
+            {
+                Message<message_size> msg;
+                std::memset(msg.data, fill, message_size);
+                while (!sender.send(msg))
+                {
+                }
+            }
+            while (sender.size() > 0)
+            {
+                // If the receiver is slow, yield to let receiver run
+                // to keep the queue empty
+                std::this_thread::yield();
+            }
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{Rx(shm_name, queue_size)};
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            do
+            {
+                received = receiver.recv();
+            } while (!received.has_value());
+            // The whole message was written with the same byte
+            ASSERT(received.value().data[0] == received.value().data[message_size - 1]);
+            benchmark::DoNotOptimize(received);
+        }
+        ASSERT(receiver.size() == 0);
+    }
+}
+
+// How the receiver reads messages in `BM_TwoThread_Empty_Recv_PingPong`
+enum class RecvMode
+{
+    // `recv()`, copying the message into a `std::optional`
+    COPY_OPTIONAL,
+    // `recv_into()`, copying the message into a caller provided message
+    COPY_INTO,
+    // `peek()`/`release()`, reading the message in place
+    ZERO_COPY,
+};
+
+// Benchmarks the empty queue ping pong for large messages, comparing ways for the receiver to read a message.
+// The receiver reads every byte of the message, in place for `RecvMode::ZERO_COPY`.
+// The sender writes messages in place with `reserve()`/`commit()` so the sender side does not copy.
+template <typename Tx, typename Rx, size_t queue_size, size_t message_size, RecvMode recv_mode>
+void BM_TwoThread_Empty_Recv_PingPong(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+
+    spdlog::info("Running recv ping-pong benchmark with message size: {}, queue size: {}, and test name {}",
+                 message_size, queue_size, shm_name);
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{Tx(shm_name, queue_size)};
+        two_thread_setup_done = true;
+
+        for (auto _ : state)
+        {
+            Message<message_size> *slot;
+            while ((slot = sender.reserve()) == nullptr)
+            {
+            }
+            std::memset(slot->data, 1, message_size);
+            sender.commit();
+            while (sender.size() > 0)
+            {
+                // If the receiver is slow, yield to let receiver run
+                // to keep the queue empty
+                std::this_thread::yield();
+            }
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{Rx(shm_name, queue_size)};
+        // Heap allocated since the largest messages approach `MAX_MESSAGE_SIZE_BYTES`
+        auto received = std::make_unique<Message<message_size>>();
+        for (auto _ : state)
+        {
+            unsigned int sum = 0;
+            if constexpr (recv_mode == RecvMode::COPY_OPTIONAL)
+            {
+                std::optional<Message<message_size>> msg;
+                do
+                {
+                    msg = receiver.recv();
+                } while (!msg.has_value());
+                sum = std::accumulate(msg->data, msg->data + message_size, 0u);
+            }
+            else if constexpr (recv_mode == RecvMode::COPY_INTO)
+            {
+                while (!receiver.recv_into(*received))
+                {
+                }
+                sum = std::accumulate(received->data, received->data + message_size, 0u);
+            }
+            else
+            {
+                const Message<message_size> *view;
+                while ((view = receiver.peek()) == nullptr)
+                {
+                }
+                sum = std::accumulate(view->data, view->data + message_size, 0u);
+                receiver.release();
+            }
+            ASSERT(sum == message_size);
+            benchmark::DoNotOptimize(sum);
+        }
+        ASSERT(receiver.size() == 0);
+    }
+}
+
 // Benchmarks low contention for a partially full (ranges from 1/4 to 3/4 full) queue
 template <typename Tx, typename Rx, size_t queue_size, size_t message_size>
 void BM_TwoThread_PartialFill_PingPong(benchmark::State &state)
@@ -307,10 +623,24 @@ void BM_TwoThread_Full_PingPong(benchmark::State &state)
         {
         }
         auto receiver{Rx(shm_name, queue_size)};
+        // Koi receivers may defer releasing consumed slots (see `KoiQueueOptions::release_batch`), so the sender
+        // can find the queue full before `size()` reaches `capacity()`
+        auto is_full = [&receiver]()
+        {
+            if constexpr (requires { receiver.is_full(); })
+            {
+                return receiver.is_full();
+            }
+            else
+            {
+                return receiver.size() >= receiver.capacity();
+            }
+        };
+        benchmark::IterationCount iteration = 0;
         for (auto _ : state)
         {
             // If the queue is not full, yield to let sender run
-            while (receiver.size() < receiver.capacity())
+            while (!is_full())
             {
                 std::this_thread::yield();
             }
@@ -331,6 +661,15 @@ void BM_TwoThread_Full_PingPong(benchmark::State &state)
                     throw std::runtime_error("Received message does not match sent message");
                 }
             }
+            // The sender's last sends wait on slots whose release is deferred, so hand them back before the
+            // receiver leaves the benchmark loop
+            if constexpr (requires { receiver.flush_releases(); })
+            {
+                if (++iteration == state.max_iterations)
+                {
+                    receiver.flush_releases();
+                }
+            }
         }
         // After the receiver is done, the queue should be full
         // ASSERT(receiver.size() == receiver.capacity());
@@ -338,118 +677,1472 @@ void BM_TwoThread_Full_PingPong(benchmark::State &state)
     }
 }
 
-// // Single Threaded
-// // Boost Lock Buffer
-// #define BOOST_SINGLETHREAD_BENCH(queue_size, message_size)            \
-//     BENCHMARK(BM_SingleThread_Empty_PingPong<                         \
-//                   boost_lock_buffer::Sender<Message<message_size>>,   \
-//                   boost_lock_buffer::Receiver<Message<message_size>>, \
-//                   queue_size,                                         \
-//                   message_size>)                                      \
-//         ->Setup(SetupBench);
-
-// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 2)
-// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 6)
-// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 8)
-// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 12)
-// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 2)
-// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 6)
-// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 8)
-// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 12)
-
-// // Boost SPSC Lock Free
-// #define BOOST_SPSC_SINGLETHREAD_BENCH(queue_size, message_size) \
-//     BENCHMARK(BM_SingleThread_Empty_PingPong<                   \
-//                   boost_spsc::Sender<Message<message_size>>,    \
-//                   boost_spsc::Receiver<Message<message_size>>,  \
-//                   queue_size,                                   \
-//                   message_size>)                                \
-//         ->Setup(SetupBench);
-
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 2)
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 6)
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 8)
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 12)
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 2)
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 6)
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 8)
-// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 12)
+// Benchmarks streaming throughput where the sender and receiver move `state.range(0)` messages per iteration.
+// With `use_batch_api` the run is moved with `send_batch()`/`recv_batch()`, otherwise with one `send()`/`recv()`
+// per message. Throughput is reported as messages / sec (`items_per_second`).
+template <typename Tx, typename Rx, size_t queue_size, size_t message_size, bool use_batch_api>
+void BM_TwoThread_Batch_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
 
-// // Koi
-// #define KOI_SINGLETHREAD_BENCH(queue_size, message_size)   \
-//     BENCHMARK(BM_SingleThread_Empty_PingPong<              \
-//                   koi::KoiSender<Message<message_size>>,   \
-//                   koi::KoiReceiver<Message<message_size>>, \
-//                   queue_size,                              \
-//                   message_size>)                           \
-//         ->Setup(SetupBench);
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+    const size_t batch_size = static_cast<size_t>(state.range(0));
 
-// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 2)
-// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 6)
-// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 8)
-// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 12)
-// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 2)
-// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 6)
-// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 8)
-// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 12)
+    spdlog::info("Running batch throughput benchmark with message size: {}, queue size: {}, batch size: {}, and test name {}",
+                 message_size, queue_size, batch_size, shm_name);
 
-// Multi Threaded
-// Empty
-// Note that Koi takes a queue_size in bytes while the others take the number of elements
-#define EMPTY_MULTITHREAD_BENCH(queue_size, message_size)         \
-    BENCHMARK(BM_TwoThread_Empty_PingPong<                        \
-                  boost_spsc::Sender<Message<message_size>>,      \
-                  boost_spsc::Receiver<Message<message_size>>,    \
-                  queue_size,                                     \
-                  message_size>)                                  \
-        ->Threads(2)                                              \
-        ->Setup(SetupBench)                                       \
-        ->Teardown(TeardownTwoThread);                            \
-                                                                  \
-    BENCHMARK(BM_TwoThread_Empty_PingPong<                        \
-                  koi::KoiSender<Message<message_size>>,          \
-                  koi::KoiReceiver<Message<message_size>>,        \
-                  static_cast<size_t>(queue_size) * message_size, \
-                  message_size>)                                  \
-        ->Threads(2)                                              \
-        ->Setup(SetupBench)                                       \
-        ->Teardown(TeardownTwoThread);
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
 
-EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 4) // 16
-EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 5) // 32
-EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 6) // 64
-EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 7) // 128
+    std::vector<Message<message_size>> msgs(batch_size);
+    for (auto &msg : msgs)
+    {
+        for (size_t i = 0; i < message_size; i++)
+        {
+            msg.data[i] = 1;
+        }
+    }
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{Tx(shm_name, queue_size)};
+        two_thread_setup_done = true;
 
-// Partial Fill
+        for (auto _ : state)
+        {
+            // Retry until the whole batch has been sent
+            if constexpr (use_batch_api)
+            {
+                std::span<const Message<message_size>> remaining(msgs);
+                while (!remaining.empty())
+                {
+                    remaining = remaining.subspan(sender.send_batch(remaining));
+                }
+            }
+            else
+            {
+                for (const auto &msg : msgs)
+                {
+                    while (!sender.send(msg))
+                    {
+                    }
+                }
+            }
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{Rx(shm_name, queue_size)};
+        std::vector<Message<message_size>> received(batch_size);
+        for (auto _ : state)
+        {
+            size_t num_received = 0;
+            while (num_received < batch_size)
+            {
+                if constexpr (use_batch_api)
+                {
+                    num_received += receiver.recv_batch(std::span(received).subspan(num_received));
+                }
+                else
+                {
+                    std::optional<Message<message_size>> msg = receiver.recv();
+                    if (msg.has_value())
+                    {
+                        received[num_received++] = msg.value();
+                    }
+                }
+            }
+            // Confirm the receiver received correct messages
+            for (size_t i = 0; i < message_size; i++)
+            {
+                ASSERT(received[batch_size - 1].data[i] == msgs[batch_size - 1].data[i]);
+            }
+        }
+        // Only the receiver reports, otherwise the sender's messages would be double counted
+        state.SetItemsProcessed(state.iterations() * batch_size);
+        ASSERT(receiver.size() == 0);
+    }
+}
+
+// Benchmarks streaming throughput and memory footprint of a queue of `capacity` messages, one message per iteration.
+// `Tx` and `Rx` may have a compile time capacity. The ring buffer size is reported as `ring_bytes`.
+// Throughput is reported as messages / sec (`items_per_second`).
+template <typename Tx, typename Rx, size_t message_size, size_t capacity>
+void BM_TwoThread_Capacity_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    Message<message_size> msg = {};
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{Tx(shm_name, QueueCapacity{capacity})};
+        two_thread_setup_done = true;
+
+        for (auto _ : state)
+        {
+            while (!sender.send(msg))
+            {
+            }
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{Rx(shm_name, QueueCapacity{capacity})};
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receiver.recv()))
+            {
+            }
+            benchmark::DoNotOptimize(received);
+        }
+        // Only the receiver reports, otherwise the sender's messages would be double counted
+        state.SetItemsProcessed(state.iterations());
+        state.counters["ring_bytes"] = static_cast<double>(receiver.user_shm_size());
+    }
+}
+
+// Benchmarks streaming throughput of tiny messages, one message per iteration, through a `queue_size` byte ring.
+// Compares `KoiQueue`, which takes a cache line sized block per message, against `KoiPackedQueue`, which packs
+// many messages into each line. Throughput is reported as bytes / sec of payload (`bytes_per_second`).
+template <typename Tx, typename Rx, size_t queue_size, size_t message_size>
+void BM_TwoThread_Tiny_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    Message<message_size> msg = {};
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{Tx(shm_name, queue_size)};
+        two_thread_setup_done = true;
+
+        benchmark::IterationCount sent = 0;
+        for (auto _ : state)
+        {
+            while (!sender.send(msg))
+            {
+            }
+            // A packed sender only publishes full lines, so publish the tail before the receiver waits on it.
+            // This has to happen inside the loop, both threads wait for each other once the loop ends
+            if constexpr (requires { sender.flush(); })
+            {
+                if (++sent == state.max_iterations)
+                {
+                    sender.flush();
+                }
+            }
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{Rx(shm_name, queue_size)};
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receiver.recv()))
+            {
+            }
+            benchmark::DoNotOptimize(received);
+        }
+        // Only the receiver reports, otherwise the sender's messages would be double counted
+        state.SetBytesProcessed(state.iterations() * message_size);
+    }
+}
+
+// Benchmarks blocking `send_wait`/`recv_wait` on bursty traffic: the sender sleeps for `state.range(0)`
+// microseconds between messages, so the receiver spends most of its time waiting.
+// The CPU time column shows how much CPU each wait strategy burns while the queue is idle.
+template <size_t queue_size, size_t message_size, WaitStrategy strategy>
+void BM_TwoThread_Bursty_Wait(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    const KoiQueueOptions options{.wait_strategy = strategy};
+    const auto idle_time = std::chrono::microseconds(state.range(0));
+    Message<message_size> msg = {};
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{koi::KoiSender<Message<message_size>>(shm_name, queue_size, options)};
+        two_thread_setup_done = true;
+
+        for (auto _ : state)
+        {
+            std::this_thread::sleep_for(idle_time);
+            sender.send_wait(msg);
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiReceiver<Message<message_size>>(shm_name, queue_size, options)};
+        for (auto _ : state)
+        {
+            auto received = receiver.recv_wait();
+            ASSERT(received.has_value());
+        }
+    }
+}
+
+// Benchmarks the latency from a send to the receiver observing it after an idle gap of `state.range(0)`
+// microseconds. With `use_notify_fd` the receiver sleeps in `poll` on `notify_fd` while the queue is empty,
+// otherwise it busy polls `recv`. The average send to receive latency is reported as `wakeup_ns`.
+template <size_t queue_size, size_t message_size, bool use_notify_fd>
+void BM_TwoThread_Wakeup_Latency(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+    static_assert(message_size >= sizeof(int64_t), "Message must hold a timestamp");
+    using clock = std::chrono::steady_clock;
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    const auto idle_time = std::chrono::microseconds(state.range(0));
+    Message<message_size> msg = {};
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{koi::KoiSender<Message<message_size>>(shm_name, queue_size)};
+        two_thread_setup_done = true;
+        // The receiver must register its descriptor before the first send
+        while (!receiver_setup_done)
+        {
+        }
+
+        for (auto _ : state)
+        {
+            std::this_thread::sleep_for(idle_time);
+            const int64_t sent_ns = clock::now().time_since_epoch().count();
+            std::memcpy(msg.data, &sent_ns, sizeof(sent_ns));
+            while (sender.send(msg) != KoiQueueRet::OK)
+            {
+            }
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiReceiver<Message<message_size>>(shm_name, queue_size)};
+        int fd = -1;
+        if constexpr (use_notify_fd)
+        {
+            fd = receiver.notify_fd();
+        }
+        receiver_setup_done = true;
+
+        int64_t total_latency_ns = 0;
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receiver.recv()))
+            {
+                if constexpr (use_notify_fd)
+                {
+                    if (receiver.arm_notify())
+                    {
+                        struct pollfd pfd = {fd, POLLIN, 0};
+                        poll(&pfd, 1, -1);
+                    }
+                }
+            }
+            int64_t sent_ns;
+            std::memcpy(&sent_ns, received->data, sizeof(sent_ns));
+            total_latency_ns += clock::now().time_since_epoch().count() - sent_ns;
+        }
+        state.counters["wakeup_ns"] = benchmark::Counter(static_cast<double>(total_latency_ns),
+                                                         benchmark::Counter::kAvgIterations);
+    }
+}
+
+// Benchmarks the round trip latency of a message and its echo between two threads pinned to a pair of CPUs
+// `distance` apart in the cache hierarchy. Unpinned threads float between such pairs, which is a large source
+// of run to run variance in the other two thread benchmarks. The pair is reported in the label, and the
+// benchmark is skipped if the machine has no pair at `distance`.
+template <size_t queue_size, size_t message_size, CpuDistance distance>
+void BM_TwoThread_Placement_RoundTrip(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    // Both threads find the same pair, so both skip together if there is none
+    const std::optional<CpuTopology::CpuPair> pair = CpuTopology::probe().find_pair(distance);
+    if (!pair.has_value())
+    {
+        state.SkipWithError(("No CPU pair at distance " + to_string(distance)).c_str());
+        return;
+    }
+    // Thread 0 runs on the benchmark's main thread, so its affinity is restored for the following benchmarks
+    const std::vector<int> previous_cpus = current_thread_cpus();
+    const int cpu = state.thread_index() == SENDER_THREAD_ID ? pair->first : pair->second;
+    if (!pin_current_thread(cpu))
+    {
+        pin_failed = true;
+    }
+    // A thread which skipped alone would leave its peer waiting for it forever, so agree before setting up
+    threads_pinned++;
+    while (threads_pinned != state.threads())
+    {
+    }
+    if (pin_failed)
+    {
+        state.SkipWithError(("Failed to pin to CPUs " + std::to_string(pair->first) + "," + std::to_string(pair->second)).c_str());
+        pin_current_thread(previous_cpus);
+        return;
+    }
+
+    const std::string ping_name = shm_name + "_ping";
+    const std::string pong_name = shm_name + "_pong";
+    Message<message_size> msg = {};
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto ping{koi::KoiSender<Message<message_size>>(ping_name, queue_size)};
+        auto pong{koi::KoiReceiver<Message<message_size>>(pong_name, queue_size)};
+        two_thread_setup_done = true;
+
+        for (auto _ : state)
+        {
+            while (!ping.send(msg))
+            {
+            }
+            std::optional<Message<message_size>> echo;
+            while (!(echo = pong.recv()))
+            {
+            }
+            benchmark::DoNotOptimize(echo);
+        }
+        state.SetLabel(to_string(distance) + " cpus " + std::to_string(pair->first) + "," + std::to_string(pair->second));
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto ping{koi::KoiReceiver<Message<message_size>>(ping_name, queue_size)};
+        auto pong{koi::KoiSender<Message<message_size>>(pong_name, queue_size)};
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = ping.recv()))
+            {
+            }
+            while (!pong.send(received.value()))
+            {
+            }
+        }
+    }
+    pin_current_thread(previous_cpus);
+}
+
+// Benchmarks fan in throughput from `state.threads() - 1` producers to one consumer (thread 0) through a single
+// `KoiMpscQueue`. Each producer sends one message per iteration and the consumer receives one message from every
+// producer per iteration. Throughput is reported as messages / sec (`items_per_second`).
+template <size_t queue_size, size_t message_size>
+void BM_MultiThread_Mpsc_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int RECEIVER_THREAD_ID = 0;
+    const size_t num_producers = state.threads() - 1;
+
+    Message<message_size> msg = {};
+    if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        auto receiver{koi::KoiMpscReceiver<Message<message_size>>(shm_name, queue_size)};
+        two_thread_setup_done = true;
+
+        for (auto _ : state)
+        {
+            for (size_t i = 0; i < num_producers; ++i)
+            {
+                std::optional<Message<message_size>> received;
+                while (!(received = receiver.recv()))
+                {
+                }
+                benchmark::DoNotOptimize(received);
+            }
+        }
+        // Only the receiver reports, otherwise the producers' messages would be double counted
+        state.SetItemsProcessed(state.iterations() * num_producers);
+        state.counters["producers"] = static_cast<double>(num_producers);
+    }
+    else
+    {
+        // Wait for the receiver to create the queue before the producers attach
+        while (!two_thread_setup_done)
+        {
+        }
+        auto sender{koi::KoiMpscSender<Message<message_size>>(shm_name, queue_size)};
+        for (auto _ : state)
+        {
+            while (!sender.send(msg))
+            {
+            }
+        }
+    }
+}
+
+// The baseline for `BM_MultiThread_Mpsc_Throughput`: each producer has its own `KoiQueue` of `queue_size` bytes,
+// and the consumer polls them round robin until it has received one message from every producer.
+template <size_t queue_size, size_t message_size>
+void BM_MultiThread_Spsc_Fan_In_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int RECEIVER_THREAD_ID = 0;
+    const size_t num_producers = state.threads() - 1;
+
+    Message<message_size> msg = {};
+    if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        std::vector<koi::KoiReceiver<Message<message_size>>> receivers;
+        receivers.reserve(num_producers);
+        for (size_t i = 0; i < num_producers; ++i)
+        {
+            receivers.emplace_back(shm_name + "_" + std::to_string(i), queue_size);
+        }
+        two_thread_setup_done = true;
+
+        size_t next = 0;
+        for (auto _ : state)
+        {
+            size_t received_count = 0;
+            while (received_count < num_producers)
+            {
+                std::optional<Message<message_size>> received = receivers[next].recv();
+                if (received.has_value())
+                {
+                    benchmark::DoNotOptimize(received);
+                    ++received_count;
+                }
+                next = next + 1 == num_producers ? 0 : next + 1;
+            }
+        }
+        // Only the receiver reports, otherwise the producers' messages would be double counted
+        state.SetItemsProcessed(state.iterations() * num_producers);
+        state.counters["producers"] = static_cast<double>(num_producers);
+    }
+    else
+    {
+        // Wait for the receiver to create the queues before the producers attach
+        while (!two_thread_setup_done)
+        {
+        }
+        auto sender{koi::KoiSender<Message<message_size>>(shm_name + "_" + std::to_string(state.thread_index() - 1), queue_size)};
+        for (auto _ : state)
+        {
+            while (!sender.send(msg))
+            {
+            }
+        }
+    }
+}
+
+// Benchmarks fan out throughput from one sender (thread 0) to `state.threads() - 1` receivers through a single
+// `KoiBroadcastQueue` in `GATED` mode. The sender sends one message per iteration and every receiver receives
+// every message. Throughput is reported as messages delivered / sec (`items_per_second`), i.e. sent messages
+// times the number of receivers.
+template <size_t queue_size, size_t message_size>
+void BM_MultiThread_Broadcast_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    const int num_receivers = state.threads() - 1;
+
+    Message<message_size> msg = {};
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{koi::KoiBroadcastSender<Message<message_size>>(shm_name, queue_size)};
+        two_thread_setup_done = true;
+        // Receivers only see messages sent after they attach
+        while (receivers_attached != num_receivers)
+        {
+        }
+
+        for (auto _ : state)
+        {
+            while (!sender.send(msg))
+            {
+            }
+        }
+        // Only the sender reports, otherwise the deliveries would be counted once per receiver thread
+        state.SetItemsProcessed(state.iterations() * num_receivers);
+        state.counters["receivers"] = static_cast<double>(num_receivers);
+    }
+    else
+    {
+        // Wait for the sender to create the queue before the receivers attach
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiBroadcastReceiver<Message<message_size>>(shm_name, queue_size)};
+        ++receivers_attached;
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receiver.recv()))
+            {
+            }
+            benchmark::DoNotOptimize(received);
+        }
+    }
+}
+
+// The baseline for `BM_MultiThread_Broadcast_Throughput`: the sender has one `KoiQueue` of `queue_size` bytes per
+// receiver and copies each message into every one of them.
+template <size_t queue_size, size_t message_size>
+void BM_MultiThread_Spsc_Fan_Out_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    const size_t num_receivers = state.threads() - 1;
+
+    Message<message_size> msg = {};
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        std::vector<koi::KoiSender<Message<message_size>>> senders;
+        senders.reserve(num_receivers);
+        for (size_t i = 0; i < num_receivers; ++i)
+        {
+            senders.emplace_back(shm_name + "_" + std::to_string(i), queue_size);
+        }
+        two_thread_setup_done = true;
+
+        for (auto _ : state)
+        {
+            for (auto &sender : senders)
+            {
+                while (!sender.send(msg))
+                {
+                }
+            }
+        }
+        // Only the sender reports, otherwise the deliveries would be counted once per receiver thread
+        state.SetItemsProcessed(state.iterations() * num_receivers);
+        state.counters["receivers"] = static_cast<double>(num_receivers);
+    }
+    else
+    {
+        // Wait for the sender to create the queues before the receivers attach
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiReceiver<Message<message_size>>(shm_name + "_" + std::to_string(state.thread_index() - 1), queue_size)};
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receiver.recv()))
+            {
+            }
+            benchmark::DoNotOptimize(received);
+        }
+    }
+}
+
+// Skewed per message processing cost for the work queue benchmarks: every `SKEWED_COST_PERIOD`th message costs
+// `SKEWED_SLOW_COST` units of work, the rest cost 1 unit. The cost is carried in the first byte of the message
+constexpr size_t SKEWED_COST_PERIOD = 16;
+constexpr unsigned char SKEWED_SLOW_COST = 64;
+constexpr size_t SPINS_PER_WORK_UNIT = 64;
+
+template <size_t message_size>
+void set_skewed_cost(Message<message_size> &msg, size_t sent)
+{
+    msg.data[0] = sent % SKEWED_COST_PERIOD == 0 ? SKEWED_SLOW_COST : 1;
+}
+
+template <size_t message_size>
+void process_skewed(const Message<message_size> &msg)
+{
+    for (size_t i = 0; i < msg.data[0] * SPINS_PER_WORK_UNIT; ++i)
+    {
+        benchmark::DoNotOptimize(i);
+    }
+}
+
+// Benchmarks distributing work from one producer (thread 0) to `state.threads() - 1` competing consumers through a
+// single `KoiSpmcQueue`, with skewed per message processing cost. The producer sends one message per consumer per
+// iteration and each consumer claims and processes one message per iteration, whichever consumer is free first.
+// Throughput is reported as messages / sec (`items_per_second`).
+template <size_t queue_size, size_t message_size>
+void BM_MultiThread_Spmc_Skewed_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    const size_t num_consumers = state.threads() - 1;
+
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{koi::KoiSpmcSender<Message<message_size>>(shm_name, queue_size)};
+        two_thread_setup_done = true;
+
+        Message<message_size> msg = {};
+        size_t sent = 0;
+        for (auto _ : state)
+        {
+            for (size_t i = 0; i < num_consumers; ++i)
+            {
+                set_skewed_cost(msg, sent++);
+                while (!sender.send(msg))
+                {
+                }
+            }
+        }
+        // Only the sender reports, otherwise the messages would be counted once per consumer thread
+        state.SetItemsProcessed(state.iterations() * num_consumers);
+        state.counters["consumers"] = static_cast<double>(num_consumers);
+    }
+    else
+    {
+        // Wait for the sender to create the queue before the consumers attach
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiSpmcReceiver<Message<message_size>>(shm_name, queue_size)};
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receiver.recv()))
+            {
+            }
+            process_skewed(received.value());
+        }
+    }
+}
+
+// The baseline for `BM_MultiThread_Spmc_Skewed_Throughput`: a dispatcher over one `KoiQueue` of `queue_size` bytes
+// per consumer, which sends the messages round robin and waits whenever the next consumer's queue is full.
+template <size_t queue_size, size_t message_size>
+void BM_MultiThread_Spsc_Dispatch_Skewed_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    const size_t num_consumers = state.threads() - 1;
+
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        std::vector<koi::KoiSender<Message<message_size>>> senders;
+        senders.reserve(num_consumers);
+        for (size_t i = 0; i < num_consumers; ++i)
+        {
+            senders.emplace_back(shm_name + "_" + std::to_string(i), queue_size);
+        }
+        two_thread_setup_done = true;
+
+        Message<message_size> msg = {};
+        size_t sent = 0;
+        for (auto _ : state)
+        {
+            for (auto &sender : senders)
+            {
+                set_skewed_cost(msg, sent++);
+                while (!sender.send(msg))
+                {
+                }
+            }
+        }
+        // Only the sender reports, otherwise the messages would be counted once per consumer thread
+        state.SetItemsProcessed(state.iterations() * num_consumers);
+        state.counters["consumers"] = static_cast<double>(num_consumers);
+    }
+    else
+    {
+        // Wait for the sender to create the queues before the consumers attach
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiReceiver<Message<message_size>>(shm_name + "_" + std::to_string(state.thread_index() - 1), queue_size)};
+        for (auto _ : state)
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receiver.recv()))
+            {
+            }
+            process_skewed(received.value());
+        }
+    }
+}
+
+// Benchmarks N:M throughput through a single queue shared by `state.range(0)` producers (threads 0 to N - 1) and
+// `state.threads() - state.range(0)` consumers. Each producer sends one message per consumer per iteration and each
+// consumer receives one message per producer per iteration, so both sides move the same number of messages.
+// `queue_arg` is passed to both constructors. Throughput is reported as messages / sec (`items_per_second`).
+template <typename Tx, typename Rx, size_t queue_arg, size_t message_size>
+void BM_MultiThread_NxM_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    const size_t num_producers = static_cast<size_t>(state.range(0));
+    const size_t num_consumers = state.threads() - num_producers;
+
+    Message<message_size> msg = {};
+    if (static_cast<size_t>(state.thread_index()) < num_producers)
+    {
+        // The first producer creates the queue before any other thread attaches
+        if (state.thread_index() != 0)
+        {
+            while (!two_thread_setup_done)
+            {
+            }
+        }
+        auto sender{Tx(shm_name, queue_arg)};
+        two_thread_setup_done = true;
+        for (auto _ : state)
+        {
+            for (size_t i = 0; i < num_consumers; ++i)
+            {
+                while (!sender.send(msg))
+                {
+                }
+            }
+        }
+        // Only the first producer reports, otherwise the messages would be counted once per thread
+        if (state.thread_index() == 0)
+        {
+            state.SetItemsProcessed(state.iterations() * num_producers * num_consumers);
+            state.counters["producers"] = static_cast<double>(num_producers);
+            state.counters["consumers"] = static_cast<double>(num_consumers);
+        }
+    }
+    else
+    {
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{Rx(shm_name, queue_arg)};
+        for (auto _ : state)
+        {
+            for (size_t i = 0; i < num_producers; ++i)
+            {
+                std::optional<Message<message_size>> received;
+                while (!(received = receiver.recv()))
+                {
+                }
+                benchmark::DoNotOptimize(received);
+            }
+        }
+    }
+}
+
+// How often the receiver of `BM_TwoThread_Stalled_Receiver_Send` stalls, and for how long
+constexpr size_t STALL_EVERY_RECVS = 1 << 10;
+constexpr std::chrono::microseconds STALL_DURATION(100);
+
+// Benchmarks the sender's latency per message while the receiver periodically stalls, e.g. a market data
+// consumer which is descheduled. A sender which finds the queue full spins until it has space, so with
+// `KoiSender` the stalls show up in the sender's latency, while `KoiLossySender` overwrites the oldest messages.
+// The receiver runs on its own `std::thread` until the sender is done, since it receives fewer messages than the
+// sender sends when they are overwritten. It reports the messages it lost as `lost`.
+template <typename Tx, typename Rx, size_t queue_size, size_t message_size>
+void BM_TwoThread_Stalled_Receiver_Send(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    auto sender{Tx(shm_name, queue_size)};
+    std::atomic<bool> sender_done = false;
+    uint64_t lost = 0;
+    auto receive = [&]()
+    {
+        auto receiver{Rx(shm_name, queue_size)};
+        size_t received = 0;
+        while (!sender_done)
+        {
+            std::optional<Message<message_size>> message = receiver.recv();
+            benchmark::DoNotOptimize(message);
+            if (message.has_value() && ++received % STALL_EVERY_RECVS == 0)
+            {
+                std::this_thread::sleep_for(STALL_DURATION);
+            }
+        }
+        if constexpr (requires { receiver.lost_messages(); })
+        {
+            lost = receiver.lost_messages();
+        }
+    };
+    std::thread receiver_thread(receive);
+
+    Message<message_size> msg = {};
+    for (auto _ : state)
+    {
+        while (!sender.send(msg))
+        {
+        }
+    }
+    sender_done = true;
+    receiver_thread.join();
+    state.counters["lost"] = static_cast<double>(lost);
+}
+
+// Benchmarks the latency of reading the latest value from a `KoiSnapshot`. With `concurrent_updates` a writer on
+// its own `std::thread` publishes back to back for the whole benchmark, so reads retry when a publish overlaps
+// them and the sequence and value lines move between the cores. Otherwise the value never changes after the
+// first publish. Reports the number of publishes during the benchmark as `publishes`.
+template <size_t message_size, bool concurrent_updates>
+void BM_Snapshot_Read(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    auto sender{koi::KoiSnapshotSender<Message<message_size>>(shm_name)};
+    auto receiver{koi::KoiSnapshotReceiver<Message<message_size>>(shm_name)};
+    sender.publish(Message<message_size>{});
+
+    std::atomic<bool> reads_done = false;
+    auto publish = [&]()
+    {
+        Message<message_size> msg = {};
+        while (!reads_done)
+        {
+            ++msg.data[0];
+            sender.publish(msg);
+        }
+    };
+    std::optional<std::thread> writer_thread;
+    if constexpr (concurrent_updates)
+    {
+        writer_thread.emplace(publish);
+    }
+
+    const uint64_t start_version = sender.version();
+    for (auto _ : state)
+    {
+        std::optional<Message<message_size>> value = receiver.read();
+        benchmark::DoNotOptimize(value);
+    }
+    reads_done = true;
+    if (writer_thread.has_value())
+    {
+        writer_thread->join();
+    }
+    state.counters["publishes"] = static_cast<double>(sender.version() - start_version);
+    sender.cleanup_shm();
+}
+
+// Bursty keyed feed for `BM_Bursty_Consumer_Work`: each burst sends `BURST_UPDATES` updates over `NUM_SYMBOLS`
+// keys, where all but every `BURST_COLD_PERIOD`th update goes to one of `BURST_HOT_SYMBOLS` hot keys
+constexpr uint32_t NUM_SYMBOLS = 5000;
+constexpr size_t BURST_UPDATES = 1 << 12;
+constexpr uint32_t BURST_HOT_SYMBOLS = 64;
+constexpr size_t BURST_COLD_PERIOD = 8;
+// Units of work the consumer spends on each message it receives, see `SPINS_PER_WORK_UNIT`
+constexpr size_t BURST_WORK_UNITS = 4;
+
+// Returns the key of the `sent`th update of the bursty feed, from a fixed pseudo random sequence
+inline uint32_t burst_key(size_t sent)
+{
+    const uint64_t hash = (sent + 1) * 0x9E3779B97F4A7C15ull;
+    const uint32_t bits = static_cast<uint32_t>(hash >> 32);
+    return sent % BURST_COLD_PERIOD == 0 ? bits % NUM_SYMBOLS : bits % BURST_HOT_SYMBOLS;
+}
+
+// Benchmarks a consumer which falls behind a bursty feed of per symbol updates, e.g. a market data handler which
+// only needs the latest quote of each symbol. Each iteration the producer sends a burst, then the consumer drains
+// the queue, spending `BURST_WORK_UNITS` of work per message. A `KoiConflatingQueue` coalesces the updates to
+// each symbol, so the consumer works once per updated symbol, while a plain `KoiQueue` of `KeyedValue`s delivers
+// every superseded update. `queue_size` sizes the plain queue and must hold a whole burst.
+// Reports the messages the consumer processed per burst as `consumed_per_burst`.
+template <bool conflating, size_t queue_size, size_t message_size>
+void BM_Bursty_Consumer_Work(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    using Update = KeyedValue<Message<message_size>>;
+    using Sender = std::conditional_t<conflating, koi::KoiConflatingSender<Message<message_size>>, koi::KoiSender<Update>>;
+    using Receiver = std::conditional_t<conflating, koi::KoiConflatingReceiver<Message<message_size>>, koi::KoiReceiver<Update>>;
+    constexpr size_t queue_arg = conflating ? NUM_SYMBOLS : queue_size;
+    static_assert(conflating || queue_size / KoiQueue<Update>::message_block_sz_bytes() >= BURST_UPDATES,
+                  "The plain queue must hold a whole burst");
+
+    auto sender{Sender(shm_name, queue_arg)};
+    auto receiver{Receiver(shm_name, queue_arg)};
+    Update update = {};
+    size_t sent = 0;
+    size_t consumed = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < BURST_UPDATES; ++i)
+        {
+            update.key = burst_key(sent);
+            update.value.data[0] = static_cast<unsigned char>(sent++);
+            if constexpr (conflating)
+            {
+                sender.send(update.key, update.value);
+            }
+            else
+            {
+                sender.send(update);
+            }
+        }
+        while (std::optional<Update> received = receiver.recv())
+        {
+            for (size_t spin = 0; spin < BURST_WORK_UNITS * SPINS_PER_WORK_UNIT; ++spin)
+            {
+                benchmark::DoNotOptimize(spin);
+            }
+            benchmark::DoNotOptimize(received);
+            ++consumed;
+        }
+    }
+    state.SetItemsProcessed(sent);
+    state.counters["consumed_per_burst"] = benchmark::Counter(static_cast<double>(consumed) / state.iterations());
+    sender.cleanup_shm();
+}
+
+// Lanes of `BM_Lane_Control_Latency`. Data messages cost the receiver `LANE_DATA_WORK_UNITS` of work each, see
+// `SPINS_PER_WORK_UNIT`, and `LaneSchedule::WEIGHTED` takes up to `LANE_DATA_WEIGHT` of them per control message
+constexpr size_t CONTROL_LANE = 0;
+constexpr size_t DATA_LANE = 1;
+constexpr size_t LANE_DATA_WORK_UNITS = 1;
+constexpr size_t LANE_DATA_WEIGHT = 8;
+// First byte of a control message, data messages are zero
+constexpr unsigned char CONTROL_MESSAGE_TAG = 1;
+
+// Benchmarks the latency of a control message (e.g. cancel all) while a flooding sender on its own `std::thread`
+// keeps the data lane of a `KoiLaneQueue` full, and the receiver on another `std::thread` works through the data.
+// Each iteration sends one control message on `control_lane` and waits until the receiver acknowledges it.
+// With `control_lane == DATA_LANE` the control message is handed to the flooding sender and queued behind the
+// data backlog, as in a single `KoiQueue`. Otherwise it is sent on its own lane, and `schedule` decides how soon
+// the receiver takes it. Reports the data messages received per control message as `data_per_control`.
+template <size_t control_lane, LaneSchedule schedule, size_t lane_capacity, size_t message_size>
+void BM_Lane_Control_Latency(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+    // The control sequence number is stored after the tag
+    static_assert(message_size >= 2 * sizeof(uint64_t), "The message must hold the tag and the sequence number");
+    constexpr size_t num_lanes = 2;
+
+    auto control_sender{koi::KoiLaneSender<Message<message_size>>(shm_name, num_lanes, lane_capacity)};
+    std::atomic<bool> control_done = false;
+    // Sequence number of the control message to be sent by the flooding sender, 0 if none
+    std::atomic<uint64_t> control_requested = 0;
+    std::atomic<uint64_t> control_acked = 0;
+    uint64_t data_received = 0;
+
+    auto control_message = [](uint64_t seq)
+    {
+        Message<message_size> msg = {};
+        msg.data[0] = CONTROL_MESSAGE_TAG;
+        std::memcpy(msg.data + sizeof(uint64_t), &seq, sizeof(seq));
+        return msg;
+    };
+    auto flood = [&]()
+    {
+        auto sender{koi::KoiLaneSender<Message<message_size>>(shm_name, num_lanes, lane_capacity)};
+        const Message<message_size> data = {};
+        while (!control_done)
+        {
+            if (uint64_t seq = control_requested.exchange(0))
+            {
+                while (sender.send(DATA_LANE, control_message(seq)) != KoiQueueRet::OK)
+                {
+                }
+            }
+            sender.send(DATA_LANE, data);
+        }
+    };
+    auto receive = [&]()
+    {
+        KoiLaneQueueOptions options{.schedule = schedule};
+        if constexpr (schedule == LaneSchedule::WEIGHTED)
+        {
+            options.weights = {1, LANE_DATA_WEIGHT};
+        }
+        auto receiver{koi::KoiLaneReceiver<Message<message_size>>(shm_name, num_lanes, lane_capacity, options)};
+        while (!control_done)
+        {
+            std::optional<Message<message_size>> msg = receiver.recv();
+            if (!msg.has_value())
+            {
+                continue;
+            }
+            if (msg->data[0] == CONTROL_MESSAGE_TAG)
+            {
+                uint64_t seq;
+                std::memcpy(&seq, msg->data + sizeof(uint64_t), sizeof(seq));
+                control_acked.store(seq, std::memory_order_release);
+                continue;
+            }
+            for (size_t spin = 0; spin < LANE_DATA_WORK_UNITS * SPINS_PER_WORK_UNIT; ++spin)
+            {
+                benchmark::DoNotOptimize(spin);
+            }
+            ++data_received;
+        }
+    };
+    std::thread receiver_thread(receive);
+    std::thread flood_thread(flood);
+
+    uint64_t seq = 0;
+    for (auto _ : state)
+    {
+        ++seq;
+        if constexpr (control_lane == DATA_LANE)
+        {
+            control_requested = seq;
+        }
+        else
+        {
+            while (control_sender.send(control_lane, control_message(seq)) != KoiQueueRet::OK)
+            {
+            }
+        }
+        while (control_acked.load(std::memory_order_acquire) != seq)
+        {
+        }
+    }
+    control_done = true;
+    flood_thread.join();
+    receiver_thread.join();
+    state.counters["data_per_control"] = benchmark::Counter(static_cast<double>(data_received) / state.iterations());
+    control_sender.cleanup_shm();
+}
+
+// Descriptors kept free for stdio, the benchmark library and the doorbell
+constexpr size_t fan_in_spare_descriptors = 64;
+
+// Raises the soft descriptor limit to the hard limit if it is below `descriptors`.
+// Returns whether `descriptors` are now allowed
+bool raise_descriptor_limit(size_t descriptors)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1)
+    {
+        return false;
+    }
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < descriptors)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) == -1)
+        {
+            return false;
+        }
+    }
+    return limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= descriptors;
+}
+
+// Benchmarks a receiver of `state.range(0)` queues, e.g. an aggregator of many feeds, where only one queue has a
+// message at a time. Each iteration sends one message to a pseudo random queue, then polls until it arrives.
+// With `doorbell` the senders ring a shared doorbell and the queues are read through a `koi::KoiMux`, which only
+// reads the queues rung in its doorbell.
+// Otherwise the receiver scans plain `KoiQueue` receivers round robin, reading the next slot of every empty queue on
+// the way, and reports the queues it read per message as `queues_read`. Each queue holds a sender and a receiver
+// descriptor, so 1024 queues need a descriptor limit above 2048. The soft limit is raised up to the hard limit, and
+// the case is skipped if that is still too few.
+template <bool doorbell, size_t queue_size, size_t message_size>
+void BM_Fan_In_Poll(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    const size_t num_sources = state.range(0);
+    if (!raise_descriptor_limit(2 * num_sources + fan_in_spare_descriptors))
+    {
+        state.SkipWithError(("Descriptor limit too low for " + std::to_string(num_sources) + " sources").c_str());
+        return;
+    }
+    std::vector<std::string> names;
+    for (size_t source = 0; source < num_sources; ++source)
+    {
+        names.push_back(shm_name + "_" + std::to_string(source));
+    }
+    using Sender = std::conditional_t<doorbell, koi::KoiMuxSender<Message<message_size>>, koi::KoiSender<Message<message_size>>>;
+    std::vector<std::unique_ptr<Sender>> senders;
+    for (size_t source = 0; source < num_sources; ++source)
+    {
+        if constexpr (doorbell)
+        {
+            senders.push_back(std::make_unique<Sender>(shm_name, num_sources, source, names[source], queue_size));
+        }
+        else
+        {
+            senders.push_back(std::make_unique<Sender>(names[source], queue_size));
+        }
+    }
+    std::optional<koi::KoiMux<Message<message_size>>> mux;
+    // Unlinked on destruction, so repeated runs do not accumulate descriptors
+    std::vector<std::unique_ptr<KoiQueueRAII<Message<message_size>>>> receivers;
+    if constexpr (doorbell)
+    {
+        mux.emplace(shm_name, names, queue_size);
+    }
+    else
+    {
+        for (const std::string &name : names)
+        {
+            receivers.push_back(std::make_unique<KoiQueueRAII<Message<message_size>>>(name, queue_size));
+        }
+    }
+
+    Message<message_size> msg = {};
+    size_t sent = 0;
+    size_t queues_read = 0;
+    size_t scan_source = 0;
+    for (auto _ : state)
+    {
+        // The same fixed pseudo random sequence as the bursty benchmarks
+        const size_t source = ((sent++ + 1) * 0x9E3779B97F4A7C15ull >> 32) % num_sources;
+        senders[source]->send(msg);
+        if constexpr (doorbell)
+        {
+            std::optional<koi::MuxMessage<Message<message_size>>> polled;
+            while (!(polled = mux->poll()).has_value())
+            {
+            }
+            benchmark::DoNotOptimize(polled);
+        }
+        else
+        {
+            std::optional<Message<message_size>> received;
+            while (!(received = receivers[scan_source]->recv()).has_value())
+            {
+                scan_source = scan_source + 1 == num_sources ? 0 : scan_source + 1;
+                ++queues_read;
+            }
+            benchmark::DoNotOptimize(received);
+            ++queues_read;
+        }
+    }
+    state.SetItemsProcessed(sent);
+    if constexpr (!doorbell)
+    {
+        state.counters["queues_read"] = benchmark::Counter(static_cast<double>(queues_read) / state.iterations());
+    }
+    for (auto &sender : senders)
+    {
+        sender->cleanup_shm();
+    }
+    if (mux.has_value())
+    {
+        mux->cleanup_shm();
+    }
+}
+
+// Message sizes cycled through by the mixed size benchmarks: mostly small heartbeats with occasional
+// medium updates and large snapshots
+constexpr std::array<size_t, 8> MIXED_MESSAGE_SIZES = {40, 40, 40, 40, 200, 40, 40, 3 * 1024};
+constexpr size_t MAX_MIXED_MESSAGE_SIZE = 3 * 1024;
+
+// Benchmarks streaming throughput of mixed size traffic through the fixed size queue. Every message is sent
+// as a `Message<MAX_MIXED_MESSAGE_SIZE>`, so each is padded to the largest message size.
+// Throughput is reported as message bytes / sec (`bytes_per_second`), not counting the padding.
+template <size_t queue_size>
+void BM_TwoThread_MixedSize_Fixed_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+    using MixedMessage = Message<MAX_MIXED_MESSAGE_SIZE>;
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{koi::KoiSender<MixedMessage>(shm_name, queue_size)};
+        two_thread_setup_done = true;
+
+        size_t i = 0;
+        for (auto _ : state)
+        {
+            const size_t message_size = MIXED_MESSAGE_SIZES[i++ % MIXED_MESSAGE_SIZES.size()];
+            MixedMessage *slot;
+            while ((slot = sender.reserve()) == nullptr)
+            {
+            }
+            std::memset(slot->data, 1, message_size);
+            sender.commit();
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiReceiver<MixedMessage>(shm_name, queue_size)};
+        auto received = std::make_unique<MixedMessage>();
+        size_t i = 0;
+        size_t bytes = 0;
+        for (auto _ : state)
+        {
+            const size_t message_size = MIXED_MESSAGE_SIZES[i++ % MIXED_MESSAGE_SIZES.size()];
+            while (!receiver.recv_into(*received))
+            {
+            }
+            ASSERT(received->data[message_size - 1] == 1);
+            bytes += message_size;
+        }
+        state.SetBytesProcessed(bytes);
+    }
+}
+
+// Benchmarks streaming throughput of mixed size traffic through the variable size queue, where each
+// record is only padded to the next cache line.
+// Throughput is reported as message bytes / sec (`bytes_per_second`).
+template <size_t queue_size>
+void BM_TwoThread_MixedSize_Var_Throughput(benchmark::State &state)
+{
+    spdlog::set_level(spdlog::level::err);
+
+    constexpr int SENDER_THREAD_ID = 0;
+    constexpr int RECEIVER_THREAD_ID = 1;
+
+    if (state.threads() > 2)
+    {
+        spdlog::error("This benchmark only supports 2 threads");
+        return;
+    }
+
+    std::vector<std::byte> msg(MAX_MIXED_MESSAGE_SIZE, std::byte{1});
+    if (state.thread_index() == SENDER_THREAD_ID)
+    {
+        auto sender{koi::KoiVarSender(shm_name, queue_size)};
+        two_thread_setup_done = true;
+
+        size_t i = 0;
+        for (auto _ : state)
+        {
+            const size_t message_size = MIXED_MESSAGE_SIZES[i++ % MIXED_MESSAGE_SIZES.size()];
+            while (!sender.send(std::span(msg).first(message_size)))
+            {
+            }
+        }
+    }
+    else if (state.thread_index() == RECEIVER_THREAD_ID)
+    {
+        // Wait for sender to be initialized before receiver is initialized
+        while (!two_thread_setup_done)
+        {
+        }
+        auto receiver{koi::KoiVarReceiver(shm_name, queue_size)};
+        std::vector<std::byte> received(MAX_MIXED_MESSAGE_SIZE);
+        size_t bytes = 0;
+        for (auto _ : state)
+        {
+            std::optional<size_t> length;
+            do
+            {
+                length = receiver.recv(received);
+            } while (!length.has_value());
+            ASSERT(received[length.value() - 1] == std::byte{1});
+            bytes += length.value();
+        }
+        state.SetBytesProcessed(bytes);
+    }
+}
+
+// // Single Threaded
+// // Boost Lock Buffer
+// #define BOOST_SINGLETHREAD_BENCH(queue_size, message_size)            \
+//     BENCHMARK(BM_SingleThread_Empty_PingPong<                         \
+//                   boost_lock_buffer::Sender<Message<message_size>>,   \
+//                   boost_lock_buffer::Receiver<Message<message_size>>, \
+//                   queue_size,                                         \
+//                   message_size>)                                      \
+//         ->Setup(SetupBench);
+
+// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 2)
+// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 6)
+// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 8)
+// BOOST_SINGLETHREAD_BENCH(1 << 12, 1 << 12)
+// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 2)
+// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 6)
+// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 8)
+// BOOST_SINGLETHREAD_BENCH(1 << 20, 1 << 12)
+
+// // Boost SPSC Lock Free
+// #define BOOST_SPSC_SINGLETHREAD_BENCH(queue_size, message_size) \
+//     BENCHMARK(BM_SingleThread_Empty_PingPong<                   \
+//                   boost_spsc::Sender<Message<message_size>>,    \
+//                   boost_spsc::Receiver<Message<message_size>>,  \
+//                   queue_size,                                   \
+//                   message_size>)                                \
+//         ->Setup(SetupBench);
+
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 2)
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 6)
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 8)
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 12, 1 << 12)
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 2)
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 6)
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 8)
+// BOOST_SPSC_SINGLETHREAD_BENCH(1 << 20, 1 << 12)
+
+// // Koi
+// #define KOI_SINGLETHREAD_BENCH(queue_size, message_size)   \
+//     BENCHMARK(BM_SingleThread_Empty_PingPong<              \
+//                   koi::KoiSender<Message<message_size>>,   \
+//                   koi::KoiReceiver<Message<message_size>>, \
+//                   queue_size,                              \
+//                   message_size>)                           \
+//         ->Setup(SetupBench);
+
+// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 2)
+// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 6)
+// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 8)
+// KOI_SINGLETHREAD_BENCH(1 << 12, 1 << 12)
+// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 2)
+// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 6)
+// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 8)
+// KOI_SINGLETHREAD_BENCH(1 << 20, 1 << 12)
+
+// Multi Threaded
+// Empty
 // Note that Koi takes a queue_size in bytes while the others take the number of elements
-#define PARTIAL_FILL_MULTITHREAD_BENCH(queue_size, message_size)  \
-    BENCHMARK(BM_TwoThread_PartialFill_PingPong<                  \
-                  boost_spsc::Sender<Message<message_size>>,      \
-                  boost_spsc::Receiver<Message<message_size>>,    \
-                  queue_size,                                     \
-                  message_size>)                                  \
+#define EMPTY_MULTITHREAD_BENCH(queue_size, message_size)                                           \
+    BENCHMARK(BM_TwoThread_Empty_PingPong<                                                          \
+                  boost_spsc::Sender<Message<message_size>>,                                        \
+                  boost_spsc::Receiver<Message<message_size>>,                                      \
+                  queue_size,                                                                       \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);                                                              \
+                                                                                                    \
+    BENCHMARK(BM_TwoThread_Empty_PingPong<                                                          \
+                  koi::KoiSender<Message<message_size>>,                                            \
+                  koi::KoiReceiver<Message<message_size>>,                                          \
+                  static_cast<size_t>(queue_size) * message_size,                                   \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);                                                              \
+                                                                                                    \
+    /* Koi with a compile time capacity holding the same number of bytes */                         \
+    BENCHMARK(BM_TwoThread_Empty_PingPong<                                                          \
+                  StaticKoiSender<static_cast<size_t>(queue_size) * message_size, message_size>,    \
+                  StaticKoiReceiver<static_cast<size_t>(queue_size) * message_size, message_size>,  \
+                  static_cast<size_t>(queue_size) * message_size,                                   \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);
+
+EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 4) // 16
+EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 5) // 32
+EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 6) // 64
+EMPTY_MULTITHREAD_BENCH(1 << 12, 1 << 7) // 128
+
+// Empty, encoding each message
+// Queue size is reduced for the large messages
+#define ENCODE_MULTITHREAD_BENCH(queue_size, message_size)        \
+    BENCHMARK(BM_TwoThread_Empty_Encode_PingPong<                 \
+                  koi::KoiSender<Message<message_size>>,          \
+                  koi::KoiReceiver<Message<message_size>>,        \
+                  static_cast<size_t>(queue_size) * message_size, \
+                  message_size,                                   \
+                  false>)                                         \
         ->Threads(2)                                              \
         ->Setup(SetupBench)                                       \
         ->Teardown(TeardownTwoThread);                            \
                                                                   \
-    BENCHMARK(BM_TwoThread_PartialFill_PingPong<                  \
+    BENCHMARK(BM_TwoThread_Empty_Encode_PingPong<                 \
                   koi::KoiSender<Message<message_size>>,          \
                   koi::KoiReceiver<Message<message_size>>,        \
                   static_cast<size_t>(queue_size) * message_size, \
-                  message_size>)                                  \
+                  message_size,                                   \
+                  true>)                                          \
         ->Threads(2)                                              \
         ->Setup(SetupBench)                                       \
         ->Teardown(TeardownTwoThread);
 
-PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 4)
-PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 5)
-PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 6)
-PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 7)
+ENCODE_MULTITHREAD_BENCH(1 << 8, 1 << 10) // 1 KiB
+ENCODE_MULTITHREAD_BENCH(1 << 8, 1 << 14) // 16 KiB
 
-// Full
+// Empty, large messages read with `recv()`, `recv_into()` and `peek()`/`release()`
+// `queue_size` is in bytes for all message sizes. Message blocks are padded to the next cache line, so
+// `MAX_MESSAGE_SIZE_BYTES` messages fill `MAX_MESSAGE_BLOCK_BYTES` blocks.
+#define RECV_MULTITHREAD_BENCH_MODE(queue_size, message_size, recv_mode) \
+    BENCHMARK(BM_TwoThread_Empty_Recv_PingPong<                          \
+                  koi::KoiSender<Message<message_size>>,                 \
+                  koi::KoiReceiver<Message<message_size>>,               \
+                  queue_size,                                            \
+                  message_size,                                          \
+                  recv_mode>)                                            \
+        ->Threads(2)                                                     \
+        ->Setup(SetupBench)                                              \
+        ->Teardown(TeardownTwoThread);
+
+#define RECV_MULTITHREAD_BENCH(queue_size, message_size)                              \
+    RECV_MULTITHREAD_BENCH_MODE(queue_size, message_size, RecvMode::COPY_OPTIONAL) \
+    RECV_MULTITHREAD_BENCH_MODE(queue_size, message_size, RecvMode::COPY_INTO)     \
+    RECV_MULTITHREAD_BENCH_MODE(queue_size, message_size, RecvMode::ZERO_COPY)
+
+RECV_MULTITHREAD_BENCH(1 << 23, 1 << 12)              // 4 KiB
+RECV_MULTITHREAD_BENCH(1 << 23, 1 << 14)              // 16 KiB
+RECV_MULTITHREAD_BENCH(1 << 23, 1 << 16)              // 64 KiB
+RECV_MULTITHREAD_BENCH(1 << 23, MAX_MESSAGE_SIZE_BYTES) // ~128 KiB
+
+// Partial Fill
 // Note that Koi takes a queue_size in bytes while the others take the number of elements
-#define FULL_MULTITHREAD_BENCH(queue_size, message_size)          \
-    BENCHMARK(BM_TwoThread_Full_PingPong<                         \
+#define PARTIAL_FILL_MULTITHREAD_BENCH(queue_size, message_size)  \
+    BENCHMARK(BM_TwoThread_PartialFill_PingPong<                  \
                   boost_spsc::Sender<Message<message_size>>,      \
                   boost_spsc::Receiver<Message<message_size>>,    \
                   queue_size,                                     \
@@ -458,7 +2151,7 @@ PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 7)
         ->Setup(SetupBench)                                       \
         ->Teardown(TeardownTwoThread);                            \
                                                                   \
-    BENCHMARK(BM_TwoThread_Full_PingPong<                         \
+    BENCHMARK(BM_TwoThread_PartialFill_PingPong<                  \
                   koi::KoiSender<Message<message_size>>,          \
                   koi::KoiReceiver<Message<message_size>>,        \
                   static_cast<size_t>(queue_size) * message_size, \
@@ -467,10 +2160,392 @@ PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 7)
         ->Setup(SetupBench)                                       \
         ->Teardown(TeardownTwoThread);
 
+PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 4)
+PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 5)
+PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 6)
+PARTIAL_FILL_MULTITHREAD_BENCH(1 << 12, 1 << 7)
+
+// Full
+// Note that Koi takes a queue_size in bytes while the others take the number of elements
+#define FULL_MULTITHREAD_BENCH(queue_size, message_size)                                            \
+    BENCHMARK(BM_TwoThread_Full_PingPong<                                                           \
+                  boost_spsc::Sender<Message<message_size>>,                                        \
+                  boost_spsc::Receiver<Message<message_size>>,                                      \
+                  queue_size,                                                                       \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);                                                              \
+                                                                                                    \
+    BENCHMARK(BM_TwoThread_Full_PingPong<                                                           \
+                  koi::KoiSender<Message<message_size>>,                                            \
+                  koi::KoiReceiver<Message<message_size>>,                                          \
+                  static_cast<size_t>(queue_size) * message_size,                                   \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);                                                              \
+                                                                                                    \
+    /* Koi with a compile time capacity holding the same number of bytes */                         \
+    BENCHMARK(BM_TwoThread_Full_PingPong<                                                           \
+                  StaticKoiSender<static_cast<size_t>(queue_size) * message_size, message_size>,    \
+                  StaticKoiReceiver<static_cast<size_t>(queue_size) * message_size, message_size>,  \
+                  static_cast<size_t>(queue_size) * message_size,                                   \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);
+
 FULL_MULTITHREAD_BENCH(1 << 12, 1 << 4)
 FULL_MULTITHREAD_BENCH(1 << 12, 1 << 5)
 FULL_MULTITHREAD_BENCH(1 << 12, 1 << 6)
 FULL_MULTITHREAD_BENCH(1 << 12, 1 << 7)
 
+// Empty and full, with lookahead on send and batched release on recv
+// Compare against the default FastForward protocol in `EMPTY_MULTITHREAD_BENCH` and `FULL_MULTITHREAD_BENCH`
+#define LOOKAHEAD_MULTITHREAD_BENCH(queue_size, message_size, lookahead, release_batch)           \
+    BENCHMARK(BM_TwoThread_Empty_PingPong<                                                          \
+                  LookaheadKoiSender<Message<message_size>, lookahead>,                             \
+                  BatchedReleaseKoiReceiver<Message<message_size>, release_batch>,                  \
+                  static_cast<size_t>(queue_size) * message_size,                                   \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);                                                              \
+                                                                                                    \
+    BENCHMARK(BM_TwoThread_Full_PingPong<                                                           \
+                  LookaheadKoiSender<Message<message_size>, lookahead>,                             \
+                  BatchedReleaseKoiReceiver<Message<message_size>, release_batch>,                  \
+                  static_cast<size_t>(queue_size) * message_size,                                   \
+                  message_size>)                                                                    \
+        ->Threads(2)                                                                                \
+        ->Setup(SetupBench)                                                                         \
+        ->Teardown(TeardownTwoThread);
+
+LOOKAHEAD_MULTITHREAD_BENCH(1 << 12, 1 << 4, 32, 32)
+LOOKAHEAD_MULTITHREAD_BENCH(1 << 12, 1 << 5, 32, 32)
+LOOKAHEAD_MULTITHREAD_BENCH(1 << 12, 1 << 6, 32, 32)
+LOOKAHEAD_MULTITHREAD_BENCH(1 << 12, 1 << 7, 32, 32)
+
+// Batch
+// Batch sizes 1 to 256, single message `send()`/`recv()` next to `send_batch()`/`recv_batch()`
+#define BATCH_MULTITHREAD_BENCH(queue_size, message_size)                 \
+    BENCHMARK(BM_TwoThread_Batch_Throughput<                              \
+                  koi::KoiSender<Message<message_size>>,                  \
+                  koi::KoiReceiver<Message<message_size>>,                \
+                  static_cast<size_t>(queue_size) * message_size,         \
+                  message_size,                                           \
+                  false>)                                                 \
+        ->RangeMultiplier(2)                                              \
+        ->Range(1, 256)                                                   \
+        ->Threads(2)                                                      \
+        ->Setup(SetupBench)                                               \
+        ->Teardown(TeardownTwoThread);                                    \
+                                                                          \
+    BENCHMARK(BM_TwoThread_Batch_Throughput<                              \
+                  koi::KoiSender<Message<message_size>>,                  \
+                  koi::KoiReceiver<Message<message_size>>,                \
+                  static_cast<size_t>(queue_size) * message_size,         \
+                  message_size,                                           \
+                  true>)                                                  \
+        ->RangeMultiplier(2)                                              \
+        ->Range(1, 256)                                                   \
+        ->Threads(2)                                                      \
+        ->Setup(SetupBench)                                               \
+        ->Teardown(TeardownTwoThread);
+
+BATCH_MULTITHREAD_BENCH(1 << 12, 1 << 4)
+BATCH_MULTITHREAD_BENCH(1 << 12, 1 << 6)
+BATCH_MULTITHREAD_BENCH(1 << 12, 1 << 7)
+
+// Mixed size
+// Both queues use the same ring buffer size in bytes
+#define MIXED_SIZE_MULTITHREAD_BENCH(queue_size)                     \
+    BENCHMARK(BM_TwoThread_MixedSize_Fixed_Throughput<queue_size>) \
+        ->Threads(2)                                                 \
+        ->Setup(SetupBench)                                          \
+        ->Teardown(TeardownTwoThread);                               \
+                                                                     \
+    BENCHMARK(BM_TwoThread_MixedSize_Var_Throughput<queue_size>)   \
+        ->Threads(2)                                                 \
+        ->Setup(SetupBench)                                          \
+        ->Teardown(TeardownTwoThread);
+
+MIXED_SIZE_MULTITHREAD_BENCH(1 << 18)
+MIXED_SIZE_MULTITHREAD_BENCH(1 << 22)
+
+// Blocking send/recv, with an idle gap between messages in microseconds
+#define BURSTY_WAIT_MULTITHREAD_BENCH(queue_size, message_size, strategy)  \
+    BENCHMARK(BM_TwoThread_Bursty_Wait<queue_size, message_size, strategy>) \
+        ->Threads(2)                                                       \
+        ->Arg(10)                                                          \
+        ->Arg(100)                                                         \
+        ->Setup(SetupBench)                                                \
+        ->Teardown(TeardownTwoThread);
+
+BURSTY_WAIT_MULTITHREAD_BENCH(1 << 16, 1 << 6, WaitStrategy::BUSY_SPIN)
+BURSTY_WAIT_MULTITHREAD_BENCH(1 << 16, 1 << 6, WaitStrategy::BACKOFF)
+BURSTY_WAIT_MULTITHREAD_BENCH(1 << 16, 1 << 6, WaitStrategy::YIELD)
+BURSTY_WAIT_MULTITHREAD_BENCH(1 << 16, 1 << 6, WaitStrategy::FUTEX)
+
+#define WAKEUP_LATENCY_MULTITHREAD_BENCH(queue_size, message_size, use_notify_fd)    \
+    BENCHMARK(BM_TwoThread_Wakeup_Latency<queue_size, message_size, use_notify_fd>) \
+        ->Threads(2)                                                           \
+        ->Arg(10)                                                              \
+        ->Arg(100)                                                             \
+        ->Setup(SetupBench)                                                    \
+        ->Teardown(TeardownTwoThread);
+
+WAKEUP_LATENCY_MULTITHREAD_BENCH(1 << 16, 1 << 6, false)
+WAKEUP_LATENCY_MULTITHREAD_BENCH(1 << 16, 1 << 6, true)
+
+BENCHMARK(BM_Startup<1 << 6>)
+    ->RangeMultiplier(4)
+    ->Range(1 << 16, int64_t{1} << 32) // 64 KiB to 4 GiB
+    ->Unit(benchmark::kMicrosecond)
+    ->Setup(SetupBench);
+
+#define MAPPING_BENCH(queue_size, message_size)                                              \
+    BENCHMARK(BM_SingleThread_FirstLap<queue_size, message_size, false, false>)              \
+        ->Setup(SetupBench);                                                                 \
+    BENCHMARK(BM_SingleThread_FirstLap<queue_size, message_size, true, false>)               \
+        ->Setup(SetupBench);                                                                 \
+    BENCHMARK(BM_SingleThread_FirstLap<queue_size, message_size, false, true>)               \
+        ->Setup(SetupBench);                                                                 \
+    BENCHMARK(BM_SingleThread_FirstLap<queue_size, message_size, true, true>)                \
+        ->Setup(SetupBench);                                                                 \
+    BENCHMARK(BM_TwoThread_Batch_Throughput<MappedKoiSender<Message<message_size>, false>,   \
+                                            MappedKoiReceiver<Message<message_size>, false>, \
+                                            queue_size, message_size, false>)                \
+        ->Arg(256)                                                                           \
+        ->Threads(2)                                                                         \
+        ->Setup(SetupBench)                                                                  \
+        ->Teardown(TeardownTwoThread);                                                       \
+    BENCHMARK(BM_TwoThread_Batch_Throughput<MappedKoiSender<Message<message_size>, true>,    \
+                                            MappedKoiReceiver<Message<message_size>, true>,  \
+                                            queue_size, message_size, false>)                \
+        ->Arg(256)                                                                           \
+        ->Threads(2)                                                                         \
+        ->Setup(SetupBench)                                                                  \
+        ->Teardown(TeardownTwoThread);
+
+MAPPING_BENCH(1 << 25, 1 << 6) // 32 MiB ring of 64 B messages
+
+// 300 B messages in 384 B blocks with any capacity, against 508 B messages filling the 512 B blocks that
+// 300 B messages used when blocks and capacities were both padded to powers of 2. Only a compile time
+// power of 2 number of power of 2 blocks wraps around with a mask.
+#define CAPACITY_MULTITHREAD_BENCH(message_size, capacity, static_capacity)                       \
+    BENCHMARK(BM_TwoThread_Capacity_Throughput<koi::KoiSender<Message<message_size>, static_capacity>,   \
+                                               koi::KoiReceiver<Message<message_size>, static_capacity>, \
+                                               message_size,                                             \
+                                               capacity>)                                                \
+        ->Threads(2)                                                                                     \
+        ->Setup(SetupBench)                                                                              \
+        ->Teardown(TeardownTwoThread);
+
+CAPACITY_MULTITHREAD_BENCH(300, 1000, DYNAMIC_CAPACITY)
+CAPACITY_MULTITHREAD_BENCH(300, 1000, 1000)
+CAPACITY_MULTITHREAD_BENCH(300, 1024, 1024)
+CAPACITY_MULTITHREAD_BENCH(508, 1024, 1024) // Former layout of 300 B messages, wraps around with a mask
+
+// Payloads of exactly one cache line take two cache lines with inline headers and one with separate headers
+#define SLOT_LAYOUT_MULTITHREAD_BENCH(message_size, capacity, layout)                                            \
+    BENCHMARK(BM_TwoThread_Capacity_Throughput<koi::KoiSender<Message<message_size>, DYNAMIC_CAPACITY, layout>,   \
+                                               koi::KoiReceiver<Message<message_size>, DYNAMIC_CAPACITY, layout>, \
+                                               message_size,                                                      \
+                                               capacity>)                                                         \
+        ->Threads(2)                                                                                              \
+        ->Setup(SetupBench)                                                                                       \
+        ->Teardown(TeardownTwoThread);
+
+SLOT_LAYOUT_MULTITHREAD_BENCH(64, 1 << 12, SlotLayout::INLINE_HEADER)
+SLOT_LAYOUT_MULTITHREAD_BENCH(64, 1 << 12, SlotLayout::SEPARATE_HEADERS)
+SLOT_LAYOUT_MULTITHREAD_BENCH(CACHE_LINE_BYTES, 1 << 12, SlotLayout::INLINE_HEADER)
+SLOT_LAYOUT_MULTITHREAD_BENCH(CACHE_LINE_BYTES, 1 << 12, SlotLayout::SEPARATE_HEADERS)
+
+// Tiny messages take a whole cache line each in `KoiQueue`, but share lines in `KoiPackedQueue`
+#define TINY_MULTITHREAD_BENCH(queue_size, message_size)                                              \
+    BENCHMARK(BM_TwoThread_Tiny_Throughput<koi::KoiSender<Message<message_size>>,                     \
+                                           koi::KoiReceiver<Message<message_size>>,                   \
+                                           queue_size,                                                \
+                                           message_size>)                                             \
+        ->Threads(2)                                                                                  \
+        ->Setup(SetupBench)                                                                           \
+        ->Teardown(TeardownTwoThread);                                                                \
+    BENCHMARK(BM_TwoThread_Tiny_Throughput<koi::KoiPackedSender<Message<message_size>>,               \
+                                           koi::KoiPackedReceiver<Message<message_size>>,             \
+                                           queue_size,                                                \
+                                           message_size>)                                             \
+        ->Threads(2)                                                                                  \
+        ->Setup(SetupBench)                                                                           \
+        ->Teardown(TeardownTwoThread);
+
+TINY_MULTITHREAD_BENCH(1 << 16, 4)
+TINY_MULTITHREAD_BENCH(1 << 16, 8)
+TINY_MULTITHREAD_BENCH(1 << 16, 16)
+
+// Sweeps the sender and receiver over CPU pairs from hardware threads of one core out to cores without a shared cache
+#define PLACEMENT_MULTITHREAD_BENCH(queue_size, message_size)                                                  \
+    BENCHMARK(BM_TwoThread_Placement_RoundTrip<queue_size, message_size, CpuDistance::SMT_SIBLING>)         \
+        ->Threads(2)                                                                                         \
+        ->Setup(SetupBench)                                                                                  \
+        ->Teardown(TeardownTwoThread);                                                                       \
+    BENCHMARK(BM_TwoThread_Placement_RoundTrip<queue_size, message_size, CpuDistance::SHARED_L2>)           \
+        ->Threads(2)                                                                                         \
+        ->Setup(SetupBench)                                                                                  \
+        ->Teardown(TeardownTwoThread);                                                                       \
+    BENCHMARK(BM_TwoThread_Placement_RoundTrip<queue_size, message_size, CpuDistance::SHARED_L3>)           \
+        ->Threads(2)                                                                                         \
+        ->Setup(SetupBench)                                                                                  \
+        ->Teardown(TeardownTwoThread);                                                                       \
+    BENCHMARK(BM_TwoThread_Placement_RoundTrip<queue_size, message_size, CpuDistance::CROSS_L3>)            \
+        ->Threads(2)                                                                                         \
+        ->Setup(SetupBench)                                                                                  \
+        ->Teardown(TeardownTwoThread);
+
+PLACEMENT_MULTITHREAD_BENCH(1 << 16, 1 << 6)
+PLACEMENT_MULTITHREAD_BENCH(1 << 16, 1 << 10)
+
+// 1 to 16 producers, plus the consumer thread
+#define FAN_IN_MULTITHREAD_BENCH(queue_size, message_size)                  \
+    BENCHMARK(BM_MultiThread_Mpsc_Throughput<queue_size, message_size>)        \
+        ->Threads(2)                                                          \
+        ->Threads(3)                                                          \
+        ->Threads(5)                                                          \
+        ->Threads(9)                                                          \
+        ->Threads(17)                                                         \
+        ->Setup(SetupBench)                                                   \
+        ->Teardown(TeardownTwoThread);                                        \
+    BENCHMARK(BM_MultiThread_Spsc_Fan_In_Throughput<queue_size, message_size>) \
+        ->Threads(2)                                                          \
+        ->Threads(3)                                                          \
+        ->Threads(5)                                                          \
+        ->Threads(9)                                                          \
+        ->Threads(17)                                                         \
+        ->Setup(SetupBench)                                                   \
+        ->Teardown(TeardownTwoThread);
+
+FAN_IN_MULTITHREAD_BENCH(1 << 16, 1 << 6)
+
+// 1 to 16 receivers, plus the sender thread
+#define FAN_OUT_MULTITHREAD_BENCH(queue_size, message_size)                   \
+    BENCHMARK(BM_MultiThread_Broadcast_Throughput<queue_size, message_size>)    \
+        ->Threads(2)                                                           \
+        ->Threads(3)                                                           \
+        ->Threads(5)                                                           \
+        ->Threads(9)                                                           \
+        ->Threads(17)                                                          \
+        ->Setup(SetupBench)                                                    \
+        ->Teardown(TeardownTwoThread);                                         \
+    BENCHMARK(BM_MultiThread_Spsc_Fan_Out_Throughput<queue_size, message_size>) \
+        ->Threads(2)                                                           \
+        ->Threads(3)                                                           \
+        ->Threads(5)                                                           \
+        ->Threads(9)                                                           \
+        ->Threads(17)                                                          \
+        ->Setup(SetupBench)                                                    \
+        ->Teardown(TeardownTwoThread);
+
+FAN_OUT_MULTITHREAD_BENCH(1 << 16, 1 << 6)
+
+// 1 to 16 consumers, plus the producer thread
+#define WORK_QUEUE_MULTITHREAD_BENCH(queue_size, message_size)                        \
+    BENCHMARK(BM_MultiThread_Spmc_Skewed_Throughput<queue_size, message_size>)          \
+        ->Threads(2)                                                                   \
+        ->Threads(3)                                                                   \
+        ->Threads(5)                                                                   \
+        ->Threads(9)                                                                   \
+        ->Threads(17)                                                                  \
+        ->Setup(SetupBench)                                                            \
+        ->Teardown(TeardownTwoThread);                                                 \
+    BENCHMARK(BM_MultiThread_Spsc_Dispatch_Skewed_Throughput<queue_size, message_size>) \
+        ->Threads(2)                                                                   \
+        ->Threads(3)                                                                   \
+        ->Threads(5)                                                                   \
+        ->Threads(9)                                                                   \
+        ->Threads(17)                                                                  \
+        ->Setup(SetupBench)                                                            \
+        ->Teardown(TeardownTwoThread);
+
+WORK_QUEUE_MULTITHREAD_BENCH(1 << 16, 1 << 6)
+
+// N producers : M consumers. The Boost lock buffer is sized in messages, so it gets the capacity of the Koi queue
+#define NXM_BENCH(Tx, Rx, queue_arg, message_size)                                                                   \
+    BENCHMARK(BM_MultiThread_NxM_Throughput<Tx, Rx, queue_arg, message_size>)->Arg(1)->Threads(2)->Setup(SetupBench)->Teardown(TeardownTwoThread); \
+    BENCHMARK(BM_MultiThread_NxM_Throughput<Tx, Rx, queue_arg, message_size>)->Arg(2)->Threads(4)->Setup(SetupBench)->Teardown(TeardownTwoThread); \
+    BENCHMARK(BM_MultiThread_NxM_Throughput<Tx, Rx, queue_arg, message_size>)->Arg(4)->Threads(8)->Setup(SetupBench)->Teardown(TeardownTwoThread); \
+    BENCHMARK(BM_MultiThread_NxM_Throughput<Tx, Rx, queue_arg, message_size>)->Arg(1)->Threads(5)->Setup(SetupBench)->Teardown(TeardownTwoThread); \
+    BENCHMARK(BM_MultiThread_NxM_Throughput<Tx, Rx, queue_arg, message_size>)->Arg(4)->Threads(5)->Setup(SetupBench)->Teardown(TeardownTwoThread);
+
+#define NXM_MULTITHREAD_BENCH(queue_size, message_size)                                                  \
+    NXM_BENCH(koi::KoiMpmcSender<Message<message_size>>, koi::KoiMpmcReceiver<Message<message_size>>, \
+              queue_size, message_size)                                                              \
+    NXM_BENCH(boost_lock_buffer::Sender<Message<message_size>>,                                      \
+              boost_lock_buffer::Receiver<Message<message_size>>,                                    \
+              queue_size / KoiMpmcQueue<Message<message_size>>::message_block_sz_bytes(), message_size)
+
+NXM_MULTITHREAD_BENCH(1 << 16, 1 << 6)
+
+// Overwrite on full against spinning on full, with a periodically stalled receiver
+#define STALLED_RECEIVER_MULTITHREAD_BENCH(queue_size, message_size)                   \
+    BENCHMARK(BM_TwoThread_Stalled_Receiver_Send<                                   \
+                  koi::KoiSender<Message<message_size>>,                             \
+                  koi::KoiReceiver<Message<message_size>>,                           \
+                  queue_size,                                                        \
+                  message_size>)                                                     \
+        ->UseRealTime()                                                              \
+        ->Setup(SetupBench);                                                         \
+    BENCHMARK(BM_TwoThread_Stalled_Receiver_Send<                                   \
+                  koi::KoiLossySender<Message<message_size>>,                        \
+                  koi::KoiLossyReceiver<Message<message_size>>,                      \
+                  queue_size,                                                        \
+                  message_size>)                                                     \
+        ->UseRealTime()                                                              \
+        ->Setup(SetupBench);
+
+STALLED_RECEIVER_MULTITHREAD_BENCH(1 << 16, 1 << 6)
+
+// Latest value reads, with and without a concurrent writer
+#define SNAPSHOT_BENCH(message_size)                                                 \
+    BENCHMARK(BM_Snapshot_Read<message_size, false>)->Setup(SetupBench);             \
+    BENCHMARK(BM_Snapshot_Read<message_size, true>)->UseRealTime()->Setup(SetupBench);
+
+SNAPSHOT_BENCH(1 << 6)
+SNAPSHOT_BENCH(1 << 10)
+
+// Consumer work under bursty load, with and without per key conflation
+#define BURSTY_CONSUMER_BENCH(queue_size, message_size)                                            \
+    BENCHMARK(BM_Bursty_Consumer_Work<true, queue_size, message_size>)->Setup(SetupBench); \
+    BENCHMARK(BM_Bursty_Consumer_Work<false, queue_size, message_size>)->Setup(SetupBench);
+
+BURSTY_CONSUMER_BENCH(1 << 20, 1 << 6)
+
+// Control message latency behind a saturated data lane: queued with the data, then in its own lane
+#define LANE_CONTROL_BENCH(lane_capacity, message_size)                                                                     \
+    BENCHMARK(BM_Lane_Control_Latency<DATA_LANE, LaneSchedule::STRICT_PRIORITY, lane_capacity, message_size>)->UseRealTime()->Setup(SetupBench);    \
+    BENCHMARK(BM_Lane_Control_Latency<CONTROL_LANE, LaneSchedule::STRICT_PRIORITY, lane_capacity, message_size>)->UseRealTime()->Setup(SetupBench); \
+    BENCHMARK(BM_Lane_Control_Latency<CONTROL_LANE, LaneSchedule::WEIGHTED, lane_capacity, message_size>)->UseRealTime()->Setup(SetupBench);
+
+LANE_CONTROL_BENCH(1 << 10, 1 << 6)
+
+// One receiver of 1 to 1024 queues, scanning every queue or reading a doorbell
+#define FAN_IN_BENCH(queue_size, message_size)                                                                        \
+    BENCHMARK(BM_Fan_In_Poll<false, queue_size, message_size>)->RangeMultiplier(4)->Range(1, 1 << 10)->Setup(SetupBench); \
+    BENCHMARK(BM_Fan_In_Poll<true, queue_size, message_size>)->RangeMultiplier(4)->Range(1, 1 << 10)->Setup(SetupBench);
+
+FAN_IN_BENCH(1 << 12, 1 << 6)
+
 // Run the benchmarks
-BENCHMARK_MAIN();
\ No newline at end of file
+int main(int argc, char **argv)
+{
+    // Results of builds with different `KOI_CACHE_LINE_BYTES` are told apart by the context
+    benchmark::AddCustomContext("cache_line_bytes", std::to_string(CACHE_LINE_BYTES));
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
\ No newline at end of file
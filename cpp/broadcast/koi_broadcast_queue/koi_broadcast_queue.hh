@@ -0,0 +1,184 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_slot.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Maximum number of readers attached to one broadcast queue at the same time
+constexpr size_t MAX_BROADCAST_READERS = 64;
+
+// What happens when the writer laps the slowest reader
+enum class BroadcastMode : uint32_t
+{
+    // `send` returns `QUEUE_FULL` while the slowest attached reader has a whole ring of messages to read.
+    // One stalled reader stalls the writer. A reader only misses messages if it is lapped right after attaching,
+    // before the writer next scans the reader cursors, in which case it skips ahead as in `LOSSY` mode.
+    GATED,
+    // The writer never waits and overwrites the oldest messages. A reader which is lapped detects it from the
+    // slot sequence, skips ahead to the oldest message still in the ring and counts the skipped messages.
+    LOSSY,
+};
+
+// Contains the writer's metadata on one cacheline
+struct BroadcastControlBlockInner
+{
+    // Position of the next message to be sent. Positions only increase, the slot is the position
+    // modulo the capacity
+    std::atomic<uint64_t> position;
+    size_t user_shm_size;
+    size_t message_block_sz;
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+    BroadcastMode mode;
+    // One past the highest reader cursor ever claimed, so the writer only scans cursors which were used
+    std::atomic<uint32_t> reader_slots;
+};
+
+// A reader's cursor, on its own cache line so readers do not false share with each other or the writer
+struct alignas(CACHE_LINE_BYTES) ReaderCursor
+{
+    // Position of the next message the reader will receive
+    std::atomic<uint64_t> position;
+    // Non zero while a reader owns the cursor
+    std::atomic<uint32_t> active;
+};
+
+// Shared information among all processes encoded in the shared memory
+struct BroadcastControlBlock
+{
+    // The below are aligned to the nearest cache line to avoid false sharing
+    // "tail"
+    alignas(CACHE_LINE_BYTES) BroadcastControlBlockInner write;
+    // "heads", one per attached reader
+    ReaderCursor readers[MAX_BROADCAST_READERS];
+};
+
+// Forward declaration of KoiBroadcastQueueRAII
+template <typename T>
+class KoiBroadcastQueueRAII;
+
+// A fixed size message queue with one writer and many readers, where every reader receives every message.
+// The writer copies each message once, and each reader tracks its own position in a `ReaderCursor`.
+// Readers attach at any time and receive the messages sent after they attached. In `GATED` mode a reader
+// which has not detached (e.g. crashed) holds the writer back once the ring is full.
+template <typename T>
+class KoiBroadcastQueue
+{
+public:
+    // Returns total size of the shm segment that the user allocated
+    size_t user_shm_size() const;
+    // Returns the number of messages which fit in the ring buffer
+    size_t capacity() const;
+    // Returns the size of each message plus its header, rounded up to the nearest cache line
+    static constexpr size_t message_block_sz_bytes();
+    BroadcastMode mode() const;
+    // Returns the number of readers currently attached
+    size_t num_readers() const;
+    // Reader: returns the number of messages skipped after being lapped by the writer, see `BroadcastMode`
+    uint64_t lost_messages() const;
+    // Reader: returns if no message is waiting to be received
+    bool is_empty() const;
+
+protected:
+    // `buffer_bytes` is rounded down to a whole number of message blocks, and must hold at least one.
+    // `mode` must match the mode of an existing segment
+    explicit KoiBroadcastQueue(const std::string name, size_t buffer_bytes, BroadcastMode mode = BroadcastMode::GATED);
+    virtual ~KoiBroadcastQueue();
+
+    // Claims a reader cursor starting at the writer's current position.
+    // Throws `std::runtime_error` if `MAX_BROADCAST_READERS` readers are already attached
+    void attach_reader();
+    // Releases the reader cursor, if any. Called by the destructor
+    void detach_reader() noexcept;
+
+    // Returns `KoiQueueRet::QUEUE_FULL` if the slowest reader is a whole ring behind (`GATED` mode only),
+    // otherwise `KoiQueueRet::OK`. Only one writer may call `send`
+    KoiQueueRet send(T message);
+    // Only an attached reader may call `recv`
+    std::optional<T> recv();
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    // Offset of the message from the start of its block. The header is padded so messages are aligned for `T`
+    static constexpr size_t message_offset_ = (sizeof(SequencedSlotHeader) + alignof(T) - 1) & ~(alignof(T) - 1);
+    static constexpr size_t message_block_sz_ = size_rounded_up_to_cache_line(message_offset_ + sizeof(T));
+    static constexpr size_t message_sz = sizeof(T);
+
+    BroadcastControlBlock *control_block_;
+
+    struct ShmMetadata : ShmSegment
+    {
+        // `shm_ptr` + sizeof(BroadcastControlBlock) (aligned to the nearest cache line)
+        // Start of the ring buffer
+        char *user_shm_start;
+        size_t user_shm_size;
+        size_t capacity;
+    };
+
+    ShmMetadata shm_metadata_;
+    BroadcastMode mode_;
+
+    // Writer: process local copy of the write position, and its slot in the ring buffer
+    uint64_t write_position_ = 0;
+    size_t write_slot_ = 0;
+    // Writer: lower bound of the slowest reader's position, refreshed when the ring looks full
+    uint64_t cached_min_read_position_ = 0;
+
+    // Reader: the claimed cursor, or `nullptr` if not attached
+    ReaderCursor *cursor_ = nullptr;
+    uint64_t read_position_ = 0;
+    // Reader: slot of `read_position_` in the ring buffer, so the hot path does not divide
+    size_t read_slot_ = 0;
+    uint64_t lost_messages_ = 0;
+
+    // Returns the position of the slowest attached reader, or `write_position_` if there is none
+    uint64_t slowest_reader_position() const;
+    // Reader: moves past messages the writer has overwritten
+    void skip_overwritten();
+
+    SequencedSlotHeader *header_at(size_t slot) const;
+    char *message_at(size_t slot) const;
+    // Returns the slot after `slot`, wrapping around the ring buffer
+    size_t slot_after(size_t slot) const;
+
+    // Allow `KoiBroadcastQueueRAII` to access private and protected members, particularly `cleanup_shm`
+    friend class KoiBroadcastQueueRAII<T>;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiBroadcastQueueRAII : public KoiBroadcastQueue<T>
+{
+public:
+    explicit KoiBroadcastQueueRAII(const std::string name, size_t buffer_bytes, BroadcastMode mode = BroadcastMode::GATED)
+        : KoiBroadcastQueue<T>(name, buffer_bytes, mode)
+    {
+    }
+
+    ~KoiBroadcastQueueRAII()
+    {
+        // The cursor lives in the segment, so it is released before the segment is unmapped
+        this->detach_reader();
+        // `cleanup_shm` is not called in the default `KoiBroadcastQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiBroadcastQueue<T>::attach_reader;
+    using KoiBroadcastQueue<T>::detach_reader;
+    using KoiBroadcastQueue<T>::send;
+    using KoiBroadcastQueue<T>::recv;
+
+private:
+    using KoiBroadcastQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_broadcast_queue.tcc"
@@ -0,0 +1,315 @@
+#include "koi_broadcast_queue.hh"
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// If the shm segment at `shm_name` has already been created, then the provided `buffer_bytes` must round down to
+// the same ring size as the existing shared memory, and the message block size and mode must match the existing ones.
+template <typename T>
+KoiBroadcastQueue<T>::KoiBroadcastQueue(const std::string shm_name, size_t buffer_bytes, BroadcastMode mode)
+    : mode_(mode)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    // `send`/`recv` will do a bitwise memcpy of T into the shared memory
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+
+    spdlog::info("Constructing KoiBroadcastQueue with shm_name: {}, buffer_bytes: {} bytes, mode: {}",
+                 shm_name, buffer_bytes, static_cast<uint32_t>(mode));
+    shm_metadata_.shm_name = std::move(shm_name);
+
+    // The ring buffer holds whole message blocks, any trailing bytes are unused
+    const size_t capacity = buffer_bytes / message_block_sz_;
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("buffer_bytes provided " + std::to_string(buffer_bytes) +
+                                    " is smaller than the message block size of " + std::to_string(message_block_sz_));
+    }
+    const size_t user_shm_size = capacity * message_block_sz_;
+    shm_metadata_.user_shm_size = user_shm_size;
+    shm_metadata_.capacity = capacity;
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = shm_metadata_.open();
+        // The shared memory is initialized with extra space bytes which holds the control block
+        size_t control_block_sz = size_rounded_to_cache_line<BroadcastControlBlock>();
+        shm_metadata_.map(control_block_sz + user_shm_size);
+        // The ring buffer starts after the control block
+        shm_metadata_.user_shm_start = shm_metadata_.shm_ptr + control_block_sz;
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    control_block_ = reinterpret_cast<BroadcastControlBlock *>(shm_metadata_.shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (control_block_->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block_->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        if (control_block_->write.mode != mode)
+        {
+            spdlog::error("mode provided: {}, existing mode: {}", static_cast<uint32_t>(mode), static_cast<uint32_t>(control_block_->write.mode));
+            throw std::runtime_error("mode provided does not match existing shared memory");
+        }
+        // Sanity check that the user_shm_size is the same as the existing shared memory
+        if (control_block_->write.user_shm_size != user_shm_size)
+        {
+            spdlog::error("user_shm_size provided: {}, existing user_shm_size: {}", user_shm_size, control_block_->write.user_shm_size);
+            throw std::runtime_error("user_shm_size provided does not match existing shared memory");
+        }
+        // Sanity check that the message block size is the same as the existing shared memory
+        if (control_block_->write.message_block_sz != message_block_sz_)
+        {
+            spdlog::error("message_block_sz_ provided: {}, existing message_block_sz: {}",
+                          message_block_sz_, control_block_->write.message_block_sz);
+            throw std::runtime_error("message_block_sz_ provided does not match existing shared memory");
+        }
+        // Pick up where the previous writer left off
+        write_position_ = control_block_->write.position.load(std::memory_order_acquire);
+        write_slot_ = write_position_ % capacity;
+        cached_min_read_position_ = slowest_reader_position();
+        return;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so no slot is published and no reader cursor is active.
+    control_block_->write.user_shm_size = user_shm_size;
+    control_block_->write.message_block_sz = message_block_sz_;
+    control_block_->write.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->write.mode = mode;
+    control_block_->write.position = 0;
+    control_block_->write.reader_slots = 0;
+    spdlog::debug("Control block initialized with user_shm_size: {}, message_block_sz: {}", user_shm_size, message_block_sz_);
+}
+
+template <typename T>
+KoiBroadcastQueue<T>::~KoiBroadcastQueue()
+{
+    spdlog::debug("Starting KoiBroadcastQueue destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`.
+    // A reader's cursor is released so it no longer holds back a `GATED` writer
+    detach_reader();
+}
+
+template <typename T>
+void KoiBroadcastQueue<T>::cleanup_shm() noexcept
+{
+    shm_metadata_.cleanup();
+}
+
+template <typename T>
+size_t KoiBroadcastQueue<T>::user_shm_size() const
+{
+    return shm_metadata_.user_shm_size;
+}
+
+template <typename T>
+size_t KoiBroadcastQueue<T>::capacity() const
+{
+    return shm_metadata_.capacity;
+}
+
+template <typename T>
+constexpr size_t KoiBroadcastQueue<T>::message_block_sz_bytes()
+{
+    return message_block_sz_;
+}
+
+template <typename T>
+BroadcastMode KoiBroadcastQueue<T>::mode() const
+{
+    return mode_;
+}
+
+template <typename T>
+size_t KoiBroadcastQueue<T>::num_readers() const
+{
+    const uint32_t reader_slots = control_block_->write.reader_slots.load(std::memory_order_acquire);
+    size_t num_readers = 0;
+    for (uint32_t i = 0; i < reader_slots; ++i)
+    {
+        num_readers += control_block_->readers[i].active.load(std::memory_order_relaxed) != 0;
+    }
+    return num_readers;
+}
+
+template <typename T>
+uint64_t KoiBroadcastQueue<T>::lost_messages() const
+{
+    return lost_messages_;
+}
+
+template <typename T>
+bool KoiBroadcastQueue<T>::is_empty() const
+{
+    return header_at(read_slot_)->sequence.load(std::memory_order_acquire) != read_position_ + 1;
+}
+
+template <typename T>
+void KoiBroadcastQueue<T>::attach_reader()
+{
+    if (cursor_ != nullptr)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < MAX_BROADCAST_READERS; ++i)
+    {
+        ReaderCursor &cursor = control_block_->readers[i];
+        uint32_t expected = 0;
+        if (!cursor.active.compare_exchange_strong(expected, 1, std::memory_order_acq_rel))
+        {
+            continue;
+        }
+        // Make the cursor visible to the writer's scan
+        uint32_t reader_slots = control_block_->write.reader_slots.load(std::memory_order_relaxed);
+        while (reader_slots < i + 1 &&
+               !control_block_->write.reader_slots.compare_exchange_weak(reader_slots, i + 1, std::memory_order_acq_rel))
+        {
+        }
+        // Start from the next message. A `GATED` writer only sees the cursor once it next refreshes its view of
+        // the slowest reader. Until then it may overwrite a slot this reader is copying, which `recv` detects
+        // from the slot sequence in both modes, and the reader skips ahead like a `LOSSY` reader
+        read_position_ = control_block_->write.position.load(std::memory_order_acquire);
+        read_slot_ = read_position_ % shm_metadata_.capacity;
+        cursor.position.store(read_position_, std::memory_order_release);
+        cursor_ = &cursor;
+        spdlog::debug("Attached broadcast reader {} at position {}", i, read_position_);
+        return;
+    }
+    throw std::runtime_error("All " + std::to_string(MAX_BROADCAST_READERS) + " broadcast reader cursors are in use");
+}
+
+template <typename T>
+void KoiBroadcastQueue<T>::detach_reader() noexcept
+{
+    // `shm_ptr` is unset if the segment was already cleaned up
+    if (cursor_ != nullptr && shm_metadata_.shm_ptr != nullptr)
+    {
+        cursor_->active.store(0, std::memory_order_release);
+    }
+    cursor_ = nullptr;
+}
+
+template <typename T>
+uint64_t KoiBroadcastQueue<T>::slowest_reader_position() const
+{
+    uint64_t slowest = write_position_;
+    const uint32_t reader_slots = control_block_->write.reader_slots.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < reader_slots; ++i)
+    {
+        const ReaderCursor &cursor = control_block_->readers[i];
+        if (cursor.active.load(std::memory_order_acquire) != 0)
+        {
+            // `memory_order_acquire` so the reader has finished reading the slots before its position
+            slowest = std::min(slowest, cursor.position.load(std::memory_order_acquire));
+        }
+    }
+    return slowest;
+}
+
+template <typename T>
+KoiQueueRet KoiBroadcastQueue<T>::send(T message)
+{
+    const size_t capacity = shm_metadata_.capacity;
+    if (mode_ == BroadcastMode::GATED && write_position_ - cached_min_read_position_ >= capacity)
+    {
+        // Only scan the reader cursors once the cached position says the ring is full
+        cached_min_read_position_ = slowest_reader_position();
+        if (write_position_ - cached_min_read_position_ >= capacity)
+        {
+            return KoiQueueRet::QUEUE_FULL;
+        }
+    }
+
+    // Readers of the previous lap's message see the slot change and discard their copy. Also needed in `GATED`
+    // mode, where a reader which attached after the last scan of the cursors is not yet holding back the writer
+    write_sequenced_slot(header_at(write_slot_), message_at(write_slot_), reinterpret_cast<char *>(&message),
+                         message_sz, write_position_);
+    write_slot_ = slot_after(write_slot_);
+    ++write_position_;
+    // Read by attaching and lapped readers only, so it mostly stays in the writer's cache
+    control_block_->write.position.store(write_position_, std::memory_order_release);
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+std::optional<T> KoiBroadcastQueue<T>::recv()
+{
+    if (cursor_ == nullptr)
+    {
+        throw std::logic_error("recv called on a broadcast queue without an attached reader");
+    }
+    while (true)
+    {
+        T message;
+        const SequencedRead read = read_sequenced_slot(header_at(read_slot_), message_at(read_slot_),
+                                                       reinterpret_cast<char *>(&message), message_sz, read_position_,
+                                                       control_block_->write.position, shm_metadata_.capacity);
+        if (read == SequencedRead::EMPTY)
+        {
+            return std::nullopt;
+        }
+        if (read == SequencedRead::LAPPED)
+        {
+            skip_overwritten();
+            continue;
+        }
+        read_slot_ = slot_after(read_slot_);
+        ++read_position_;
+        // Only this reader writes its cursor, the writer reads it when the ring looks full
+        cursor_->position.store(read_position_, std::memory_order_release);
+        return message;
+    }
+}
+
+template <typename T>
+void KoiBroadcastQueue<T>::skip_overwritten()
+{
+    const uint64_t write_position = control_block_->write.position.load(std::memory_order_acquire);
+    const uint64_t next = position_after_lap(read_position_, write_position, shm_metadata_.capacity);
+    lost_messages_ += next - read_position_;
+    spdlog::debug("Broadcast reader lapped at position {}, skipping to {}", read_position_, next);
+    read_position_ = next;
+    // Only taken when lapped, so the divide is off the hot path
+    read_slot_ = read_position_ % shm_metadata_.capacity;
+    cursor_->position.store(read_position_, std::memory_order_release);
+}
+
+template <typename T>
+SequencedSlotHeader *KoiBroadcastQueue<T>::header_at(size_t slot) const
+{
+    return reinterpret_cast<SequencedSlotHeader *>(shm_metadata_.user_shm_start + slot * message_block_sz_);
+}
+
+template <typename T>
+char *KoiBroadcastQueue<T>::message_at(size_t slot) const
+{
+    return reinterpret_cast<char *>(header_at(slot)) + message_offset_;
+}
+
+template <typename T>
+size_t KoiBroadcastQueue<T>::slot_after(size_t slot) const
+{
+    // As in `KoiQueue::offset_after`, a compare and subtract instead of a modulo
+    size_t next_slot = slot + 1;
+    if (next_slot >= shm_metadata_.capacity)
+    {
+        next_slot -= shm_metadata_.capacity;
+    }
+    return next_slot;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "koi_broadcast_queue.hh"
+
+namespace koi
+{
+    // One of many IPC receivers of a broadcast queue. Attaches on construction, so it receives the messages sent
+    // after it was constructed, and detaches on destruction
+    template <typename T>
+    class KoiBroadcastReceiver : public KoiBroadcastQueue<T>
+    {
+    public:
+        KoiBroadcastReceiver(const std::string name, size_t buffer_bytes, BroadcastMode mode = BroadcastMode::GATED)
+            : KoiBroadcastQueue<T>(name, buffer_bytes, mode)
+        {
+            this->attach_reader();
+        }
+
+        using KoiBroadcastQueue<T>::recv;
+    };
+} // namespace koi
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "koi_broadcast_queue.hh"
+
+namespace koi
+{
+    // The single IPC sender of a queue where every attached receiver gets every message
+    template <typename T>
+    class KoiBroadcastSender : public KoiBroadcastQueue<T>
+    {
+    public:
+        KoiBroadcastSender(const std::string name, size_t buffer_bytes, BroadcastMode mode = BroadcastMode::GATED)
+            : KoiBroadcastQueue<T>(name, buffer_bytes, mode)
+        {
+        }
+
+        using KoiBroadcastQueue<T>::send;
+        // The sender may clean up the shared memory segment once the receivers have finished
+        using KoiBroadcastQueue<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -0,0 +1,215 @@
+#include "koi_affinity.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+std::string to_string(CpuDistance distance)
+{
+    switch (distance)
+    {
+    case CpuDistance::SMT_SIBLING:
+        return "smt_sibling";
+    case CpuDistance::SHARED_L2:
+        return "shared_l2";
+    case CpuDistance::SHARED_L3:
+        return "shared_l3";
+    case CpuDistance::CROSS_L3:
+        return "cross_l3";
+    }
+    return "unknown";
+}
+
+std::vector<int> parse_cpu_list(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty())
+        {
+            continue;
+        }
+        int first = 0;
+        int last = 0;
+        char dash = 0;
+        std::stringstream bounds(range);
+        if (!(bounds >> first))
+        {
+            return {};
+        }
+        last = first;
+        if (bounds >> dash && (dash != '-' || !(bounds >> last)))
+        {
+            return {};
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}
+
+std::vector<int> current_thread_cpus()
+{
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &set))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+bool pin_current_thread(const std::vector<int> &cpus)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            spdlog::warn("Cannot pin to CPU {}, outside of the supported range", cpu);
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    const int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0)
+    {
+        spdlog::warn("pthread_setaffinity_np failed with error: {}", ret);
+        return false;
+    }
+    return true;
+#else
+    // MacOS only offers affinity tags, which are hints and not supported on Apple silicon
+    spdlog::warn("Pinning threads to CPUs is not supported on this platform");
+    return false;
+#endif
+}
+
+bool pin_current_thread(int cpu)
+{
+    return pin_current_thread(std::vector<int>{cpu});
+}
+
+// Returns the first line of the sysfs file at `path`, or an empty string if it does not exist
+static std::string read_sysfs(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+CpuTopology CpuTopology::probe()
+{
+    CpuTopology topology;
+    topology.cpus_ = current_thread_cpus();
+    for (int cpu : topology.cpus_)
+    {
+        const std::string cpu_dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        CpuCaches caches;
+        caches.cpu = cpu;
+        caches.smt_siblings = parse_cpu_list(read_sysfs(cpu_dir + "/topology/thread_siblings_list"));
+        // Data and unified caches are listed as `index0`, `index1`, ... with their level and sharing
+        for (int index = 0;; ++index)
+        {
+            const std::string index_dir = cpu_dir + "/cache/index" + std::to_string(index);
+            const std::string level = read_sysfs(index_dir + "/level");
+            if (level.empty())
+            {
+                break;
+            }
+            if (read_sysfs(index_dir + "/type") == "Instruction")
+            {
+                continue;
+            }
+            std::vector<int> shared = parse_cpu_list(read_sysfs(index_dir + "/shared_cpu_list"));
+            if (level == "2")
+            {
+                caches.l2 = std::move(shared);
+            }
+            else if (level == "3")
+            {
+                caches.l3 = std::move(shared);
+            }
+        }
+        topology.caches_.push_back(std::move(caches));
+    }
+    return topology;
+}
+
+const std::vector<int> &CpuTopology::cpus() const
+{
+    return cpus_;
+}
+
+const CpuTopology::CpuCaches *CpuTopology::caches_of(int cpu) const
+{
+    auto it = std::find_if(caches_.begin(), caches_.end(), [cpu](const CpuCaches &caches)
+                           { return caches.cpu == cpu; });
+    return it == caches_.end() ? nullptr : &*it;
+}
+
+CpuDistance CpuTopology::distance(int first, int second) const
+{
+    const CpuCaches *caches = caches_of(first);
+    if (caches == nullptr)
+    {
+        return CpuDistance::CROSS_L3;
+    }
+    auto shares = [second](const std::vector<int> &cpus)
+    {
+        return std::binary_search(cpus.begin(), cpus.end(), second);
+    };
+    if (shares(caches->smt_siblings))
+    {
+        return CpuDistance::SMT_SIBLING;
+    }
+    if (shares(caches->l2))
+    {
+        return CpuDistance::SHARED_L2;
+    }
+    if (shares(caches->l3))
+    {
+        return CpuDistance::SHARED_L3;
+    }
+    return CpuDistance::CROSS_L3;
+}
+
+std::optional<CpuTopology::CpuPair> CpuTopology::find_pair(CpuDistance distance) const
+{
+    for (size_t i = 0; i < cpus_.size(); ++i)
+    {
+        for (size_t j = i + 1; j < cpus_.size(); ++j)
+        {
+            if (this->distance(cpus_[i], cpus_[j]) == distance)
+            {
+                return CpuPair{cpus_[i], cpus_[j]};
+            }
+        }
+    }
+    return std::nullopt;
+}
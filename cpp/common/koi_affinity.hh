@@ -0,0 +1,72 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// Placement helpers for pinning senders and receivers. The cost of a queue handoff is the cost of moving
+// the message's cache lines between the two cores, which depends on which caches the cores share.
+
+// How far apart two CPUs are in the cache hierarchy, nearest first
+enum class CpuDistance
+{
+    // Hardware threads of the same physical core, sharing L1 and L2
+    SMT_SIBLING,
+    // Different cores sharing an L2 cache (e.g. an Intel E-core cluster or Apple P-cluster)
+    SHARED_L2,
+    // Different cores sharing only the last level (L3) cache
+    SHARED_L3,
+    // Cores without a shared cache, e.g. on different sockets or chiplets. Lines move over the interconnect
+    CROSS_L3,
+};
+
+std::string to_string(CpuDistance distance);
+
+// Returns the CPUs the calling thread may run on, in ascending order.
+// Returns an empty vector where affinity is not supported (e.g. MacOS)
+std::vector<int> current_thread_cpus();
+
+// Restricts the calling thread to run on `cpus`. Returns `false` and logs a warning if affinity
+// is not supported (e.g. MacOS) or a CPU is not available to the process.
+bool pin_current_thread(const std::vector<int> &cpus);
+// Pins the calling thread to a single `cpu`
+bool pin_current_thread(int cpu);
+
+// Sharing of SMT siblings, L2 and L3 caches between the CPUs available to this process
+class CpuTopology
+{
+public:
+    struct CpuPair
+    {
+        int first;
+        int second;
+    };
+
+    // Reads the topology of the CPUs available to the calling thread from sysfs.
+    // Where the topology is unknown every pair of CPUs is treated as `CROSS_L3`
+    static CpuTopology probe();
+
+    const std::vector<int> &cpus() const;
+    // A CPU is its own `SMT_SIBLING`
+    CpuDistance distance(int first, int second) const;
+    // Returns the first pair of distinct CPUs at `distance`, if there is one
+    std::optional<CpuPair> find_pair(CpuDistance distance) const;
+
+private:
+    struct CpuCaches
+    {
+        int cpu;
+        // Sorted lists of the CPUs sharing each level with `cpu`, including `cpu`
+        std::vector<int> smt_siblings;
+        std::vector<int> l2;
+        std::vector<int> l3;
+    };
+
+    std::vector<int> cpus_;
+    std::vector<CpuCaches> caches_;
+
+    const CpuCaches *caches_of(int cpu) const;
+};
+
+// Parses a sysfs CPU list, e.g. "0-3,8,10-11". Returns an empty vector if `list` is malformed
+std::vector<int> parse_cpu_list(const std::string &list);
@@ -0,0 +1,74 @@
+#include "koi_doorbell.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+KoiDoorbell::KoiDoorbell(const std::string name, size_t num_sources) : num_sources_(num_sources)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    spdlog::info("Constructing KoiDoorbell with shm_name: {}, num_sources: {}", name, num_sources);
+    if (num_sources == 0)
+    {
+        throw std::invalid_argument("num_sources must be at least 1");
+    }
+    segment_.shm_name = std::move(name);
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = segment_.open();
+        // The bitmap starts on its own cache line after the header
+        const size_t header_sz = size_rounded_to_cache_line<DoorbellHeader>();
+        segment_.map(header_sz + num_words() * sizeof(std::atomic<uint64_t>));
+        words_ = reinterpret_cast<std::atomic<uint64_t> *>(segment_.shm_ptr + header_sz);
+        // The mapping keeps the segment alive, so the descriptor is not held. Every `KoiMuxSender` owns a doorbell,
+        // and a descriptor each would double the descriptors of a fan in
+        close(segment_.shm_fd);
+        segment_.shm_fd = -1;
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    DoorbellHeader *header = reinterpret_cast<DoorbellHeader *>(segment_.shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (header->cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, header->cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        if (header->num_sources != num_sources)
+        {
+            spdlog::error("num_sources provided: {}, existing num_sources: {}", num_sources, header->num_sources);
+            throw std::runtime_error("num_sources provided does not match existing shared memory");
+        }
+        return;
+    }
+    // The new segment is zero filled, so no source is marked
+    header->num_sources = num_sources;
+    header->cache_line_bytes = CACHE_LINE_BYTES;
+}
+
+KoiDoorbell::~KoiDoorbell()
+{
+    spdlog::debug("Starting KoiDoorbell destructor");
+    // Reset by `cleanup_shm`. The descriptor was closed after mapping
+    if (segment_.shm_ptr != nullptr)
+    {
+        munmap(segment_.shm_ptr, segment_.total_shm_size);
+    }
+}
+
+void KoiDoorbell::cleanup_shm() noexcept
+{
+    segment_.cleanup();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Number of sources per doorbell word
+constexpr size_t DOORBELL_WORD_BITS = 64;
+
+// Start of a doorbell segment, followed by the bitmap words
+struct DoorbellHeader
+{
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    alignas(CACHE_LINE_BYTES) size_t cache_line_bytes;
+    size_t num_sources;
+};
+
+// A bitmap with one bit per source queue, in its own named shm segment. The sender of a source sets its bit after
+// publishing, and the receiver clears a word of bits before it drains those sources, so a receiver of many queues
+// reads one word per 64 sources instead of the next slot of every queue.
+// As with the queues, the first participant creates the segment and later ones validate it.
+class KoiDoorbell
+{
+public:
+    // Throws `std::invalid_argument` if `num_sources` is 0, and `std::runtime_error` if an existing doorbell was
+    // created with a different `num_sources` or line size
+    KoiDoorbell(const std::string name, size_t num_sources);
+    KoiDoorbell(const KoiDoorbell &) = delete;
+    KoiDoorbell &operator=(const KoiDoorbell &) = delete;
+    // Unmaps the segment and closes its descriptor, since a receiver of many sources would otherwise hold one per
+    // sender. The segment is not unlinked, see `KoiQueue::~KoiQueue`
+    ~KoiDoorbell();
+
+    size_t num_sources() const
+    {
+        return num_sources_;
+    }
+
+    size_t num_words() const
+    {
+        return (num_sources_ + DOORBELL_WORD_BITS - 1) / DOORBELL_WORD_BITS;
+    }
+
+    // Sender: marks `source` as having messages. Called after publishing them
+    void ring(size_t source)
+    {
+        std::atomic<uint64_t> &word = words_[source / DOORBELL_WORD_BITS];
+        const uint64_t bit = uint64_t{1} << (source % DOORBELL_WORD_BITS);
+        // Orders the publishing store before the load of the bit. Pairs with the `exchange` in `take`, after which
+        // the receiver drains the source, so either the receiver sees the message or the sender sees the bit
+        // cleared and sets it again, as in `signal_if_armed`
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // A sender which publishes faster than the receiver takes the bit only reads the word
+        if ((word.load(std::memory_order_relaxed) & bit) == 0)
+        {
+            word.fetch_or(bit, std::memory_order_release);
+        }
+    }
+
+    // Receiver: returns and clears the bits of sources `[64 * word, 64 * word + 64)`
+    uint64_t take(size_t word)
+    {
+        // An idle word is only read, so it stays shared with the senders. A bit set meanwhile is taken next time
+        if (words_[word].load(std::memory_order_relaxed) == 0)
+        {
+            return 0;
+        }
+        return words_[word].exchange(0, std::memory_order_seq_cst);
+    }
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    ShmSegment segment_;
+    size_t num_sources_;
+    std::atomic<uint64_t> *words_;
+};
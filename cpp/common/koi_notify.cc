@@ -0,0 +1,120 @@
+#include "koi_notify.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <cerrno>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Returns whether `fd` is a FIFO. The path is in a world writable directory, so anything may already be there
+static bool is_fifo(int fd)
+{
+    struct stat fd_stat;
+    return fstat(fd, &fd_stat) == 0 && S_ISFIFO(fd_stat.st_mode);
+}
+
+std::string NotifyFifo::fifo_path(const std::string &shm_name)
+{
+    // POSIX shm names may start with a `/`, which is not part of the file name
+    std::string name = shm_name;
+    if (!name.empty() && name.front() == '/')
+    {
+        name.erase(0, 1);
+    }
+    return "/tmp/" + name + ".koi_notify";
+}
+
+int NotifyFifo::open_reader()
+{
+    if (read_fd != -1)
+    {
+        return read_fd;
+    }
+    // Only the owner may signal or drain the FIFO, as for the receiver's own descriptors
+    if (mkfifo(path.c_str(), 0600) == -1 && errno != EEXIST)
+    {
+        spdlog::error("mkfifo failed for {} with errno: {}", path, errno);
+        throw std::runtime_error("Failed to create notification FIFO");
+    }
+    // The read end must be opened first, opening a non-blocking write end without a reader fails with `ENXIO`
+    read_fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (read_fd == -1)
+    {
+        spdlog::error("Failed to open read end of {} with errno: {}", path, errno);
+        throw std::runtime_error("Failed to open notification FIFO");
+    }
+    // A regular file left at the path, e.g. by a crashed run, would always be readable and never drain
+    if (!is_fifo(read_fd))
+    {
+        spdlog::error("{} exists and is not a FIFO", path);
+        close();
+        throw std::runtime_error("Notification FIFO path is not a FIFO");
+    }
+    write_fd = ::open(path.c_str(), O_WRONLY | O_NONBLOCK);
+    if (write_fd == -1)
+    {
+        spdlog::error("Failed to open write end of {} with errno: {}", path, errno);
+        close();
+        throw std::runtime_error("Failed to open notification FIFO");
+    }
+    return read_fd;
+}
+
+void NotifyFifo::drain() noexcept
+{
+    char buffer[64];
+    while (::read(read_fd, buffer, sizeof(buffer)) > 0)
+    {
+    }
+}
+
+void NotifyFifo::signal() noexcept
+{
+    if (write_fd == -1)
+    {
+        // Opened read-write (supported for FIFOs on Linux and macOS) so the FIFO always has a reader,
+        // and a receiver closing its end never raises `SIGPIPE` in the sender
+        write_fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK);
+        if (write_fd == -1)
+        {
+            // No receiver has created the FIFO
+            return;
+        }
+        if (!is_fifo(write_fd))
+        {
+            // Never append to whatever else is at the path, see `open_reader`
+            spdlog::debug("{} is not a FIFO, not signalling", path);
+            ::close(write_fd);
+            write_fd = -1;
+            return;
+        }
+    }
+    const char byte = 1;
+    // `EAGAIN` means the FIFO is full, so it is already readable
+    if (::write(write_fd, &byte, 1) == -1 && errno != EAGAIN)
+    {
+        spdlog::debug("Failed to signal {} with errno: {}", path, errno);
+    }
+}
+
+void NotifyFifo::close() noexcept
+{
+    if (read_fd != -1)
+    {
+        ::close(read_fd);
+        read_fd = -1;
+    }
+    if (write_fd != -1)
+    {
+        ::close(write_fd);
+        write_fd = -1;
+    }
+}
+
+void NotifyFifo::unlink() noexcept
+{
+    // The FIFO only exists if a receiver requested a notification fd
+    ::unlink(path.c_str());
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Readiness notification state shared through the shm segment, used with `NotifyFifo`.
+// The receiver sets `enabled` once it exposes a pollable fd, and sets `armed` before it goes idle.
+// The sender only checks `armed` while `enabled` is set, and signals the fd once per arming,
+// so a busy queue never issues a system call.
+struct NotifyBlock
+{
+    std::atomic<uint32_t> enabled;
+    std::atomic<uint32_t> armed;
+};
+
+// A named FIFO next to a shm segment which becomes readable when the sender signals it.
+// Unlike an eventfd, a named FIFO can be opened by name from an unrelated process.
+// The receiver holds the read end, which it can register with `epoll`/`kqueue`/`poll`.
+// The sender opens the write end lazily on its first signal.
+struct NotifyFifo
+{
+    std::string path;
+    int read_fd = -1;
+    // Receiver: write end held open so the read end never reports end of file (`POLLHUP`) between senders.
+    // Sender: write end used to signal.
+    int write_fd = -1;
+
+    // Returns the path of the FIFO belonging to the shm segment `shm_name`
+    static std::string fifo_path(const std::string &shm_name);
+
+    // Creates the FIFO, readable and writable by the owner only, if it does not exist and opens its non-blocking
+    // read end. Returns the read end. Throws an error on failure, or if something other than a FIFO is at `path`
+    int open_reader();
+    // Reads all pending signals so the read end is no longer readable
+    void drain() noexcept;
+    // Makes the read end readable. Does nothing if no receiver has created the FIFO
+    void signal() noexcept;
+    // Closes any open ends of the FIFO
+    void close() noexcept;
+    // Removes the FIFO from the file system
+    void unlink() noexcept;
+};
+
+// Signals `fifo` if the receiver armed `block`. Called by the sender after publishing a message,
+// and only after checking `block.enabled`.
+inline void signal_if_armed(NotifyBlock &block, NotifyFifo &fifo)
+{
+    // Orders the publishing store before the load of `armed`. Pairs with the store to `armed` in the
+    // receiver, which rechecks the queue afterwards, so either the receiver sees the message or the sender
+    // sees the arming.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // The plain load keeps the cache line shared while the receiver is not armed.
+    // The `exchange` makes sure only one signal is sent per arming.
+    if (block.armed.load(std::memory_order_relaxed) != 0 && block.armed.exchange(0, std::memory_order_acq_rel) != 0)
+    {
+        fifo.signal();
+    }
+}
@@ -0,0 +1,200 @@
+#include "koi_shm.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h> /* For mode constants */
+#include <fcntl.h>    /* For O_* constants */
+#include <unistd.h>
+
+int ShmSegment::open()
+{
+    spdlog::debug("Checking if shared memory already exists");
+    int shm_status = SHM_CREATED;
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd == -1)
+    {
+        if (errno == EEXIST)
+        {
+            spdlog::debug("Shared memory already exists, opening existing shared memory");
+            fd = shm_open(shm_name.c_str(), O_RDWR, 0660);
+            if (fd == -1)
+            {
+                perror("shm_open");
+                throw std::runtime_error("Failed to open shared memory");
+            }
+            shm_status = SHM_EXISTS;
+        }
+        else
+        {
+            spdlog::error("Failed to create shared memory");
+            perror("shm_open");
+            throw std::runtime_error("Failed to create shared memory");
+        }
+    }
+    else
+    {
+        spdlog::debug("Shared memory did not exist");
+    }
+    shm_fd = fd;
+    return shm_status;
+}
+
+// Returns a `HUGE_PAGE_BYTES` aligned mapping of `size` bytes of `fd`, or `MAP_FAILED`.
+// `mmap` only guarantees base page alignment, so a larger range is reserved and trimmed to the aligned part.
+static void *map_huge_page_aligned(int fd, size_t size)
+{
+    const size_t reserve_sz = size + HUGE_PAGE_BYTES;
+    char *reserved = static_cast<char *>(mmap(NULL, reserve_sz, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (reserved == MAP_FAILED)
+    {
+        return MAP_FAILED;
+    }
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(reserved);
+    char *aligned = reinterpret_cast<char *>((addr + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1));
+    void *ptr = mmap(aligned, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    if (ptr == MAP_FAILED)
+    {
+        munmap(reserved, reserve_sz);
+        return MAP_FAILED;
+    }
+    // Release the unused head and tail of the reservation
+    if (aligned != reserved)
+    {
+        munmap(reserved, aligned - reserved);
+    }
+    const size_t tail_sz = reserved + reserve_sz - (aligned + size);
+    if (tail_sz != 0)
+    {
+        munmap(aligned + size, tail_sz);
+    }
+    return ptr;
+}
+
+void ShmSegment::map(size_t size, const ShmMapOptions &options)
+{
+    if (options.huge_pages)
+    {
+        size = (size + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    }
+
+    // Only grow the segment. Another process may have created it larger, e.g. rounded up for huge pages
+    struct stat shm_stat;
+    if (fstat(shm_fd, &shm_stat) == -1)
+    {
+        perror("fstat");
+        throw std::runtime_error("fstat failed");
+    }
+    if (static_cast<size_t>(shm_stat.st_size) < size)
+    {
+        spdlog::debug("ftruncate with total_shm_size: {}", size);
+        if (ftruncate(shm_fd, size) == -1)
+        {
+            // `ftruncate` on an already open file descriptor can fail with EINVAL
+            // https://stackoverflow.com/questions/20320742/ftruncate-failed-at-the-second-time
+            if (errno != EINVAL)
+            {
+                spdlog::error("ftruncate failed with errno: {}", errno);
+                spdlog::error("fd: {}, total_shm_size: {}", shm_fd, size);
+                perror("ftruncate");
+                throw std::runtime_error("ftruncate failed");
+            }
+        }
+    }
+
+    void *mapped = MAP_FAILED;
+    if (options.huge_pages)
+    {
+        mapped = map_huge_page_aligned(shm_fd, size);
+        if (mapped == MAP_FAILED)
+        {
+            spdlog::info("Huge page aligned mapping failed with errno: {}, falling back to default pages", errno);
+        }
+    }
+    if (mapped == MAP_FAILED)
+    {
+        int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+        // Huge pages are advised after mapping, so those mappings are prefaulted below instead
+        if (options.prefault && !options.huge_pages)
+        {
+            flags |= MAP_POPULATE;
+        }
+#endif
+        mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, shm_fd, 0);
+    }
+    if (mapped == MAP_FAILED)
+    {
+        perror("mmap");
+        throw std::runtime_error("Failed to map shared memory");
+    }
+    char *ptr = static_cast<char *>(mapped);
+    shm_ptr = ptr;
+    total_shm_size = size;
+
+    if (options.huge_pages)
+    {
+#ifdef MADV_HUGEPAGE
+        if (madvise(ptr, size, MADV_HUGEPAGE) == -1)
+        {
+            spdlog::info("madvise(MADV_HUGEPAGE) failed with errno: {}, using default pages", errno);
+        }
+#else
+        spdlog::info("Huge pages are not supported on this platform, using default pages");
+#endif
+    }
+
+#ifdef MAP_POPULATE
+    const bool populated = !options.huge_pages;
+#else
+    const bool populated = false;
+#endif
+    if (options.prefault && !populated)
+    {
+        // Reading a page of a shared mapping faults in the backing page, without writing to a segment
+        // other processes may already be using
+        const size_t page_sz = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        for (size_t i = 0; i < size; i += page_sz)
+        {
+            static_cast<void>(*static_cast<volatile char *>(ptr + i));
+        }
+    }
+
+    if (options.lock && mlock(ptr, size) == -1)
+    {
+        // Usually `RLIMIT_MEMLOCK` is too low, the mapping still works but may be paged out
+        spdlog::warn("mlock failed with errno: {}, shared memory is not locked", errno);
+    }
+}
+
+void ShmSegment::cleanup() noexcept
+{
+    spdlog::debug("Cleaning up shared memory");
+    if (shm_unlink(shm_name.c_str()) == -1)
+    {
+        // `shm_unlink` can fail if the shared memory was already unlinked by the client/server
+    }
+
+    // Can only unmap if the shared memory was successfully mapped
+    // This should be called after `shm_unlink` because the `mmap` occurs after
+    // the `shm_open` call in `open`.
+    if (shm_ptr != nullptr)
+    {
+        if (munmap(shm_ptr, total_shm_size) == -1)
+        {
+            // munmap can fail if the constructor threw an exception
+            // before the shared memory was mapped
+            // spdlog::error("munmap failed");
+        }
+        // Marks the segment as unmapped for later users of this `ShmSegment`
+        shm_ptr = nullptr;
+    }
+    // The open descriptor would otherwise keep the unlinked segment's memory alive
+    if (shm_fd != -1)
+    {
+        close(shm_fd);
+        shm_fd = -1;
+    }
+}
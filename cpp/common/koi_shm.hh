@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Named constants for `ShmSegment::open` return values for semantic typing
+constexpr int SHM_CREATED = 0;
+constexpr int SHM_EXISTS = 1;
+
+// Size of the huge pages requested by `ShmMapOptions::huge_pages`
+constexpr size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+// How `ShmSegment::map` maps the segment into this process. Each option falls back to the default
+// behavior (with a log message) when the system does not support it, so the options are safe to request anywhere.
+struct ShmMapOptions
+{
+    // Back the mapping with 2 MiB transparent huge pages to reduce TLB misses on large rings.
+    // The mapping is rounded up to and aligned on `HUGE_PAGE_BYTES`. Whether the kernel uses huge pages for shm
+    // depends on `/sys/kernel/mm/transparent_hugepage/shmem_enabled` being `advise` or `always`.
+    bool huge_pages = false;
+    // Fault in every page on mapping, so the first lap around the ring does not take page faults
+    bool prefault = false;
+    // Lock the mapping in memory with `mlock` so it is never paged out. Subject to `RLIMIT_MEMLOCK`
+    bool lock = false;
+};
+
+// A named shared memory segment mapped into the process address space.
+// Shared by all Koi queues so every queue type has the same persistent, handshake-free attach model:
+// the first participant creates the segment, later participants open and validate it.
+struct ShmSegment
+{
+    std::string shm_name;
+    int shm_fd = -1;
+    char *shm_ptr = nullptr;
+    size_t total_shm_size = 0;
+
+    // Opens the shared memory segment at `shm_name`, creating it if it does not exist.
+    // Returns `SHM_CREATED` if the shared memory was created, `SHM_EXISTS` if it already existed,
+    // and throws an error otherwise
+    int open();
+    // Sizes the segment to at least `total_shm_size` bytes and maps it. A newly created segment is zero filled.
+    // An existing segment is never shrunk, since that would truncate the mappings of other processes.
+    // Throws an error on failure
+    void map(size_t total_shm_size, const ShmMapOptions &options = {});
+    // Unlinks the named segment, unmaps it from this process and closes its descriptor.
+    // Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup() noexcept;
+};
@@ -0,0 +1,73 @@
+#include "koi_slot.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <stdexcept>
+#include <string>
+
+int SlotRing::open_ring(size_t buffer_bytes, size_t block_sz)
+{
+    // The ring buffer holds whole message blocks, any trailing bytes are unused
+    capacity = buffer_bytes / block_sz;
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("buffer_bytes provided " + std::to_string(buffer_bytes) +
+                                    " is smaller than the message block size of " + std::to_string(block_sz));
+    }
+    message_block_sz = block_sz;
+    user_shm_size = capacity * block_sz;
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = open();
+        // The shared memory is initialized with extra space bytes which holds the control block
+        const size_t control_block_sz = size_rounded_to_cache_line<SlotControlBlock>();
+        map(control_block_sz + user_shm_size);
+        // The ring buffer starts after the control block
+        user_shm_start = shm_ptr + control_block_sz;
+    }
+    catch (const std::exception &e)
+    {
+        // The queue's destructor will not be called. Clean up the shared memory file, if any
+        cleanup();
+        throw;
+    }
+
+    control_block = reinterpret_cast<SlotControlBlock *>(shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (control_block->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // Sanity check that the user_shm_size is the same as the existing shared memory
+        if (control_block->write.user_shm_size != user_shm_size)
+        {
+            spdlog::error("user_shm_size provided: {}, existing user_shm_size: {}", user_shm_size, control_block->write.user_shm_size);
+            throw std::runtime_error("user_shm_size provided does not match existing shared memory");
+        }
+        // Sanity check that the message block size is the same as the existing shared memory
+        if (control_block->write.message_block_sz != message_block_sz)
+        {
+            spdlog::error("message_block_sz_ provided: {}, existing message_block_sz: {}",
+                          message_block_sz, control_block->write.message_block_sz);
+            throw std::runtime_error("message_block_sz_ provided does not match existing shared memory");
+        }
+        return open_ret;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so every slot starts out in its zero state.
+    control_block->write.user_shm_size = user_shm_size;
+    control_block->write.message_block_sz = message_block_sz;
+    control_block->write.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block->write.position = 0;
+    control_block->read.user_shm_size = user_shm_size;
+    control_block->read.message_block_sz = message_block_sz;
+    control_block->read.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block->read.position = 0;
+    spdlog::debug("Control block initialized with user_shm_size: {}, message_block_sz: {}", user_shm_size, message_block_sz);
+    return open_ret;
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// `SlotHeader` precedes each message in the ring buffer of the queues where several processes claim positions
+// (`KoiMpscQueue`, `KoiSpmcQueue`, `KoiMpmcQueue`)
+struct SlotHeader
+{
+    // Encodes the state of the slot for the lap `position / capacity` of the position mapping to it:
+    // `2 * lap` when the slot is free for that lap's sender, `2 * lap + 1` once the message is published.
+    // The receiver of the message frees the slot for the next lap by storing `2 * lap + 2`. A zero filled segment
+    // is therefore a valid empty queue.
+    std::atomic<uint64_t> sequence;
+};
+
+// Contains read/write metadata of a `SlotRing` on one cacheline
+struct SlotControlBlockInner
+{
+    // Either the next position to be sent or to be received.
+    // Positions only increase, the slot is the position modulo the capacity, see `SlotCursor`
+    std::atomic<uint64_t> position;
+    // Duplicate the read only fields for the read/write cache line for prefetching.
+    // The values are identical between the read/write cache lines.
+    size_t user_shm_size;
+    size_t message_block_sz;
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+};
+
+// Shared information among all processes encoded in the shared memory of a `SlotRing`
+struct SlotControlBlock
+{
+    // The below are aligned to the nearest cache line to avoid false sharing
+    // "tail", shared by all producers of a multi producer queue
+    alignas(CACHE_LINE_BYTES) SlotControlBlockInner write;
+    // "head", shared by all consumers of a multi consumer queue
+    alignas(CACHE_LINE_BYTES) SlotControlBlockInner read;
+};
+
+// A process local position of one side of a `SlotRing`, with the slot and lap of the ring buffer it maps to.
+// Kept so the hot path wraps the slot with a compare and subtract instead of dividing the position
+struct SlotCursor
+{
+    uint64_t position = 0;
+    size_t slot = 0;
+    uint64_t lap = 0;
+};
+
+// A named segment holding a `SlotControlBlock` followed by a ring buffer of fixed size message blocks, each
+// addressed by an ever increasing position
+struct SlotRing : ShmSegment
+{
+    SlotControlBlock *control_block = nullptr;
+    // `shm_ptr` + sizeof(SlotControlBlock) (aligned to the nearest cache line)
+    // Start of the ring buffer
+    char *user_shm_start = nullptr;
+    size_t user_shm_size = 0;
+    size_t message_block_sz = 0;
+    size_t capacity = 0;
+
+    // Opens the segment `shm_name`, creating and initializing it if it does not exist, with as many message blocks
+    // of `message_block_sz` as fit in `buffer_bytes`. Returns `SHM_CREATED` or `SHM_EXISTS`.
+    // Throws `std::invalid_argument` if not even one block fits, and `std::runtime_error` if the existing segment
+    // was created with a different ring size, message block size or line size. If the segment cannot be opened or
+    // mapped, it is cleaned up before the error is rethrown
+    int open_ring(size_t buffer_bytes, size_t message_block_sz);
+
+    // Returns the header at the start of the message block `cursor` is on
+    SlotHeader *header_at(const SlotCursor &cursor) const
+    {
+        return reinterpret_cast<SlotHeader *>(user_shm_start + cursor.slot * message_block_sz);
+    }
+
+    // Moves `cursor` on to the next position
+    void advance(SlotCursor &cursor) const
+    {
+        ++cursor.position;
+        if (++cursor.slot == capacity)
+        {
+            cursor.slot = 0;
+            ++cursor.lap;
+        }
+    }
+
+    // Moves `cursor` forward to `position`. Positions less than a lap ahead, e.g. claimed by another process since
+    // the cursor last moved, are stepped to without a divide. Only a cursor restored from the control block or
+    // left a lap or more behind divides
+    void seek(SlotCursor &cursor, uint64_t position) const
+    {
+        const uint64_t ahead = position - cursor.position;
+        if (position >= cursor.position && ahead < capacity)
+        {
+            cursor.position = position;
+            cursor.slot += ahead;
+            if (cursor.slot >= capacity)
+            {
+                cursor.slot -= capacity;
+                ++cursor.lap;
+            }
+            return;
+        }
+        cursor.position = position;
+        cursor.lap = position / capacity;
+        cursor.slot = position - cursor.lap * capacity;
+    }
+};
+
+// A position claimed from a shared position counter, see `claim_free_slot`/`claim_published_slot`
+struct SlotClaim
+{
+    SlotHeader *header;
+    // The sequence the slot had when it was claimed
+    uint64_t sequence;
+};
+
+// Claims the next position of `counter` whose slot has the sequence `2 * lap + state`. A slot behind that state means
+// the ring is full (`state` 0) or empty (`state` 1), and `false` is returned. A slot ahead of it means another
+// process claimed the position since it was loaded, so the claim is retried from the reloaded position.
+// `cursor` is this process' last view of `counter`, and is left past the claimed position
+inline bool claim_slot(std::atomic<uint64_t> &counter, const SlotRing &ring, uint64_t state, SlotCursor &cursor, SlotClaim &claim)
+{
+    ring.seek(cursor, counter.load(std::memory_order_relaxed));
+    while (true)
+    {
+        SlotHeader *header = ring.header_at(cursor);
+        const uint64_t expected = 2 * cursor.lap + state;
+        // `memory_order_acquire` pairs with the store which moved the slot into `state`, so a producer does not
+        // overwrite a message still being copied out, and a consumer sees the whole published message
+        const uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+        if (sequence == expected)
+        {
+            // The claim is the only read-modify-write. On failure `position` is reloaded and the claim is retried
+            uint64_t position = cursor.position;
+            if (counter.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                claim = SlotClaim{header, sequence};
+                ring.advance(cursor);
+                return true;
+            }
+            ring.seek(cursor, position);
+        }
+        else if (sequence < expected)
+        {
+            return false;
+        }
+        else
+        {
+            ring.seek(cursor, counter.load(std::memory_order_relaxed));
+        }
+    }
+}
+
+// Claims the next free slot from the write position shared by several producers.
+// Returns `false` if the queue is full
+inline bool claim_free_slot(SlotRing &ring, SlotCursor &cursor, SlotClaim &claim)
+{
+    return claim_slot(ring.control_block->write.position, ring, 0, cursor, claim);
+}
+
+// Claims the next published message from the read position shared by several consumers.
+// Returns `false` if the queue is empty
+inline bool claim_published_slot(SlotRing &ring, SlotCursor &cursor, SlotClaim &claim)
+{
+    return claim_slot(ring.control_block->read.position, ring, 1, cursor, claim);
+}
+
+// Moves a claimed slot on to its next state once its message is copied in (published) or copied out (freed for
+// the next lap), handing the slot to the other side
+inline void complete_slot(const SlotClaim &claim)
+{
+    claim.header->sequence.store(claim.sequence + 1, std::memory_order_release);
+}
+
+// `SequencedSlotHeader` precedes each message in the ring buffers where the single sender may overwrite a message a
+// receiver has not read yet (`KoiLossyQueue`, `KoiBroadcastQueue`)
+struct SequencedSlotHeader
+{
+    // `position + 1` of the message in the slot once it is published. 0 before the first message and while the
+    // sender overwrites the slot, so a receiver can tell a message it is copying was replaced under it
+    std::atomic<uint64_t> sequence;
+};
+
+// Result of `read_sequenced_slot`
+enum class SequencedRead
+{
+    OK,
+    // The message has not been sent yet
+    EMPTY,
+    // The sender overwrote or is overwriting the message, and the copy must be discarded
+    LAPPED,
+};
+
+// Sender: copies the `size` bytes of `message` into the slot of `header` as the message of `position`
+inline void write_sequenced_slot(SequencedSlotHeader *header, char *slot_message, const char *message, size_t size, uint64_t position)
+{
+    // Invalidate the previous lap's message before overwriting it. The fence orders the store before the copy,
+    // so a receiver which copies part of the new message sees the sequence change
+    header->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::copy(message, message + size, slot_message);
+    header->sequence.store(position + 1, std::memory_order_release);
+}
+
+// Receiver: copies the message of `position` out of the slot of `header` into `size` bytes at `message`.
+// `write_position` is the sender's shared position, only loaded when the slot is being overwritten
+inline SequencedRead read_sequenced_slot(const SequencedSlotHeader *header, const char *slot_message, char *message, size_t size,
+                                         uint64_t position, const std::atomic<uint64_t> &write_position, size_t capacity)
+{
+    uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+    if (sequence == 0 && write_position.load(std::memory_order_acquire) >= position + capacity)
+    {
+        // The slot is being written, or was not yet published when the sequence was loaded. The message of
+        // `position` was published before the write position was stored, so reload the sequence to tell the two
+        // apart. A slot still being written is now being overwritten for a later lap
+        sequence = header->sequence.load(std::memory_order_acquire);
+        if (sequence == 0)
+        {
+            return SequencedRead::LAPPED;
+        }
+    }
+    if (sequence != position + 1)
+    {
+        // A later lap's message means the sender lapped the receiver. Otherwise the slot still holds the previous
+        // lap's message, or the message of `position` is being written
+        return sequence > position + 1 ? SequencedRead::LAPPED : SequencedRead::EMPTY;
+    }
+    std::copy(slot_message, slot_message + size, message);
+    // Seqlock style recheck, the copy is only valid if the slot was not overwritten during it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->sequence.load(std::memory_order_relaxed) != sequence)
+    {
+        return SequencedRead::LAPPED;
+    }
+    return SequencedRead::OK;
+}
+
+// Receiver: returns the position a receiver lapped at `read_position` resumes from, the oldest message which the
+// sender's next send at `write_position` does not overwrite. Always past `read_position`
+inline uint64_t position_after_lap(uint64_t read_position, uint64_t write_position, size_t capacity)
+{
+    const uint64_t oldest = write_position >= capacity ? write_position - capacity + 1 : 0;
+    return std::max(oldest, read_position + 1);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_slot.hh"
+#include "koi_utils.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The queues whose processes claim positions of a shared `SlotRing` (`KoiMpscQueue`, `KoiSpmcQueue`, `KoiMpmcQueue`).
+// Holds the ring and this process' cursors on its two positions. The queues only differ in which side claims from
+// its shared position with `claim_slot` and which side has a single owner advancing its cursor.
+template <typename T>
+class KoiSlotQueue
+{
+public:
+    // Returns total size of the shm segment that the user allocated
+    size_t user_shm_size() const;
+    // Returns the number of messages which fit in the ring buffer
+    size_t capacity() const;
+    // Returns the size of each message plus its header, rounded up to the nearest cache line
+    static constexpr size_t message_block_sz_bytes();
+    // Returns the number of sent messages which have not been received.
+    // Only a snapshot, producers and consumers may move concurrently
+    size_t size() const;
+    bool is_empty() const;
+
+protected:
+    // `buffer_bytes` is rounded down to a whole number of message blocks, and must hold at least one.
+    // `queue_name` names the concrete queue in the logs
+    KoiSlotQueue(const std::string name, size_t buffer_bytes, const char *queue_name);
+    virtual ~KoiSlotQueue();
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+    // Offset of the message from the start of its block. The header is padded so messages are aligned for `T`
+    static constexpr size_t message_offset_ = (sizeof(SlotHeader) + alignof(T) - 1) & ~(alignof(T) - 1);
+    static constexpr size_t message_block_sz_ = size_rounded_up_to_cache_line(message_offset_ + sizeof(T));
+    static constexpr size_t message_sz = sizeof(T);
+
+    // The shared positions and the ring buffer
+    SlotRing ring_;
+
+    // This process' views of the write and read positions. A side with a single owner advances its cursor and writes
+    // the position back, a side shared by several processes claims from the shared position, see `claim_slot`
+    SlotCursor write_cursor_;
+    SlotCursor read_cursor_;
+
+    char *message_at(SlotHeader *header) const;
+};
+
+// Ensure all dependencies are declared
+#include "koi_slot_queue.tcc"
@@ -0,0 +1,86 @@
+#include "koi_slot_queue.hh"
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <string>
+#include <type_traits>
+
+// If the shm segment at `shm_name` has already been created, then the provided `buffer_bytes` must round down to
+// the same ring size as the existing shared memory, and the message block size must match the existing one.
+template <typename T>
+KoiSlotQueue<T>::KoiSlotQueue(const std::string shm_name, size_t buffer_bytes, const char *queue_name)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    // `send`/`recv` will do a bitwise memcpy of T into the shared memory
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+
+    spdlog::info("Constructing {} with shm_name: {}, buffer_bytes: {} bytes", queue_name, shm_name, buffer_bytes);
+    spdlog::info("{} running with message_sz: {}, message_block_sz: {} bytes", queue_name, message_sz, message_block_sz_);
+    ring_.shm_name = std::move(shm_name);
+    // Validates an existing segment against `buffer_bytes` and the message block size, or initializes a created one
+    const int open_ret = ring_.open_ring(buffer_bytes, message_block_sz_);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Pick up where the previous producer and consumer left off. A claiming side's cursor would also catch up on
+        // its first claim
+        ring_.seek(write_cursor_, ring_.control_block->write.position.load(std::memory_order_relaxed));
+        ring_.seek(read_cursor_, ring_.control_block->read.position.load(std::memory_order_relaxed));
+    }
+}
+
+template <typename T>
+KoiSlotQueue<T>::~KoiSlotQueue()
+{
+    spdlog::debug("Starting KoiSlotQueue destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`
+}
+
+template <typename T>
+void KoiSlotQueue<T>::cleanup_shm() noexcept
+{
+    ring_.cleanup();
+}
+
+template <typename T>
+size_t KoiSlotQueue<T>::user_shm_size() const
+{
+    return ring_.user_shm_size;
+}
+
+template <typename T>
+size_t KoiSlotQueue<T>::capacity() const
+{
+    return ring_.capacity;
+}
+
+template <typename T>
+constexpr size_t KoiSlotQueue<T>::message_block_sz_bytes()
+{
+    return message_block_sz_;
+}
+
+template <typename T>
+size_t KoiSlotQueue<T>::size() const
+{
+    const uint64_t read_position = ring_.control_block->read.position.load(std::memory_order_acquire);
+    const uint64_t write_position = ring_.control_block->write.position.load(std::memory_order_acquire);
+    // The positions are loaded one after the other, and a single producer writes its position back after publishing,
+    // so a consumer may have claimed a message the write position does not count yet
+    return write_position > read_position ? static_cast<size_t>(write_position - read_position) : 0;
+}
+
+template <typename T>
+bool KoiSlotQueue<T>::is_empty() const
+{
+    return size() == 0;
+}
+
+template <typename T>
+char *KoiSlotQueue<T>::message_at(SlotHeader *header) const
+{
+    return reinterpret_cast<char *>(header) + message_offset_;
+}
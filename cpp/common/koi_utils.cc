@@ -1,7 +1,48 @@
 #include "koi_utils.hh"
 
+#include "spdlog/spdlog.h"
+
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
 void load_spdlog_level()
 {
     // SPDLOG_LEVEL=info,mylogger=trace && ./executable
     spdlog::cfg::load_env_levels();
-}
\ No newline at end of file
+}
+// Returns the L1 data cache line size reported by the OS, or 0 if it is unknown
+static size_t probe_cache_line_bytes()
+{
+#if defined(__APPLE__)
+    size_t line_bytes = 0;
+    size_t len = sizeof(line_bytes);
+    if (sysctlbyname("hw.cachelinesize", &line_bytes, &len, nullptr, 0) != 0)
+    {
+        return 0;
+    }
+    return line_bytes;
+#elif defined(_SC_LEVEL1_DCACHE_LINESIZE)
+    const long line_bytes = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+    return line_bytes > 0 ? static_cast<size_t>(line_bytes) : 0;
+#else
+    return 0;
+#endif
+}
+
+size_t check_cache_line_bytes()
+{
+    static const size_t line_bytes = []()
+    {
+        const size_t probed = probe_cache_line_bytes();
+        if (probed > CACHE_LINE_BYTES)
+        {
+            spdlog::warn("Koi was built with CACHE_LINE_BYTES {} but this machine has {} byte cache lines. "
+                         "Rebuild with -DKOI_CACHE_LINE_BYTES={} to avoid false sharing",
+                         CACHE_LINE_BYTES, probed, probed);
+        }
+        return probed;
+    }();
+    return line_bytes;
+}
@@ -1,25 +1,54 @@
 #pragma once
 #include "spdlog/cfg/env.h"
 
-// MacOS M1 Max cache line size is 128 bytes
+#include <cstddef>
+#include <new>
+
+// Every message block and control block field is padded to `CACHE_LINE_BYTES` to avoid false sharing.
+// Set with the `KOI_CACHE_LINE_BYTES` build option, which CMake defaults to the line size of the build machine.
+// Otherwise the compiler's `hardware_destructive_interference_size` is used, falling back to the
+// MacOS M1 Max cache line size of 128 bytes.
+#if defined(KOI_CACHE_LINE_BYTES)
+constexpr size_t CACHE_LINE_BYTES = KOI_CACHE_LINE_BYTES;
+#elif defined(__cpp_lib_hardware_interference_size)
+// GCC warns that the value depends on `-mtune`. Segments record the line size they were created with
+// and refuse to attach with a different one, so a mismatch is caught at runtime
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+constexpr size_t CACHE_LINE_BYTES = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
 constexpr size_t CACHE_LINE_BYTES = 128;
+#endif
+static_assert(CACHE_LINE_BYTES >= 16 && (CACHE_LINE_BYTES & (CACHE_LINE_BYTES - 1)) == 0,
+              "CACHE_LINE_BYTES must be a power of 2 of at least 16 bytes");
 
 void load_spdlog_level();
 
+// Logs a warning, once per process, if the running machine reports a larger cache line than `CACHE_LINE_BYTES`,
+// in which case neighbouring blocks share lines. Returns the reported line size, or 0 if it is unknown.
+size_t check_cache_line_bytes();
+
+// Return value of `send` for all Koi queues
+enum KoiQueueRet
+{
+    // Assigned 0 as in "False" for unsuccessful operation
+    QUEUE_FULL = 0,
+    OK = 1,
+};
+
 template <typename T>
 constexpr std::size_t size_rounded_to_cache_line()
 {
     return (sizeof(T) + CACHE_LINE_BYTES - 1) & ~(CACHE_LINE_BYTES - 1);
 }
 
-// Returns the smallest number greater or equal to the sizeof(T) which is CACHE_LINE_BYTES * N
-// where N is a power of 2
-constexpr std::size_t size_rounded_up_to_pow_2_cache_line(size_t s)
+// Returns the smallest multiple of CACHE_LINE_BYTES greater or equal to `s`
+constexpr std::size_t size_rounded_up_to_cache_line(size_t s)
 {
-    // While not a multiple of a cache line or not a power of two
-    while (s & (CACHE_LINE_BYTES - 1) || s & (s - 1))
-    {
-        s++;
-    }
-    return s;
-}
\ No newline at end of file
+    return (s + CACHE_LINE_BYTES - 1) & ~(CACHE_LINE_BYTES - 1);
+}
@@ -0,0 +1,52 @@
+#include "koi_wait.hh"
+
+#include <algorithm>
+#include <climits>
+#include <ctime>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Without futexes, parked waiters poll at this interval
+constexpr std::chrono::microseconds FALLBACK_SLEEP_INTERVAL{50};
+
+void futex_wait(std::atomic<uint32_t> &word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+    if (timeout <= std::chrono::nanoseconds::zero())
+    {
+        return;
+    }
+#ifdef __linux__
+    // `std::atomic<uint32_t>` has the same representation as `uint32_t`
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+    // `FUTEX_WAIT` without `FUTEX_PRIVATE_FLAG` since the word is shared between processes
+    struct timespec ts;
+    struct timespec *ts_ptr = nullptr;
+    if (timeout != std::chrono::nanoseconds::max())
+    {
+        ts.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(timeout).count();
+        ts.tv_nsec = (timeout % std::chrono::seconds(1)).count();
+        ts_ptr = &ts;
+    }
+    // Errors (`EAGAIN` if the word already changed, `ETIMEDOUT`, `EINTR`) are all handled by the caller rechecking
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, ts_ptr, nullptr, 0);
+#else
+    if (word.load(std::memory_order_acquire) == expected)
+    {
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(timeout, FALLBACK_SLEEP_INTERVAL));
+    }
+#endif
+}
+
+void futex_wake_all(std::atomic<uint32_t> &word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    // Waiters poll, see `futex_wait`
+    (void)word;
+#endif
+}
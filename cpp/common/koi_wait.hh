@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+// How a blocking queue operation (e.g. `send_wait`, `recv_wait`) waits for its peer
+enum class WaitStrategy
+{
+    // Retry in a tight loop. Lowest latency, burns a full core while waiting
+    BUSY_SPIN,
+    // Retry with an exponentially growing number of CPU pause instructions between attempts
+    BACKOFF,
+    // Spin briefly, then yield the CPU to the scheduler between attempts
+    YIELD,
+    // Spin, pause, then yield, then park the thread on a futex until the peer wakes it.
+    // The peer must also use `FUTEX` so that it checks for parked waiters after each operation.
+    FUTEX,
+};
+
+// Retries spent in each phase of the `YIELD` and `FUTEX` strategies before moving to the next
+constexpr size_t WAIT_SPIN_ITERATIONS = 1 << 7;
+constexpr size_t WAIT_YIELD_ITERATIONS = 1 << 4;
+// Upper bound on the number of CPU pause instructions between `BACKOFF` retries
+constexpr size_t WAIT_MAX_BACKOFF_PAUSES = 1 << 6;
+
+// A futex word and the number of threads parked on it, placed in shared memory.
+// A waiter registers in `waiters`, rechecks the queue, then sleeps while `seq` is unchanged.
+// The peer bumps `seq` and wakes the futex only if `waiters` is non zero, so an idle peer costs nothing.
+struct WaitBlock
+{
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> waiters;
+};
+
+// Hint to the CPU that this is a spin wait loop
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Sleeps while `word` equals `expected`, until woken by `futex_wake_all` or `timeout` passes.
+// May return early (spuriously), callers must recheck their condition.
+// The futex is shared between processes since `word` lives in shared memory.
+// Platforms without futexes sleep for a short interval instead.
+void futex_wait(std::atomic<uint32_t> &word, uint32_t expected, std::chrono::nanoseconds timeout);
+// Wakes all threads sleeping in `futex_wait` on `word`
+void futex_wake_all(std::atomic<uint32_t> &word);
+
+// Wakes the threads parked on `block`, if any. Called after publishing an update the waiters may be waiting for.
+inline void notify_waiters(WaitBlock &block)
+{
+    // Orders the caller's publishing store before the load of `waiters`. Pairs with the `fetch_add` on `waiters`
+    // in `wait_for`, so either the waiter sees the update on its recheck or the caller sees the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (block.waiters.load(std::memory_order_relaxed) != 0) [[unlikely]]
+    {
+        block.seq.fetch_add(1, std::memory_order_release);
+        futex_wake_all(block.seq);
+    }
+}
+
+// Calls `try_once` until it returns `true` or `timeout` passes, waiting between attempts according to `strategy`.
+// `block` is only used by `WaitStrategy::FUTEX`, and must be notified with `notify_waiters` by the peer.
+// Returns `false` on timeout. A `timeout` of `std::chrono::nanoseconds::max()` waits indefinitely.
+template <typename F>
+bool wait_for(F &&try_once, WaitStrategy strategy, WaitBlock &block, std::chrono::nanoseconds timeout)
+{
+    using clock = std::chrono::steady_clock;
+    const bool has_deadline = timeout != std::chrono::nanoseconds::max();
+    const clock::time_point deadline = has_deadline ? clock::now() + timeout : clock::time_point::max();
+
+    size_t backoff_pauses = 1;
+    for (size_t attempt = 0;; attempt++)
+    {
+        if (try_once())
+        {
+            return true;
+        }
+        // Reading the clock is not free, so the deadline is only checked periodically while spinning
+        if (has_deadline && (attempt % WAIT_SPIN_ITERATIONS == 0 || attempt >= WAIT_SPIN_ITERATIONS) &&
+            clock::now() >= deadline)
+        {
+            return false;
+        }
+
+        switch (strategy)
+        {
+        case WaitStrategy::BUSY_SPIN:
+            break;
+        case WaitStrategy::BACKOFF:
+            for (size_t i = 0; i < backoff_pauses; i++)
+            {
+                cpu_relax();
+            }
+            if (backoff_pauses < WAIT_MAX_BACKOFF_PAUSES)
+            {
+                backoff_pauses *= 2;
+            }
+            break;
+        case WaitStrategy::YIELD:
+            if (attempt < WAIT_SPIN_ITERATIONS)
+            {
+                cpu_relax();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+            break;
+        case WaitStrategy::FUTEX:
+            if (attempt < WAIT_SPIN_ITERATIONS)
+            {
+                cpu_relax();
+            }
+            else if (attempt < WAIT_SPIN_ITERATIONS + WAIT_YIELD_ITERATIONS)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                // `memory_order_seq_cst` orders the registration before the recheck, see `notify_waiters`
+                block.waiters.fetch_add(1, std::memory_order_seq_cst);
+                const uint32_t seq = block.seq.load(std::memory_order_acquire);
+                const bool done = try_once();
+                if (!done)
+                {
+                    futex_wait(block.seq, seq, has_deadline ? deadline - clock::now() : std::chrono::nanoseconds::max());
+                }
+                block.waiters.fetch_sub(1, std::memory_order_relaxed);
+                if (done)
+                {
+                    return true;
+                }
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// `KeySlotHeader` precedes the latest value of each key in the slot table
+struct KeySlotHeader
+{
+    // Seqlock sequence of the value, odd while the sender is copying a new value in, see `KoiSnapshot`
+    std::atomic<uint64_t> sequence;
+    // Non zero while the key is in the pending ring and not yet taken by the receiver
+    std::atomic<uint32_t> pending;
+};
+
+// Contains read/write metadata on one cacheline
+struct ConflatingControlBlockInner
+{
+    // Either the next position in the pending ring to be written or to be read.
+    // Positions only increase, the ring entry is the position modulo the ring capacity
+    std::atomic<uint64_t> position;
+    // Duplicate the read only fields for the read/write cache line for prefetching.
+    // The values are identical between the read/write cache lines.
+    size_t num_keys;
+    size_t key_slot_sz;
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+};
+
+// Shared information among all processes encoded in the shared memory
+struct ConflatingControlBlock
+{
+    // The below are aligned to the nearest cache line to avoid false sharing
+    // "tail"
+    alignas(CACHE_LINE_BYTES) ConflatingControlBlockInner write;
+    // "head"
+    alignas(CACHE_LINE_BYTES) ConflatingControlBlockInner read;
+};
+
+// A key and its latest value, as received from a `KoiConflatingQueue`
+template <typename T>
+struct KeyedValue
+{
+    uint32_t key;
+    T value;
+};
+
+// Forward declaration of KoiConflatingQueueRAII
+template <typename T>
+class KoiConflatingQueueRAII;
+
+// A single producer single consumer queue of updates to a fixed set of keys `[0, num_keys)`, which coalesces the
+// updates to each key. The sender overwrites the key's slot in a table of latest values and only enqueues the key
+// if it is not already pending, so a receiver which falls behind receives each updated key once, with its latest
+// value, instead of every superseded update. Keys are received in the order they first became pending.
+//
+// Shared memory layout: control block, then the slot table of `num_keys` cache line padded slots, then the ring of
+// pending keys.
+template <typename T>
+class KoiConflatingQueue
+{
+public:
+    // Returns the number of keys
+    size_t num_keys() const;
+    // Returns the size of each key's slot (header and value), rounded up to the nearest cache line
+    static constexpr size_t key_slot_sz_bytes();
+    // Returns the number of keys pending. Only a snapshot, the sender and receiver may move concurrently
+    size_t size() const;
+    bool is_empty() const;
+
+protected:
+    // `num_keys` must be at least 1 and fit in a `uint32_t`
+    explicit KoiConflatingQueue(const std::string name, size_t num_keys);
+    virtual ~KoiConflatingQueue();
+
+    // Replaces the latest value of `key` and makes the key pending if it is not already. Always returns
+    // `KoiQueueRet::OK`, the queue never fills since each key is pending at most once.
+    // Throws `std::out_of_range` if `key` is not less than `num_keys()`
+    KoiQueueRet send(uint32_t key, const T &value);
+    // Returns the next pending key with its latest value, or `std::nullopt` if no key is pending.
+    // A key is not received again until it has a newer value
+    std::optional<KeyedValue<T>> recv();
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    // Offset of the value from the start of its slot. The header is padded so values are aligned for `T`
+    static constexpr size_t value_offset_ = (sizeof(KeySlotHeader) + alignof(T) - 1) & ~(alignof(T) - 1);
+    static constexpr size_t key_slot_sz_ = size_rounded_up_to_cache_line(value_offset_ + sizeof(T));
+    static constexpr size_t value_sz = sizeof(T);
+
+    ConflatingControlBlock *control_block_;
+
+    struct ShmMetadata : ShmSegment
+    {
+        // `shm_ptr` + sizeof(ConflatingControlBlock) (aligned to the nearest cache line)
+        // Start of the slot table
+        char *key_slots_start;
+        // Start of the pending ring, after the slot table
+        std::atomic<uint32_t> *pending_ring;
+        size_t num_keys;
+        // One more entry than keys. The receiver clears a key's `pending` flag before it moves past the key's
+        // entry, so the key may be pending again while its old entry is still in the ring
+        size_t ring_capacity;
+        // Entries wrap around the pending ring with a mask, see `slot_after`
+        bool pow_2_ring;
+    };
+
+    ShmMetadata shm_metadata_;
+
+    // Process local copies of the write and read positions, see `KoiQueue::write_offset_`
+    uint64_t write_position_ = 0;
+    uint64_t read_position_ = 0;
+    // Entries of `write_position_` and `read_position_` in the pending ring, so the hot path does not divide
+    size_t write_slot_ = 0;
+    size_t read_slot_ = 0;
+    // Receiver: last write position loaded from the control block, reloaded when the receiver catches up
+    uint64_t cached_write_position_ = 0;
+    // Receiver: slot sequence of the last value received for each key, allocated on the first `recv`
+    std::vector<uint64_t> delivered_sequences_;
+
+    KeySlotHeader *slot_header(uint32_t key) const;
+    char *slot_value(uint32_t key) const;
+    // Returns the pending ring entry after `slot`, wrapping around the ring
+    size_t slot_after(size_t slot) const;
+
+    // Allow `KoiConflatingQueueRAII` to access private and protected members, particularly `cleanup_shm`
+    friend class KoiConflatingQueueRAII<T>;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiConflatingQueueRAII : public KoiConflatingQueue<T>
+{
+public:
+    explicit KoiConflatingQueueRAII(const std::string name, size_t num_keys) : KoiConflatingQueue<T>(name, num_keys)
+    {
+    }
+
+    ~KoiConflatingQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiConflatingQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiConflatingQueue<T>::send;
+    using KoiConflatingQueue<T>::recv;
+
+private:
+    using KoiConflatingQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_conflating_queue.tcc"
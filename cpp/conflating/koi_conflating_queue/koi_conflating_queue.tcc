@@ -0,0 +1,243 @@
+#include "koi_conflating_queue.hh"
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// If the shm segment at `shm_name` has already been created, then `num_keys` and the key slot size must match the
+// existing shared memory.
+template <typename T>
+KoiConflatingQueue<T>::KoiConflatingQueue(const std::string shm_name, size_t num_keys)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    // `send`/`recv` will do a bitwise memcpy of T into the shared memory
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+
+    spdlog::info("Constructing KoiConflatingQueue with shm_name: {}, num_keys: {}", shm_name, num_keys);
+    spdlog::info("KoiConflatingQueue running with value_sz: {}, key_slot_sz: {} bytes", value_sz, key_slot_sz_);
+    shm_metadata_.shm_name = std::move(shm_name);
+
+    if (num_keys == 0 || num_keys > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::invalid_argument("num_keys provided " + std::to_string(num_keys) + " must be in [1, 2^32)");
+    }
+    shm_metadata_.num_keys = num_keys;
+    shm_metadata_.ring_capacity = num_keys + 1;
+    shm_metadata_.pow_2_ring = (shm_metadata_.ring_capacity & (shm_metadata_.ring_capacity - 1)) == 0;
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = shm_metadata_.open();
+        // The slot table and the pending ring follow the control block
+        const size_t control_block_sz = size_rounded_to_cache_line<ConflatingControlBlock>();
+        const size_t key_slots_sz = num_keys * key_slot_sz_;
+        const size_t ring_sz = shm_metadata_.ring_capacity * sizeof(std::atomic<uint32_t>);
+        shm_metadata_.map(control_block_sz + key_slots_sz + ring_sz);
+        shm_metadata_.key_slots_start = shm_metadata_.shm_ptr + control_block_sz;
+        shm_metadata_.pending_ring = reinterpret_cast<std::atomic<uint32_t> *>(shm_metadata_.key_slots_start + key_slots_sz);
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    control_block_ = reinterpret_cast<ConflatingControlBlock *>(shm_metadata_.shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (control_block_->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block_->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // Sanity check that the number of keys is the same as the existing shared memory
+        if (control_block_->write.num_keys != num_keys)
+        {
+            spdlog::error("num_keys provided: {}, existing num_keys: {}", num_keys, control_block_->write.num_keys);
+            throw std::runtime_error("num_keys provided does not match existing shared memory");
+        }
+        // Sanity check that the key slot size is the same as the existing shared memory
+        if (control_block_->write.key_slot_sz != key_slot_sz_)
+        {
+            spdlog::error("key_slot_sz_ provided: {}, existing key_slot_sz: {}", key_slot_sz_, control_block_->write.key_slot_sz);
+            throw std::runtime_error("key_slot_sz_ provided does not match existing shared memory");
+        }
+        // Pick up where the previous sender and receiver left off
+        write_position_ = control_block_->write.position.load(std::memory_order_relaxed);
+        read_position_ = control_block_->read.position.load(std::memory_order_relaxed);
+        cached_write_position_ = read_position_;
+        write_slot_ = write_position_ % shm_metadata_.ring_capacity;
+        read_slot_ = read_position_ % shm_metadata_.ring_capacity;
+        return;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so no key is pending.
+    control_block_->write.num_keys = num_keys;
+    control_block_->write.key_slot_sz = key_slot_sz_;
+    control_block_->write.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->write.position = 0;
+    control_block_->read.num_keys = num_keys;
+    control_block_->read.key_slot_sz = key_slot_sz_;
+    control_block_->read.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->read.position = 0;
+    spdlog::debug("Control block initialized with num_keys: {}, key_slot_sz: {}", num_keys, key_slot_sz_);
+}
+
+template <typename T>
+KoiConflatingQueue<T>::~KoiConflatingQueue()
+{
+    spdlog::debug("Starting KoiConflatingQueue destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`
+}
+
+template <typename T>
+void KoiConflatingQueue<T>::cleanup_shm() noexcept
+{
+    shm_metadata_.cleanup();
+}
+
+template <typename T>
+size_t KoiConflatingQueue<T>::num_keys() const
+{
+    return shm_metadata_.num_keys;
+}
+
+template <typename T>
+constexpr size_t KoiConflatingQueue<T>::key_slot_sz_bytes()
+{
+    return key_slot_sz_;
+}
+
+template <typename T>
+size_t KoiConflatingQueue<T>::size() const
+{
+    const uint64_t read_position = control_block_->read.position.load(std::memory_order_acquire);
+    const uint64_t write_position = control_block_->write.position.load(std::memory_order_acquire);
+    return write_position > read_position ? static_cast<size_t>(write_position - read_position) : 0;
+}
+
+template <typename T>
+bool KoiConflatingQueue<T>::is_empty() const
+{
+    return size() == 0;
+}
+
+template <typename T>
+KoiQueueRet KoiConflatingQueue<T>::send(uint32_t key, const T &value)
+{
+    if (key >= shm_metadata_.num_keys)
+    {
+        throw std::out_of_range("key " + std::to_string(key) + " is not less than num_keys " + std::to_string(shm_metadata_.num_keys));
+    }
+    KeySlotHeader *header = slot_header(key);
+    // Replace the value under the seqlock, see `KoiSnapshot::publish`
+    const uint64_t start = header->sequence.load(std::memory_order_relaxed);
+    header->sequence.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    const char *value_ptr = reinterpret_cast<const char *>(&value);
+    std::copy(value_ptr, value_ptr + value_sz, slot_value(key));
+    header->sequence.store(start + 2, std::memory_order_release);
+
+    // If the key was already pending, the receiver will read the new value when it reaches the key.
+    // Otherwise the receiver has taken the key (or never had it), so the key is enqueued again
+    if (header->pending.exchange(1, std::memory_order_acq_rel) == 0)
+    {
+        shm_metadata_.pending_ring[write_slot_].store(key, std::memory_order_relaxed);
+        write_slot_ = slot_after(write_slot_);
+        ++write_position_;
+        control_block_->write.position.store(write_position_, std::memory_order_release);
+    }
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+std::optional<KeyedValue<T>> KoiConflatingQueue<T>::recv()
+{
+    if (read_position_ == cached_write_position_)
+    {
+        cached_write_position_ = control_block_->write.position.load(std::memory_order_acquire);
+    }
+
+    if (delivered_sequences_.empty())
+    {
+        delivered_sequences_.assign(shm_metadata_.num_keys, 0);
+    }
+    KeyedValue<T> keyed_value;
+    while (read_position_ != cached_write_position_)
+    {
+        keyed_value.key = shm_metadata_.pending_ring[read_slot_].load(std::memory_order_relaxed);
+        KeySlotHeader *header = slot_header(keyed_value.key);
+        // Take the key before reading its value, so an update sent after the read makes the key pending again.
+        // A read-modify-write, so it reads from the `exchange` of any update which found the key still pending,
+        // and that update's value is visible below
+        header->pending.exchange(0, std::memory_order_acq_rel);
+        const char *value_ptr = slot_value(keyed_value.key);
+        uint64_t start;
+        while (true)
+        {
+            start = header->sequence.load(std::memory_order_acquire);
+            if (start & 1)
+            {
+                // The sender is replacing the value
+                continue;
+            }
+            std::copy(value_ptr, value_ptr + value_sz, reinterpret_cast<char *>(&keyed_value.value));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->sequence.load(std::memory_order_relaxed) == start)
+            {
+                break;
+            }
+        }
+        read_slot_ = slot_after(read_slot_);
+        ++read_position_;
+        // Write back for `size()` and for a later receiver
+        control_block_->read.position.store(read_position_, std::memory_order_release);
+        // An update which lands between taking the key and reading the value is read early, and enqueues the key
+        // again. Its second entry has no newer value, so it is skipped
+        if (start != delivered_sequences_[keyed_value.key])
+        {
+            delivered_sequences_[keyed_value.key] = start;
+            return keyed_value;
+        }
+    }
+    return std::nullopt;
+}
+
+template <typename T>
+KeySlotHeader *KoiConflatingQueue<T>::slot_header(uint32_t key) const
+{
+    return reinterpret_cast<KeySlotHeader *>(shm_metadata_.key_slots_start + key * key_slot_sz_);
+}
+
+template <typename T>
+char *KoiConflatingQueue<T>::slot_value(uint32_t key) const
+{
+    return reinterpret_cast<char *>(slot_header(key)) + value_offset_;
+}
+
+template <typename T>
+size_t KoiConflatingQueue<T>::slot_after(size_t slot) const
+{
+    // As in `KoiQueue::offset_after`, a mask for a power of 2 ring, otherwise a compare and subtract
+    if (shm_metadata_.pow_2_ring)
+    {
+        return (slot + 1) & (shm_metadata_.ring_capacity - 1);
+    }
+    size_t next_slot = slot + 1;
+    if (next_slot >= shm_metadata_.ring_capacity)
+    {
+        next_slot -= shm_metadata_.ring_capacity;
+    }
+    return next_slot;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "koi_conflating_queue.hh"
+
+namespace koi
+{
+    // An IPC receiver which receives each updated key once, with its latest value
+    template <typename T>
+    class KoiConflatingReceiver : public KoiConflatingQueue<T>
+    {
+    public:
+        KoiConflatingReceiver(const std::string name, size_t num_keys) : KoiConflatingQueue<T>(name, num_keys)
+        {
+        }
+
+        using KoiConflatingQueue<T>::recv;
+    };
+} // namespace koi
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "koi_conflating_queue.hh"
+
+namespace koi
+{
+    // An IPC sender of per key updates, which are coalesced while the receiver has not taken the key
+    template <typename T>
+    class KoiConflatingSender : public KoiConflatingQueue<T>
+    {
+    public:
+        KoiConflatingSender(const std::string name, size_t num_keys) : KoiConflatingQueue<T>(name, num_keys)
+        {
+        }
+
+        using KoiConflatingQueue<T>::send;
+        // The sender may clean up the shared memory segment once the receiver has finished
+        using KoiConflatingQueue<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -1,10 +1,15 @@
 #pragma once
 
+#include "koi_notify.hh"
+#include "koi_shm.hh"
 #include "koi_utils.hh"
+#include "koi_wait.hh"
 
+#include <chrono>
 #include <string>
 #include <optional>
 #include <atomic>
+#include <span>
 
 // `MessageHeader` precedes each message block
 struct MessageHeader
@@ -14,15 +19,21 @@ struct MessageHeader
 };
 
 // Maximum size of message message block selected as a multiple of `CACHE_LINE_BYTES`,
-// arbitrarily set to 2^10 * `CACHE_LINE_BYTES`
-constexpr size_t MAX_MESSAGE_BLOCK_BYTES = (1 << 10) * CACHE_LINE_BYTES;
+// arbitrarily set to 2^10 lines of 128 bytes. Fixed in bytes so the limit does not depend on the build's line size
+constexpr size_t MAX_MESSAGE_BLOCK_BYTES = 1 << 17;
+static_assert(MAX_MESSAGE_BLOCK_BYTES % CACHE_LINE_BYTES == 0, "MAX_MESSAGE_BLOCK_BYTES must be a multiple of CACHE_LINE_BYTES");
 constexpr size_t MAX_MESSAGE_SIZE_BYTES = MAX_MESSAGE_BLOCK_BYTES - sizeof(MessageHeader);
 
-enum KoiQueueRet
+// Where the `MessageHeader` of each slot is stored. Recorded in the `ControlBlock` so every participant agrees.
+enum class SlotLayout : uint32_t
 {
-    // Assigned 0 as in "False" for unsuccessful operation
-    QUEUE_FULL = 0,
-    OK = 1,
+    // The header is at the start of each message block, on the same cache line as the start of the message.
+    // Message blocks are padded to a multiple of `CACHE_LINE_BYTES`
+    INLINE_HEADER,
+    // The headers are packed in an array after the ring buffer, and the messages are stored back to back.
+    // A message of exactly one cache line then takes one cache line, but the headers of neighbouring
+    // slots share cache lines
+    SEPARATE_HEADERS,
 };
 
 // Contains read/write metadata on one cacheline
@@ -34,6 +45,13 @@ struct ControlBlockInner
     // The values are identical between the read/write cache lines.
     size_t user_shm_size;
     size_t message_block_sz;
+    SlotLayout slot_layout;
+    // Whether the sides wake parked peers, i.e. use `WaitStrategy::FUTEX`. A side which does not would leave a
+    // `FUTEX` peer parked forever, so every side must agree and a mismatch is rejected on attach.
+    bool futex_wait;
+    // `CACHE_LINE_BYTES` of the process which created the segment. The `write` half is at the start of the
+    // segment for any line size, so this is readable before the rest of the layout is trusted.
+    size_t cache_line_bytes;
 };
 
 // Shared information among all processes encoded in the shared memory
@@ -45,12 +63,19 @@ struct ControlBlock
     alignas(CACHE_LINE_BYTES) ControlBlockInner write;
     // "head"
     alignas(CACHE_LINE_BYTES) ControlBlockInner read;
+    // Receivers parked in `recv_wait` waiting for a message
+    alignas(CACHE_LINE_BYTES) WaitBlock data_ready;
+    // Senders parked in `send_wait` waiting for a free slot
+    alignas(CACHE_LINE_BYTES) WaitBlock space_ready;
+    // Readiness notification through `notify_fd`
+    alignas(CACHE_LINE_BYTES) NotifyBlock notify;
 };
 
 inline std::ostream &operator<<(std::ostream &os, const ControlBlockInner &b)
 {
     os << "Offset: " << b.offset << ", user shm size: " << b.user_shm_size
-       << ", message block sz: " << b.message_block_sz << std::endl;
+       << ", message block sz: " << b.message_block_sz
+       << ", slot layout: " << static_cast<uint32_t>(b.slot_layout) << std::endl;
     return os;
 }
 
@@ -60,12 +85,54 @@ inline std::ostream &operator<<(std::ostream &os, const ControlBlock &b)
     return os;
 }
 
+// Process local tuning of the queue protocol. Each option only applies to the side of the queue which uses it,
+// so a sender and receiver may be configured independently.
+// The defaults give the FastForward protocol where every operation checks or clears one message header.
+struct KoiQueueOptions
+{
+    // Sender: when the sender runs out of known free slots, it probes the header `send_lookahead` slots ahead.
+    // The receiver frees slots in ring order, so if that slot is free every slot before it is too, and the next
+    // `send_lookahead` sends skip the header check. This keeps the sender off the cache lines the receiver is
+    // reading in the near empty regime. Clamped to the queue capacity.
+    size_t send_lookahead = 1;
+    // Receiver: the receiver defers clearing `occupied` flags and releases consumed slots to the sender in groups
+    // of `release_batch`, or earlier when it finds the queue empty. Clamped to one less than the queue capacity.
+    // Consumed slots no longer count towards `size()`, so the sender may find the queue full before
+    // `size()` reaches `capacity()`. `is_full()` reflects the slots the sender can use.
+    size_t release_batch = 1;
+    // How `send_wait`/`recv_wait` wait for the peer. With `WaitStrategy::FUTEX` this side also wakes a parked
+    // peer after each operation, at the cost of a fence per operation, so both sides must use it to park.
+    // Whether the segment uses `FUTEX` is fixed by the side which creates it, see `ControlBlockInner::futex_wait`.
+    WaitStrategy wait_strategy = WaitStrategy::BUSY_SPIN;
+    // How the shm segment is mapped into this process (huge pages, prefaulting, locking), see `ShmMapOptions`.
+    // The segment is only ever grown when a side maps it, so the sides may choose differently.
+    ShmMapOptions mapping = {};
+};
+
+// `Capacity` template argument for queues whose capacity is only known at runtime
+constexpr size_t DYNAMIC_CAPACITY = 0;
+
+// Queue size in number of messages, for constructors which otherwise take the ring buffer size in bytes
+struct QueueCapacity
+{
+    size_t messages;
+};
+
 // Forward declaration of KoiQueueRAII
-template <typename T>
+template <typename T, size_t Capacity = DYNAMIC_CAPACITY, SlotLayout Layout = SlotLayout::INLINE_HEADER>
 class KoiQueueRAII;
 
 // Terminology: "message block" = "message header" + "message"
-template <typename T>
+//
+// With the default `SlotLayout::INLINE_HEADER` each message block is padded to the next multiple of
+// `CACHE_LINE_BYTES`. With `SlotLayout::SEPARATE_HEADERS` the message block is only the message, and its header is
+// stored out of line. The queue may hold any number of messages.
+//
+// `Capacity` is the number of messages the queue holds. With the default `DYNAMIC_CAPACITY` the ring buffer size
+// is passed to the constructor at runtime. Otherwise the ring buffer size and wrap around are compile time
+// constants, and if the ring buffer size is a power of 2 the wrap around is a mask. Both interoperate on the
+// same shm segment, since the ring buffer geometry is validated against the control block on attach either way.
+template <typename T, size_t Capacity = DYNAMIC_CAPACITY, SlotLayout Layout = SlotLayout::INLINE_HEADER>
 class KoiQueue
 {
 public:
@@ -76,7 +143,7 @@ public:
     // Returns total bytes remaining in the shm segment that the user allocated
     size_t shm_remaining_bytes() const;
     // Returns the message block size in bytes
-    constexpr size_t message_block_sz_bytes() const;
+    static constexpr size_t message_block_sz_bytes();
     // Returns the current queue size in bytes
     size_t curr_queue_sz_bytes() const;
     // Returns if the queue is full
@@ -89,57 +156,183 @@ public:
     size_t capacity() const;
 
 protected:
-    // `buffer_bytes` will be rounded up to the nearest multiple of `CACHE_LINE_BYTES`
-    explicit KoiQueue(const std::string name, size_t buffer_bytes);
+    // `buffer_bytes` is rounded down to a whole number of message blocks, and must hold at least one.
+    // With a compile time `Capacity`, this must give `Capacity * message_block_sz_bytes()`
+    explicit KoiQueue(const std::string name, size_t buffer_bytes, KoiQueueOptions options = {});
+    // Ring buffer holding `capacity.messages` messages
+    explicit KoiQueue(const std::string name, QueueCapacity capacity, KoiQueueOptions options = {})
+        : KoiQueue(name, ring_bytes_of(capacity), options)
+    {
+    }
+    // Compile time capacity, the ring buffer size is `Capacity * message_block_sz_bytes()`
+    explicit KoiQueue(const std::string name, KoiQueueOptions options = {})
+        requires(Capacity != DYNAMIC_CAPACITY)
+        : KoiQueue(name, static_user_shm_size_, options)
+    {
+    }
     virtual ~KoiQueue();
 
     // Returns `KoiQueueRet::QUEUE_FULL` if the queue is full, otherwise `KoiQueueRet::OK`
     KoiQueueRet send(T message);
     std::optional<T> recv();
 
+    // Blocking variants of `send`/`recv` which wait up to `timeout` for the peer, according to
+    // `KoiQueueOptions::wait_strategy`. `send_wait` returns `KoiQueueRet::QUEUE_FULL` and `recv_wait` returns
+    // `std::nullopt` on timeout. The default `timeout` waits indefinitely.
+    KoiQueueRet send_wait(T message, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+    std::optional<T> recv_wait(std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+    // Copies the next message into `message` without the `std::optional` wrapper.
+    // Returns `false` if the queue is empty
+    bool recv_into(T &message);
+
+    // Zero-copy receive. Returns a view of the message in the next occupied slot, or `nullptr` if the queue is empty.
+    // The view stays valid until `release` hands the slot back to the sender.
+    const T *peek();
+    // Releases the slot returned by the last successful `peek`. Must not be called otherwise.
+    // With `KoiQueueOptions::release_batch` the slot may only be handed back to the sender by a later call.
+    void release();
+    // Hands all consumed slots back to the sender, see `KoiQueueOptions::release_batch`
+    void flush_releases();
+
+    // Readiness notification for event loops. Returns a non-blocking file descriptor, owned by the queue, which
+    // can be registered with `epoll`/`kqueue`/`poll` and becomes readable when a message arrives while armed.
+    // The sender only signals the descriptor on the empty to non-empty edge, after the receiver calls `arm_notify`.
+    // Usage: when the descriptor is readable, `recv` until the queue is empty, then `arm_notify`. If that returns
+    // `false`, messages arrived in the meantime so `recv` again instead of going back to the event loop.
+    int notify_fd();
+    // Clears the descriptor and arms it for the next message. Returns `false` (without arming) if the queue is
+    // not empty. Throws if `notify_fd` was not called
+    bool arm_notify();
+
+    // Zero-copy send. Returns a pointer to the message in the next free slot, or `nullptr` if the queue is full.
+    // The caller writes the message in place, then `commit` publishes it to the receiver.
+    T *reserve();
+    // Publishes the slot returned by the last successful `reserve`. Must not be called otherwise.
+    void commit();
+    // Constructs a message in place in the next free slot and publishes it.
+    // Returns `KoiQueueRet::QUEUE_FULL` if the queue is full, otherwise `KoiQueueRet::OK`
+    template <typename... Args>
+    KoiQueueRet emplace(Args &&...args);
+
+    // Batched variants of `send`/`recv`. The number of free (or occupied) slots is checked once,
+    // the whole run is copied, and the offset is published once for the batch.
+    // Returns the number of messages sent, which is less than `messages.size()` if the queue fills up
+    size_t send_batch(std::span<const T> messages);
+    // Returns the number of messages received into the front of `messages`
+    size_t recv_batch(std::span<T> messages);
+    // Invokes `fn(const T &)` on up to `max_messages` queued messages, in order. Each message is passed
+    // in place in the shared memory, and the slots are released together after the last `fn` call returns.
+    // Returns the number of messages handled
+    template <typename F>
+    size_t drain(F &&fn, size_t max_messages);
+
     // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
     void cleanup_shm() noexcept;
 
 private:
+    static constexpr bool inline_header_ = Layout == SlotLayout::INLINE_HEADER;
+    // Offset of the message from the start of its block. The header is padded so the message is aligned for `T`
+    static constexpr size_t message_offset_ =
+        inline_header_ ? (sizeof(MessageHeader) + alignof(T) - 1) & ~(alignof(T) - 1) : 0;
     // The size of a "message block" (the message header + the message itself)
-    // Round message block size up to a multiple of cache line
-    static constexpr size_t message_block_sz_ = size_rounded_up_to_pow_2_cache_line(sizeof(MessageHeader) + sizeof(T));
+    // Round message block size up to a multiple of cache line. Out of line headers leave only the message,
+    // whose size is already a multiple of its alignment
+    static constexpr size_t message_block_sz_ =
+        inline_header_ ? size_rounded_up_to_cache_line(message_offset_ + sizeof(T)) : sizeof(T);
     static constexpr size_t message_sz = sizeof(T);
+    // Ring buffer size in bytes when `Capacity` is known at compile time, otherwise 0
+    static constexpr size_t static_user_shm_size_ = Capacity * message_block_sz_;
+    // The ring buffer size in bytes is a compile time power of 2, so offsets wrap around with a mask.
+    // Requires both `Capacity` and the message block size to be powers of 2
+    static constexpr bool pow_2_ring_ =
+        Capacity != DYNAMIC_CAPACITY && (static_user_shm_size_ & (static_user_shm_size_ - 1)) == 0;
     ControlBlock *control_block_;
 
-    struct ShmMetadata
+    // The named segment (`shm_name`, `shm_fd`, `shm_ptr`, `total_shm_size`) plus the ring buffer geometry
+    struct ShmMetadata : ShmSegment
     {
-        std::string shm_name;
-        int shm_fd;
-        char *shm_ptr;
         // `shm_ptr` + sizeof(ControlBlock) (aligned to the nearest cache line)
         // Start of implicit ring buffer data structure
         char *user_shm_start;
+        // `SlotLayout::SEPARATE_HEADERS`: the header of each slot, after the ring buffer (aligned to the nearest
+        // cache line)
+        MessageHeader *headers = nullptr;
         size_t message_sz = sizeof(T);
-        size_t total_shm_size;
         size_t user_shm_size;
     };
 
     ShmMetadata shm_metadata_;
 
+    // Process local copies of the write and read offsets. Only one process owns each side of the queue, so the
+    // hot path reads its own offset here instead of from the control block. The offsets are still written back
+    // to the control block after each operation for `size()` and introspection by the other side.
+    size_t write_offset_ = 0;
+    size_t read_offset_ = 0;
+
+    // Sender: number of slots from `write_offset_` known to be free, see `KoiQueueOptions::send_lookahead`
+    size_t free_slots_ = 0;
+    size_t send_lookahead_ = 1;
+    // Receiver: number of consumed slots before `read_offset_` whose `occupied` flags are not yet cleared,
+    // see `KoiQueueOptions::release_batch`
+    size_t pending_releases_ = 0;
+    size_t release_batch_ = 1;
+    WaitStrategy wait_strategy_ = WaitStrategy::BUSY_SPIN;
+    ShmMapOptions map_options_ = {};
+
+    // Receiver: the read end of the notification FIFO. Sender: the write end, opened on the first signal
+    NotifyFifo notify_fifo_;
+    // Sender: signals the notification FIFO if the receiver is waiting on it, after publishing messages
+    void notify_receiver();
+
+    // Returns the header of the message block at `offset`
+    MessageHeader *header_at(size_t offset) const;
+    // Returns the start of the message in the message block at `offset`
+    char *message_at(size_t offset) const;
+    // Returns the offset of the message block `n` blocks after `offset`, wrapping around the ring buffer.
+    // `n` must be less than the number of blocks in the ring buffer
+    size_t offset_after(size_t offset, size_t n) const;
+    // Returns the ring buffer size in bytes, a constant when `Capacity` is known at compile time
+    size_t ring_sz_bytes() const;
+    // Returns the ring buffer size in bytes of `capacity.messages` message blocks.
+    // Throws `std::invalid_argument` if it does not fit in a `size_t`
+    static size_t ring_bytes_of(QueueCapacity capacity);
+    // Returns the number of free slots from `write_offset_` found by probing the headers, 0 if the queue is full
+    size_t probe_free_slots() const;
+    // Publishes `next_read_offset` after `num_slots` slots were consumed, and releases them once `release_batch_`
+    // slots are pending
+    void consume_slots(size_t num_slots, size_t next_read_offset);
+
     // Initialization order is `open_shm` then `init_shm`
     int open_shm();
-    int init_shm(int);
+    int init_shm();
 
     // Allow `KoiQueueRAII` to access private and protectedmembers, particularly `cleanup_shm`
-    friend class KoiQueueRAII<T>;
+    friend class KoiQueueRAII<T, Capacity, Layout>;
 };
 
 // RAII class to optionally cleanup the shared memory segment
 // Typically this is not desirable so the shm segment can be used by other processes later
 // but this is useful for test cleanup
-template <typename T>
-class KoiQueueRAII : public KoiQueue<T>
+template <typename T, size_t Capacity, SlotLayout Layout>
+class KoiQueueRAII : public KoiQueue<T, Capacity, Layout>
 {
 public:
     // `explicit` constructor optional since the class takes two arguments which is difficult
     // to accidentally invoke with an implicit conversion
-    explicit KoiQueueRAII(const std::string name, size_t buffer_bytes) : KoiQueue<T>(name, buffer_bytes)
+    explicit KoiQueueRAII(const std::string name, size_t buffer_bytes, KoiQueueOptions options = {})
+        : KoiQueue<T, Capacity, Layout>(name, buffer_bytes, options)
+    {
+    }
+
+    explicit KoiQueueRAII(const std::string name, QueueCapacity capacity, KoiQueueOptions options = {})
+        : KoiQueue<T, Capacity, Layout>(name, capacity, options)
+    {
+    }
+
+    explicit KoiQueueRAII(const std::string name, KoiQueueOptions options = {})
+        requires(Capacity != DYNAMIC_CAPACITY)
+        : KoiQueue<T, Capacity, Layout>(name, options)
     {
     }
 
@@ -149,11 +342,25 @@ public:
         cleanup_shm();
     }
 
-    using KoiQueue<T>::send;
-    using KoiQueue<T>::recv;
+    using KoiQueue<T, Capacity, Layout>::send;
+    using KoiQueue<T, Capacity, Layout>::recv;
+    using KoiQueue<T, Capacity, Layout>::send_wait;
+    using KoiQueue<T, Capacity, Layout>::recv_wait;
+    using KoiQueue<T, Capacity, Layout>::recv_into;
+    using KoiQueue<T, Capacity, Layout>::peek;
+    using KoiQueue<T, Capacity, Layout>::release;
+    using KoiQueue<T, Capacity, Layout>::flush_releases;
+    using KoiQueue<T, Capacity, Layout>::notify_fd;
+    using KoiQueue<T, Capacity, Layout>::arm_notify;
+    using KoiQueue<T, Capacity, Layout>::reserve;
+    using KoiQueue<T, Capacity, Layout>::commit;
+    using KoiQueue<T, Capacity, Layout>::emplace;
+    using KoiQueue<T, Capacity, Layout>::send_batch;
+    using KoiQueue<T, Capacity, Layout>::recv_batch;
+    using KoiQueue<T, Capacity, Layout>::drain;
 
 private:
-    using KoiQueue<T>::cleanup_shm;
+    using KoiQueue<T, Capacity, Layout>::cleanup_shm;
 };
 
 // Ensure all dependencies are declared
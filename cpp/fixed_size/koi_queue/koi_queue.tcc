@@ -1,50 +1,68 @@
 
 #include "koi_queue.hh"
+#include "koi_shm.hh"
 #include "koi_utils.hh"
 
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
 #include <string>
-#include <sys/mman.h>
-#include <sys/stat.h> /* For mode constants */
-#include <fcntl.h>    /* For O_* constants */
-#include <unistd.h>
-
-// Named constants for `open_shm` return values for semantic typing
-constexpr int SHM_CREATED = 0;
-constexpr int SHM_EXISTS = 1;
 
 // If the shm segment at `shm_name` has already been created, then the provided `user_shm_size` must be
 // the same as the existing shared memory size and the `message_block_sz_` must be the same as the
 // existing shared memory message block size encoded in the shared memory control block.
-template <typename T>
-KoiQueue<T>::KoiQueue(const std::string shm_name, size_t user_shm_size)
+template <typename T, size_t Capacity, SlotLayout Layout>
+KoiQueue<T, Capacity, Layout>::KoiQueue(const std::string shm_name, size_t user_shm_size, KoiQueueOptions options)
 {
     load_spdlog_level();
+    check_cache_line_bytes();
     // `send`/`recv` will do a bitwise memcpy of T into the shared memory
     static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
     static_assert(message_sz <= MAX_MESSAGE_SIZE_BYTES, "Message size is larger than the max message size");
-
-    // TODO: Add check that the message size is not larger than the shm size
+    // `reserve` hands out pointers into the shared memory, so the payload must be aligned for `T`
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+    static_assert(message_offset_ + message_sz <= MAX_MESSAGE_BLOCK_BYTES, "Aligned message block is larger than the max message block size");
 
     spdlog::info("Constructing KoiQueue with shm_name: {}, user_shm_size: {} bytes", shm_name, user_shm_size);
-    spdlog::info("KoiQueue running with message_sz: {}, header size: {} bytes, message_block_sz: {} bytes", message_sz, sizeof(MessageHeader), message_block_sz_);
+    spdlog::info("KoiQueue running with message_sz: {}, header size: {} bytes, message_block_sz: {} bytes", message_sz, message_offset_, message_block_sz_);
+    notify_fifo_.path = NotifyFifo::fifo_path(shm_name);
     shm_metadata_.shm_name = std::move(shm_name);
 
-    // The `user_shm_size` must be a power of 2
-    if ((user_shm_size & (user_shm_size - 1)) != 0)
+    // The ring buffer holds whole message blocks, any trailing bytes are unused
+    const size_t capacity = user_shm_size / message_block_sz_;
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("user_shm_size provided " + std::to_string(user_shm_size) +
+                                    " is smaller than the message block size of " + std::to_string(message_block_sz_));
+    }
+    user_shm_size = capacity * message_block_sz_;
+
+    if (Capacity != DYNAMIC_CAPACITY && user_shm_size != static_user_shm_size_)
     {
         throw std::invalid_argument("user_shm_size provided " + std::to_string(user_shm_size) +
-                                    " is not a power of 2");
+                                    " does not match the compile time capacity of " + std::to_string(Capacity) +
+                                    " messages (" + std::to_string(static_user_shm_size_) + " bytes)");
     }
     shm_metadata_.user_shm_size = user_shm_size;
 
+    // A deferred release must never cover the whole ring buffer, otherwise the receiver would wrap around
+    // onto its own unreleased slots and read them again
+    send_lookahead_ = std::clamp<size_t>(options.send_lookahead, 1, std::max<size_t>(capacity, 1));
+    release_batch_ = std::clamp<size_t>(options.release_batch, 1, std::max<size_t>(capacity, 2) - 1);
+    wait_strategy_ = options.wait_strategy;
+    map_options_ = options.mapping;
+    spdlog::debug("KoiQueue options send_lookahead: {}, release_batch: {}, wait_strategy: {}",
+                  send_lookahead_, release_batch_, static_cast<int>(wait_strategy_));
+
     int open_ret = -1;
     try
     {
         open_ret = open_shm();
-        init_shm(open_ret);
+        init_shm();
     }
     catch (const std::exception &e)
     {
@@ -59,6 +77,19 @@ KoiQueue<T>::KoiQueue(const std::string shm_name, size_t user_shm_size)
     {
         // The shared memory already exists, so the control block is already initialized
         // Read the control block from the shared memory
+        // The control block layout depends on the line size, so it is checked before any other field
+        if (control_block_->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block_->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // The slot layout decides where every header is, so it must match before the geometry is compared
+        if (control_block_->write.slot_layout != Layout)
+        {
+            spdlog::error("slot_layout provided: {}, existing slot_layout: {}", static_cast<uint32_t>(Layout),
+                          static_cast<uint32_t>(control_block_->write.slot_layout));
+            throw std::runtime_error("slot_layout provided does not match existing shared memory");
+        }
         // Sanity check that the user_shm_size is the same as the existing shared memory
         // The `write.user_shm_size` is arbitrarily selected. The `read` shm size would have worked equally well.
         if (control_block_->write.user_shm_size != user_shm_size)
@@ -74,21 +105,55 @@ KoiQueue<T>::KoiQueue(const std::string shm_name, size_t user_shm_size)
                           message_block_sz_, control_block_->write.message_block_sz);
             throw std::runtime_error("message_block_sz_ provided does not match existing shared memory");
         }
+        // A side which does not wake parked peers would leave a `FUTEX` peer parked forever
+        if (control_block_->write.futex_wait != (wait_strategy_ == WaitStrategy::FUTEX))
+        {
+            spdlog::error("wait_strategy provided: {}, existing segment futex_wait: {}", static_cast<int>(wait_strategy_),
+                          control_block_->write.futex_wait);
+            throw std::runtime_error("wait_strategy provided does not match the FUTEX use of the existing shared memory");
+        }
+        // Pick up where the previous sender or receiver left off
+        write_offset_ = control_block_->write.offset.load(std::memory_order_relaxed);
+        read_offset_ = control_block_->read.offset.load(std::memory_order_relaxed);
         return;
     }
     // The shared memory was created, so initialize the control block
     control_block_->write.user_shm_size = user_shm_size;
     control_block_->write.message_block_sz = message_block_sz_;
+    control_block_->write.slot_layout = Layout;
+    control_block_->write.futex_wait = wait_strategy_ == WaitStrategy::FUTEX;
+    control_block_->write.cache_line_bytes = CACHE_LINE_BYTES;
     control_block_->write.offset = 0;
     control_block_->read.user_shm_size = user_shm_size;
     control_block_->read.message_block_sz = message_block_sz_;
+    control_block_->read.slot_layout = Layout;
+    control_block_->read.futex_wait = wait_strategy_ == WaitStrategy::FUTEX;
+    control_block_->read.cache_line_bytes = CACHE_LINE_BYTES;
     control_block_->read.offset = 0;
+    control_block_->data_ready.seq = 0;
+    control_block_->data_ready.waiters = 0;
+    control_block_->space_ready.seq = 0;
+    control_block_->space_ready.waiters = 0;
+    control_block_->notify.enabled = 0;
+    control_block_->notify.armed = 0;
     spdlog::debug("Control block initialized with user_shm_size: {}, message_block_sz: {}",
                   control_block_->write.user_shm_size, control_block_->write.message_block_sz);
 }
 
-template <typename T>
-KoiQueue<T>::~KoiQueue()
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::ring_bytes_of(QueueCapacity capacity)
+{
+    if (capacity.messages > std::numeric_limits<size_t>::max() / message_block_sz_)
+    {
+        throw std::invalid_argument("capacity provided " + std::to_string(capacity.messages) +
+                                    " messages overflows the ring buffer size with a message block size of " +
+                                    std::to_string(message_block_sz_));
+    }
+    return capacity.messages * message_block_sz_;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+KoiQueue<T, Capacity, Layout>::~KoiQueue()
 {
     spdlog::debug("Starting KoiQueue destructor");
     // Previously cleaned up the shm in the destructor, but this
@@ -98,29 +163,27 @@ KoiQueue<T>::~KoiQueue()
     // 3) allow subsequent senders/receivers to use the same shared memory segment after prior
     //    participants have finished
     // cleanup_shm();
-}
 
-template <typename T>
-void KoiQueue<T>::cleanup_shm() noexcept
-{
-    spdlog::debug("Cleaning up shared memory");
-    if (shm_unlink(shm_metadata_.shm_name.c_str()) == -1)
+    // Hand deferred releases back to the sender so a later receiver starts from a consistent queue.
+    // `shm_ptr` is unset if the segment was already cleaned up (e.g. by `KoiQueueRAII`)
+    if (pending_releases_ > 0 && shm_metadata_.shm_ptr != nullptr)
     {
-        // `shm_unlink` can fail if the shared memory was already unlinked by the client/server
+        flush_releases();
     }
-
-    // Can only unmap if the shared memory was successfully mapped
-    // This should be called after `shm_unlink` because the `mmap` occurs after
-    // the `shm_open` call in `init_shm`.
-    if (shm_metadata_.shm_ptr != nullptr)
+    // Stop the sender from signalling a FIFO nobody reads
+    if (notify_fifo_.read_fd != -1 && shm_metadata_.shm_ptr != nullptr)
     {
-        if (munmap(shm_metadata_.shm_ptr, shm_metadata_.total_shm_size) == -1)
-        {
-            // munmap can fail if the constructor threw an exception
-            // before the shared memory was mapped
-            // spdlog::error("munmap failed");
-        }
+        control_block_->notify.enabled.store(0, std::memory_order_relaxed);
+        control_block_->notify.armed.store(0, std::memory_order_relaxed);
     }
+    notify_fifo_.close();
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+void KoiQueue<T, Capacity, Layout>::cleanup_shm() noexcept
+{
+    shm_metadata_.cleanup();
+    notify_fifo_.unlink();
 }
 
 // Initialization order is `open_shm` then `init_shm`
@@ -128,207 +191,490 @@ void KoiQueue<T>::cleanup_shm() noexcept
 // - `SHM_CREATED` if the shared memory was created
 // - `SHM_EXISTS` if the shared memory already exists
 // - Throws an error otherwise
-template <typename T>
-int KoiQueue<T>::open_shm()
+template <typename T, size_t Capacity, SlotLayout Layout>
+int KoiQueue<T, Capacity, Layout>::open_shm()
 {
-    spdlog::debug("Checking if shared memory already exists");
-    int shm_status = SHM_CREATED;
-    int shm_fd = shm_open(shm_metadata_.shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
-    if (shm_fd == -1)
-    {
-        if (errno == EEXIST)
-        {
-            spdlog::debug("Shared memory already exists, opening existing shared memory");
-            shm_fd = shm_open(shm_metadata_.shm_name.c_str(), O_RDWR, 0660);
-            if (shm_fd == -1)
-            {
-                perror("shm_open");
-                throw std::runtime_error("Failed to open shared memory");
-            }
-            shm_status = SHM_EXISTS;
-        }
-        else
-        {
-            spdlog::error("Failed to create shared memory");
-            perror("shm_open");
-            throw std::runtime_error("Failed to create shared memory");
-        }
-    }
-    else
-    {
-        spdlog::debug("Shared memory did not exist");
-    }
-    shm_metadata_.shm_fd = shm_fd;
-    return shm_status;
+    return shm_metadata_.open();
 }
 
 // Returns 0 on success, throws an error otherwise
-template <typename T>
-int KoiQueue<T>::init_shm(int shm_status)
+template <typename T, size_t Capacity, SlotLayout Layout>
+int KoiQueue<T, Capacity, Layout>::init_shm()
 {
     // The shared memory is initialized with extra space bytes which holds the control block
     size_t control_block_sz = size_rounded_to_cache_line<ControlBlock>();
     size_t total_shm_size = control_block_sz + shm_metadata_.user_shm_size;
-    spdlog::debug("ftruncate with total_shm_size: {}", total_shm_size);
-    if (ftruncate(shm_metadata_.shm_fd, total_shm_size) == -1)
+    size_t headers_sz = 0;
+    if constexpr (!inline_header_)
     {
-        // `ftruncate` on an already open file descriptor can fail with EINVAL
-        // https://stackoverflow.com/questions/20320742/ftruncate-failed-at-the-second-time
-        if (errno != EINVAL)
-        {
-            spdlog::error("ftruncate failed with errno: {}", errno);
-            spdlog::error("fd: {}, total_shm_size: {}", shm_metadata_.shm_fd, total_shm_size);
-            perror("ftruncate");
-            throw std::runtime_error("ftruncate failed");
-        }
-    }
-
-    char *shm_ptr = static_cast<char *>(mmap(NULL, total_shm_size,
-                                             PROT_READ | PROT_WRITE, MAP_SHARED, shm_metadata_.shm_fd, 0));
-    if (shm_ptr == MAP_FAILED)
-    {
-        perror("mmap");
-        throw std::runtime_error("Failed to map shared memory");
+        // The header array follows the ring buffer, starting on its own cache line
+        total_shm_size = control_block_sz + size_rounded_up_to_cache_line(shm_metadata_.user_shm_size);
+        const size_t capacity = shm_metadata_.user_shm_size / message_block_sz_;
+        headers_sz = size_rounded_up_to_cache_line(capacity * sizeof(MessageHeader));
     }
-    shm_metadata_.shm_ptr = shm_ptr;
+    shm_metadata_.map(total_shm_size + headers_sz, map_options_);
     // The queue shared memory starts after the control block
-    shm_metadata_.user_shm_start = shm_ptr + control_block_sz;
-    shm_metadata_.total_shm_size = total_shm_size;
-
-    if (shm_status == SHM_CREATED)
+    shm_metadata_.user_shm_start = shm_metadata_.shm_ptr + control_block_sz;
+    if constexpr (!inline_header_)
     {
-        spdlog::debug("Resetting all occupied flags in the message headers");
-        // Initialize all message headers to unoccupied on first creating the shm segment
-        for (size_t i = 0; i < shm_metadata_.user_shm_size; i += message_block_sz_)
-        {
-            MessageHeader *header = reinterpret_cast<MessageHeader *>(shm_metadata_.user_shm_start + i);
-            header->occupied = false;
-        }
+        shm_metadata_.headers = reinterpret_cast<MessageHeader *>(shm_metadata_.shm_ptr + total_shm_size);
     }
+
+    // A newly created segment is zero filled, which already marks every message header as unoccupied.
+    // The ring is not walked here, so creation is constant time and does not fault in the ring's pages.
     spdlog::debug("Finished init_shm");
     return 0;
 }
 
-template <typename T>
-KoiQueueRet KoiQueue<T>::send(T message)
+template <typename T, size_t Capacity, SlotLayout Layout>
+KoiQueueRet KoiQueue<T, Capacity, Layout>::send(T message)
 {
-    // 3 cache misses
-    const size_t write_offset = control_block_->write.offset.load(std::memory_order_relaxed); // 1
-    char *start = shm_metadata_.user_shm_start + write_offset;                                // 2
-    MessageHeader *header = reinterpret_cast<MessageHeader *>(start);
-    if (header->occupied.load(std::memory_order_acquire)) // 3
+    T *slot = reserve();
+    if (slot == nullptr)
     {
         return KoiQueueRet::QUEUE_FULL;
     }
 
     // Copy the message into the shared memory
-    char *header_end = start + sizeof(MessageHeader);
     char *message_ptr = reinterpret_cast<char *>(&message);
-    std::copy(message_ptr, message_ptr + shm_metadata_.message_sz, header_end);
+    std::copy(message_ptr, message_ptr + shm_metadata_.message_sz, reinterpret_cast<char *>(slot));
+    commit();
+    return KoiQueueRet::OK;
+}
 
-    // Every message is rounded up to the nearest cache line (`message_block_sz_`)
-    // Wrap around the ring buffer
-    // The following three control block fields are all on the same cacheline
-    size_t next_write_offset = write_offset + control_block_->write.message_block_sz;
-    if (next_write_offset >= control_block_->write.user_shm_size) [[unlikely]]
+template <typename T, size_t Capacity, SlotLayout Layout>
+T *KoiQueue<T, Capacity, Layout>::reserve()
+{
+    // At most 1 cache miss. The offset and ring geometry are process local, only the message header is shared,
+    // and it is only checked once the slots known to be free run out
+    if (free_slots_ == 0)
+    {
+        free_slots_ = probe_free_slots();
+        if (free_slots_ == 0)
+        {
+            return nullptr;
+        }
+    }
+    return reinterpret_cast<T *>(message_at(write_offset_));
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::probe_free_slots() const
+{
+    // The receiver clears `occupied` flags in ring order, so if the slot `send_lookahead_ - 1` ahead is free
+    // then every slot up to it is free as well. `memory_order_acquire` synchronizes with the release of that
+    // slot, which happens after the release of all the slots before it.
+    if (send_lookahead_ > 1)
     {
-        next_write_offset -= control_block_->write.user_shm_size;
+        MessageHeader *probe = header_at(offset_after(write_offset_, send_lookahead_ - 1));
+        if (!probe->occupied.load(std::memory_order_acquire))
+        {
+            return send_lookahead_;
+        }
     }
+    // Fall back to checking the next slot only
+    MessageHeader *header = header_at(write_offset_);
+    return header->occupied.load(std::memory_order_acquire) ? 0 : 1;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+void KoiQueue<T, Capacity, Layout>::commit()
+{
+    MessageHeader *header = header_at(write_offset_);
+    free_slots_--;
+
+    // Every message is rounded up to the nearest cache line (`message_block_sz_`)
+    // Wrap around the ring buffer
+    write_offset_ = offset_after(write_offset_, 1);
+    // Write back for introspection. Only the sender writes this line, so the store does not miss
+    // unless another process has read the offset since.
     // `memory_order_relaxed` because synchronization occurs via the `occupied` flag
-    control_block_->write.offset.store(next_write_offset, std::memory_order_relaxed);
+    control_block_->write.offset.store(write_offset_, std::memory_order_relaxed);
     header->occupied.store(true, std::memory_order_release);
+    if (wait_strategy_ == WaitStrategy::FUTEX)
+    {
+        notify_waiters(control_block_->data_ready);
+    }
+    notify_receiver();
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+template <typename... Args>
+KoiQueueRet KoiQueue<T, Capacity, Layout>::emplace(Args &&...args)
+{
+    T *slot = reserve();
+    if (slot == nullptr)
+    {
+        return KoiQueueRet::QUEUE_FULL;
+    }
+    new (slot) T(std::forward<Args>(args)...);
+    commit();
     return KoiQueueRet::OK;
 }
 
-template <typename T>
-std::optional<T> KoiQueue<T>::recv()
+template <typename T, size_t Capacity, SlotLayout Layout>
+KoiQueueRet KoiQueue<T, Capacity, Layout>::send_wait(T message, std::chrono::nanoseconds timeout)
+{
+    const bool sent = wait_for([&]()
+                               { return send(message) == KoiQueueRet::OK; },
+                               wait_strategy_, control_block_->space_ready, timeout);
+    return sent ? KoiQueueRet::OK : KoiQueueRet::QUEUE_FULL;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+std::optional<T> KoiQueue<T, Capacity, Layout>::recv_wait(std::chrono::nanoseconds timeout)
 {
-    // 3 cache misses
-    const size_t read_offset = control_block_->read.offset.load(std::memory_order_relaxed); // 1
-    char *start = shm_metadata_.user_shm_start + read_offset;                               // 2
-    MessageHeader *header = reinterpret_cast<MessageHeader *>(start);
-    if (!header->occupied.load(std::memory_order_acquire)) // 3
+    T message;
+    if (!wait_for([&]()
+                  { return recv_into(message); },
+                  wait_strategy_, control_block_->data_ready, timeout))
     {
         return std::nullopt;
     }
+    return message;
+}
 
-    char *header_end = start + sizeof(MessageHeader);
+template <typename T, size_t Capacity, SlotLayout Layout>
+std::optional<T> KoiQueue<T, Capacity, Layout>::recv()
+{
     T message;
-    std::copy(header_end, header_end + shm_metadata_.message_sz, reinterpret_cast<char *>(&message));
+    if (!recv_into(message))
+    {
+        return std::nullopt;
+    }
+    return message;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+bool KoiQueue<T, Capacity, Layout>::recv_into(T &message)
+{
+    const T *slot = peek();
+    if (slot == nullptr)
+    {
+        return false;
+    }
+    const char *message_ptr = reinterpret_cast<const char *>(slot);
+    std::copy(message_ptr, message_ptr + shm_metadata_.message_sz, reinterpret_cast<char *>(&message));
+    release();
+    return true;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+const T *KoiQueue<T, Capacity, Layout>::peek()
+{
+    // 1 cache miss. The offset and ring geometry are process local, only the message header is shared
+    MessageHeader *header = header_at(read_offset_);
+    if (!header->occupied.load(std::memory_order_acquire)) // 1
+    {
+        // The queue is empty, so the sender may be waiting on the deferred releases
+        if (pending_releases_ > 0)
+        {
+            flush_releases();
+        }
+        return nullptr;
+    }
+    return reinterpret_cast<const T *>(message_at(read_offset_));
+}
 
+template <typename T, size_t Capacity, SlotLayout Layout>
+void KoiQueue<T, Capacity, Layout>::release()
+{
     // Every message is rounded up to the nearest cache line (`message_block_sz_`)
     // Wrap around the ring buffer
-    // The following three control block fields are all on the same cacheline
-    size_t next_read_offset = read_offset + control_block_->read.message_block_sz;
-    if (next_read_offset >= control_block_->read.user_shm_size) [[unlikely]]
+    consume_slots(1, offset_after(read_offset_, 1));
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+void KoiQueue<T, Capacity, Layout>::notify_receiver()
+{
+    // One relaxed load of a line the receiver rarely writes, unless a receiver is using `notify_fd`
+    if (control_block_->notify.enabled.load(std::memory_order_relaxed) != 0) [[unlikely]]
+    {
+        signal_if_armed(control_block_->notify, notify_fifo_);
+    }
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+int KoiQueue<T, Capacity, Layout>::notify_fd()
+{
+    const int fd = notify_fifo_.open_reader();
+    control_block_->notify.enabled.store(1, std::memory_order_seq_cst);
+    return fd;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+bool KoiQueue<T, Capacity, Layout>::arm_notify()
+{
+    if (notify_fifo_.read_fd == -1)
+    {
+        throw std::logic_error("arm_notify called before notify_fd");
+    }
+    notify_fifo_.drain();
+    // `memory_order_seq_cst` orders the arming before the recheck of the queue, see `signal_if_armed`
+    control_block_->notify.armed.store(1, std::memory_order_seq_cst);
+    MessageHeader *header = header_at(read_offset_);
+    if (header->occupied.load(std::memory_order_acquire))
+    {
+        // A message arrived before the arming was visible. If the sender already took the arming, the
+        // descriptor is readable and is cleared on the next `arm_notify`
+        control_block_->notify.armed.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+MessageHeader *KoiQueue<T, Capacity, Layout>::header_at(size_t offset) const
+{
+    if constexpr (inline_header_)
     {
-        next_read_offset -= control_block_->read.user_shm_size;
+        return reinterpret_cast<MessageHeader *>(shm_metadata_.user_shm_start + offset);
     }
+    // `message_block_sz_` is a compile time constant, so the division is a multiply and shift
+    return shm_metadata_.headers + offset / message_block_sz_;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+char *KoiQueue<T, Capacity, Layout>::message_at(size_t offset) const
+{
+    return shm_metadata_.user_shm_start + offset + message_offset_;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::offset_after(size_t offset, size_t n) const
+{
+    // `n` is at most the capacity, so at most one wrap around is needed
+    size_t next_offset = offset + n * message_block_sz_;
+    if constexpr (pow_2_ring_)
+    {
+        // `static_user_shm_size_` is a power of 2, so the wrap around is a constant mask
+        return next_offset & (static_user_shm_size_ - 1);
+    }
+    if (next_offset >= ring_sz_bytes()) [[unlikely]]
+    {
+        next_offset -= ring_sz_bytes();
+    }
+    return next_offset;
+}
 
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::ring_sz_bytes() const
+{
+    if constexpr (Capacity != DYNAMIC_CAPACITY)
+    {
+        return static_user_shm_size_;
+    }
+    return shm_metadata_.user_shm_size;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+void KoiQueue<T, Capacity, Layout>::consume_slots(size_t num_slots, size_t next_read_offset)
+{
+    read_offset_ = next_read_offset;
+    // Write back for introspection, see `commit`. The offset counts consumed slots, including those
+    // whose release is deferred.
     // `memory_order_relaxed` because synchronization occurs via the `occupied` flag
     control_block_->read.offset.store(next_read_offset, std::memory_order_relaxed);
-    header->occupied.store(false, std::memory_order_release);
-    return message;
+    pending_releases_ += num_slots;
+    if (pending_releases_ >= release_batch_)
+    {
+        flush_releases();
+    }
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+void KoiQueue<T, Capacity, Layout>::flush_releases()
+{
+    // The pending slots are the `pending_releases_` slots before `read_offset_`.
+    // `pending_releases_` is less than the number of blocks in the ring buffer, so this does not wrap past `read_offset_`
+    const size_t release_offset = offset_after(read_offset_, ring_sz_bytes() / message_block_sz_ - pending_releases_);
+    // Release the slots in ring order, which the sender relies on when counting free slots
+    for (size_t i = 0; i < pending_releases_; i++)
+    {
+        // `memory_order_release` so the reads of the message complete before the sender can overwrite the slot
+        header_at(offset_after(release_offset, i))->occupied.store(false, std::memory_order_release);
+    }
+    pending_releases_ = 0;
+    if (wait_strategy_ == WaitStrategy::FUTEX)
+    {
+        notify_waiters(control_block_->space_ready);
+    }
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::send_batch(std::span<const T> messages)
+{
+    const size_t write_offset = write_offset_;
+    const size_t max_messages = std::min(messages.size(), ring_sz_bytes() / message_block_sz_);
+
+    // Count the free slots ahead of the writer. The receiver clears `occupied` flags in ring order,
+    // so the run of free slots ends at the first occupied header.
+    size_t num_free = 0;
+    for (size_t offset = write_offset; num_free < max_messages; offset = offset_after(offset, 1))
+    {
+        if (header_at(offset)->occupied.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        num_free++;
+    }
+    if (num_free == 0)
+    {
+        return 0;
+    }
+
+    // Copy the whole run into the shared memory before publishing any of it
+    size_t offset = write_offset;
+    for (size_t i = 0; i < num_free; i++)
+    {
+        const char *message_ptr = reinterpret_cast<const char *>(&messages[i]);
+        std::copy(message_ptr, message_ptr + shm_metadata_.message_sz, message_at(offset));
+        offset = offset_after(offset, 1);
+    }
+    // `offset` is now one past the end of the run
+    write_offset_ = offset;
+    free_slots_ = free_slots_ > num_free ? free_slots_ - num_free : 0;
+    control_block_->write.offset.store(offset, std::memory_order_relaxed);
+
+    // Set the `occupied` flags last to first. The receiver starts at the first header of the run, so once it
+    // observes that header as occupied every other message in the batch is already visible.
+    for (size_t i = num_free; i-- > 0;)
+    {
+        header_at(offset_after(write_offset, i))->occupied.store(true, std::memory_order_release);
+    }
+    if (wait_strategy_ == WaitStrategy::FUTEX)
+    {
+        notify_waiters(control_block_->data_ready);
+    }
+    notify_receiver();
+    return num_free;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::recv_batch(std::span<T> messages)
+{
+    const size_t read_offset = read_offset_;
+    // Slots with deferred releases are still occupied, so stop before wrapping around onto them
+    const size_t max_messages = std::min(messages.size(), ring_sz_bytes() / message_block_sz_ - pending_releases_);
+
+    // Copy out the run of occupied slots ahead of the reader. The sender fills slots in ring order,
+    // so the run ends at the first unoccupied header.
+    size_t num_received = 0;
+    size_t offset = read_offset;
+    while (num_received < max_messages)
+    {
+        if (!header_at(offset)->occupied.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        const char *message_ptr = message_at(offset);
+        std::copy(message_ptr, message_ptr + shm_metadata_.message_sz, reinterpret_cast<char *>(&messages[num_received]));
+        num_received++;
+        offset = offset_after(offset, 1);
+    }
+    if (num_received > 0)
+    {
+        consume_slots(num_received, offset);
+    }
+    // Batches are always handed back to the sender, along with any deferred releases
+    if (pending_releases_ > 0)
+    {
+        flush_releases();
+    }
+    return num_received;
+}
+
+template <typename T, size_t Capacity, SlotLayout Layout>
+template <typename F>
+size_t KoiQueue<T, Capacity, Layout>::drain(F &&fn, size_t max_messages)
+{
+    const size_t read_offset = read_offset_;
+    // Slots with deferred releases are still occupied, so stop before wrapping around onto them
+    max_messages = std::min(max_messages, ring_sz_bytes() / message_block_sz_ - pending_releases_);
+
+    size_t num_handled = 0;
+    size_t offset = read_offset;
+    while (num_handled < max_messages)
+    {
+        if (!header_at(offset)->occupied.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        // The message is handed to `fn` in place, the slot is not released until after `fn` returns
+        fn(*reinterpret_cast<const T *>(message_at(offset)));
+        num_handled++;
+        offset = offset_after(offset, 1);
+    }
+    if (num_handled > 0)
+    {
+        consume_slots(num_handled, offset);
+    }
+    // Batches are always handed back to the sender, along with any deferred releases
+    if (pending_releases_ > 0)
+    {
+        flush_releases();
+    }
+    return num_handled;
 }
 
-template <typename T>
-size_t KoiQueue<T>::user_shm_size() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::user_shm_size() const
 {
     return shm_metadata_.user_shm_size;
 }
 
-template <typename T>
-size_t KoiQueue<T>::curr_queue_sz_bytes() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::curr_queue_sz_bytes() const
 {
-    size_t curr_queue_sz = (control_block_->write.offset -
-                            control_block_->read.offset + control_block_->write.user_shm_size) &
-                           (control_block_->read.user_shm_size - 1);
+    // The offsets are read from the control block since each process only has a local copy of its own side
+    const size_t write_offset = control_block_->write.offset;
+    const size_t read_offset = control_block_->read.offset;
+    size_t curr_queue_sz = write_offset >= read_offset ? write_offset - read_offset
+                                                        : write_offset + shm_metadata_.user_shm_size - read_offset;
     if (curr_queue_sz == 0 && is_full())
     {
         // Special case where the queue is full and the read and write offsets are the same
-        return control_block_->write.user_shm_size;
+        return shm_metadata_.user_shm_size;
     }
     return curr_queue_sz;
 }
 
-template <typename T>
-size_t KoiQueue<T>::shm_remaining_bytes() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::shm_remaining_bytes() const
 {
-    // spdlog::debug("user_shm_size: {}, curr_queue_sz_bytes: {}", control_block_->write.user_shm_size, curr_queue_sz_bytes());
-    return control_block_->write.user_shm_size - curr_queue_sz_bytes();
+    // spdlog::debug("user_shm_size: {}, curr_queue_sz_bytes: {}", shm_metadata_.user_shm_size, curr_queue_sz_bytes());
+    return shm_metadata_.user_shm_size - curr_queue_sz_bytes();
 }
 
-template <typename T>
-constexpr size_t KoiQueue<T>::message_block_sz_bytes() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+constexpr size_t KoiQueue<T, Capacity, Layout>::message_block_sz_bytes()
 {
     return message_block_sz_;
 }
 
-template <typename T>
-bool KoiQueue<T>::is_full() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+bool KoiQueue<T, Capacity, Layout>::is_full() const
 {
-    char *start = shm_metadata_.user_shm_start + control_block_->write.offset;
-    MessageHeader *header = reinterpret_cast<MessageHeader *>(start);
+    MessageHeader *header = header_at(control_block_->write.offset);
     return header->occupied;
 }
 
-template <typename T>
-bool KoiQueue<T>::is_empty() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+bool KoiQueue<T, Capacity, Layout>::is_empty() const
 {
-    char *start = shm_metadata_.user_shm_start + control_block_->read.offset;
-    MessageHeader *header = reinterpret_cast<MessageHeader *>(start);
+    MessageHeader *header = header_at(control_block_->read.offset);
     return !header->occupied;
 }
 
-template <typename T>
-size_t KoiQueue<T>::size() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::size() const
 {
     return curr_queue_sz_bytes() / message_block_sz_;
 }
 
-template <typename T>
-size_t KoiQueue<T>::capacity() const
+template <typename T, size_t Capacity, SlotLayout Layout>
+size_t KoiQueue<T, Capacity, Layout>::capacity() const
 {
-    spdlog::debug("user_shm_size: {}, message_block_sz_: {}", control_block_->write.user_shm_size, message_block_sz_);
-    return control_block_->write.user_shm_size / message_block_sz_;
+    spdlog::debug("user_shm_size: {}, message_block_sz_: {}", shm_metadata_.user_shm_size, message_block_sz_);
+    return ring_sz_bytes() / message_block_sz_;
 }
\ No newline at end of file
@@ -5,15 +5,39 @@
 namespace koi
 {
     // An IPC receiver
-    template <typename T>
-    class KoiReceiver : public KoiQueue<T>
+    // `Capacity` is the number of messages, see `KoiQueue`. With the default `DYNAMIC_CAPACITY` the ring buffer
+    // size is passed to the constructor
+    // `Layout` selects where each slot's header is stored, see `SlotLayout`. Both sides must use the same layout
+    template <typename T, size_t Capacity = DYNAMIC_CAPACITY, SlotLayout Layout = SlotLayout::INLINE_HEADER>
+    class KoiReceiver : public KoiQueue<T, Capacity, Layout>
     {
     public:
-        KoiReceiver(const std::string name, size_t buffer_bytes) : KoiQueue<T>(name, buffer_bytes)
+        KoiReceiver(const std::string name, size_t buffer_bytes, KoiQueueOptions options = {})
+            : KoiQueue<T, Capacity, Layout>(name, buffer_bytes, options)
         {
         }
 
-        using KoiQueue<T>::recv;
-        using KoiQueue<T>::size;
+        KoiReceiver(const std::string name, QueueCapacity capacity, KoiQueueOptions options = {})
+            : KoiQueue<T, Capacity, Layout>(name, capacity, options)
+        {
+        }
+
+        explicit KoiReceiver(const std::string name, KoiQueueOptions options = {})
+            requires(Capacity != DYNAMIC_CAPACITY)
+            : KoiQueue<T, Capacity, Layout>(name, options)
+        {
+        }
+
+        using KoiQueue<T, Capacity, Layout>::recv;
+        using KoiQueue<T, Capacity, Layout>::recv_wait;
+        using KoiQueue<T, Capacity, Layout>::recv_into;
+        using KoiQueue<T, Capacity, Layout>::peek;
+        using KoiQueue<T, Capacity, Layout>::release;
+        using KoiQueue<T, Capacity, Layout>::flush_releases;
+        using KoiQueue<T, Capacity, Layout>::notify_fd;
+        using KoiQueue<T, Capacity, Layout>::arm_notify;
+        using KoiQueue<T, Capacity, Layout>::recv_batch;
+        using KoiQueue<T, Capacity, Layout>::drain;
+        using KoiQueue<T, Capacity, Layout>::size;
     };
 } // namespace koi
\ No newline at end of file
@@ -5,18 +5,38 @@
 namespace koi
 {
     // An IPC sender
-    template <typename T>
-    class KoiSender : public KoiQueue<T>
+    // `Capacity` is the number of messages, see `KoiQueue`. With the default `DYNAMIC_CAPACITY` the ring buffer
+    // size is passed to the constructor
+    // `Layout` selects where each slot's header is stored, see `SlotLayout`. Both sides must use the same layout
+    template <typename T, size_t Capacity = DYNAMIC_CAPACITY, SlotLayout Layout = SlotLayout::INLINE_HEADER>
+    class KoiSender : public KoiQueue<T, Capacity, Layout>
     {
     public:
-        KoiSender(const std::string name, size_t buffer_bytes) : KoiQueue<T>(name, buffer_bytes)
+        KoiSender(const std::string name, size_t buffer_bytes, KoiQueueOptions options = {})
+            : KoiQueue<T, Capacity, Layout>(name, buffer_bytes, options)
         {
         }
 
-        using KoiQueue<T>::send;
+        KoiSender(const std::string name, QueueCapacity capacity, KoiQueueOptions options = {})
+            : KoiQueue<T, Capacity, Layout>(name, capacity, options)
+        {
+        }
+
+        explicit KoiSender(const std::string name, KoiQueueOptions options = {})
+            requires(Capacity != DYNAMIC_CAPACITY)
+            : KoiQueue<T, Capacity, Layout>(name, options)
+        {
+        }
+
+        using KoiQueue<T, Capacity, Layout>::send;
+        using KoiQueue<T, Capacity, Layout>::send_wait;
+        using KoiQueue<T, Capacity, Layout>::reserve;
+        using KoiQueue<T, Capacity, Layout>::commit;
+        using KoiQueue<T, Capacity, Layout>::emplace;
+        using KoiQueue<T, Capacity, Layout>::send_batch;
         // Currently only the sender is allowed to clean up the shared memory segment
         // since there is only one sender
-        using KoiQueue<T>::cleanup_shm;
-        using KoiQueue<T>::size;
+        using KoiQueue<T, Capacity, Layout>::cleanup_shm;
+        using KoiQueue<T, Capacity, Layout>::size;
     };
 } // namespace koi
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// The geometry shared by every lane, on one cacheline at the start of the segment
+struct LaneControlBlockHeader
+{
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+    size_t num_lanes;
+    // Number of messages each lane holds
+    size_t lane_capacity;
+    size_t message_block_sz;
+};
+
+// Shared information among all processes encoded in the shared memory. Followed by the `LanePositions` of each lane
+struct LaneControlBlock
+{
+    alignas(CACHE_LINE_BYTES) LaneControlBlockHeader header;
+};
+
+// Positions of one lane's ring. Positions only increase, the slot is the position modulo the lane capacity
+struct LanePositions
+{
+    // The below are aligned to the nearest cache line to avoid false sharing
+    // "tail"
+    alignas(CACHE_LINE_BYTES) std::atomic<uint64_t> write;
+    // "head"
+    alignas(CACHE_LINE_BYTES) std::atomic<uint64_t> read;
+};
+
+// How the receiver picks the lane of the next message
+enum class LaneSchedule : uint32_t
+{
+    // Always the lowest numbered non empty lane, so lane 0 is never delayed by messages in the other lanes.
+    // A saturated high priority lane starves the lanes after it
+    STRICT_PRIORITY,
+    // Round robin over the lanes, taking up to `KoiLaneQueueOptions::weights[lane]` messages from a lane before
+    // moving on. An empty lane forfeits the rest of its turn, so no lane is starved
+    WEIGHTED,
+};
+
+// Process local options of the receiver
+struct KoiLaneQueueOptions
+{
+    LaneSchedule schedule = LaneSchedule::STRICT_PRIORITY;
+    // `LaneSchedule::WEIGHTED`: messages taken from each lane per turn, one positive weight per lane
+    std::vector<size_t> weights = {};
+};
+
+// Forward declaration of KoiLaneQueueRAII
+template <typename T>
+class KoiLaneQueueRAII;
+
+// A queue of `num_lanes` independent single producer single consumer rings in one shm segment, under one control
+// block. Lane 0 is the highest priority. A control message sent on its own lane is received before the backlog of
+// the other lanes, instead of behind it as in a single `KoiQueue`. Each lane has one sender, but different lanes
+// may be fed by different senders, and one receiver drains all lanes according to its `LaneSchedule`.
+// Messages within a lane are received in order, there is no ordering across lanes.
+//
+// Shared memory layout: control block, then the `LanePositions` of each lane, then the ring of each lane.
+template <typename T>
+class KoiLaneQueue
+{
+public:
+    size_t num_lanes() const;
+    // Returns the number of messages each lane holds
+    size_t lane_capacity() const;
+    // Returns the message block size in bytes
+    static constexpr size_t message_block_sz_bytes();
+    // Returns the number of messages in `lane`. Only a snapshot, the sender and receiver may move concurrently
+    size_t size(size_t lane) const;
+    // Returns the number of messages across all lanes
+    size_t size() const;
+    bool is_empty() const;
+
+protected:
+    // `num_lanes` and `lane_capacity` must be at least 1. `options` only applies to the receiver.
+    // Throws `std::invalid_argument` if `LaneSchedule::WEIGHTED` is not given one positive weight per lane
+    explicit KoiLaneQueue(const std::string name, size_t num_lanes, size_t lane_capacity, KoiLaneQueueOptions options = {});
+    virtual ~KoiLaneQueue();
+
+    // Returns `KoiQueueRet::QUEUE_FULL` if `lane` is full, otherwise `KoiQueueRet::OK`.
+    // Throws `std::out_of_range` if `lane` is not less than `num_lanes()`
+    KoiQueueRet send(size_t lane, T message);
+    // Returns the next message according to the schedule, or `std::nullopt` if every lane is empty
+    std::optional<T> recv();
+    // Returns the next message of `lane` only, or `std::nullopt` if it is empty
+    std::optional<T> recv(size_t lane);
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    static constexpr size_t message_block_sz_ = size_rounded_up_to_cache_line(sizeof(T));
+    static constexpr size_t message_sz = sizeof(T);
+
+    LaneControlBlock *control_block_;
+
+    struct ShmMetadata : ShmSegment
+    {
+        // `shm_ptr` + sizeof(LaneControlBlock) (aligned to the nearest cache line)
+        LanePositions *lane_positions;
+        // Start of the ring of lane 0, the rings are back to back
+        char *rings_start;
+        size_t num_lanes;
+        size_t lane_capacity;
+        // Slots wrap around each lane with a mask, see `slot_after`
+        bool pow_2_lanes;
+    };
+
+    ShmMetadata shm_metadata_;
+    KoiLaneQueueOptions options_;
+
+    // Process local copies of each lane's positions, see `KoiQueue::write_offset_`. The sender reloads the read
+    // position only when the lane looks full, and the receiver reloads the write position only when it looks empty
+    std::vector<uint64_t> write_positions_;
+    std::vector<uint64_t> cached_read_positions_;
+    std::vector<uint64_t> read_positions_;
+    std::vector<uint64_t> cached_write_positions_;
+    // Slots of `write_positions_` and `read_positions_` within their lane, so the hot path does not divide
+    std::vector<size_t> write_slots_;
+    std::vector<size_t> read_slots_;
+
+    // Receiver: `LaneSchedule::WEIGHTED` lane whose turn it is, and the messages it may still take this turn
+    size_t current_lane_ = 0;
+    size_t lane_credit_ = 0;
+
+    char *message_at(size_t lane, size_t slot) const;
+    // Returns the slot after `slot`, wrapping around the lane's ring
+    size_t slot_after(size_t slot) const;
+    // Copies the next message of `lane` into `message`. Returns `false` if the lane is empty
+    bool recv_from(size_t lane, T &message);
+
+    // Allow `KoiLaneQueueRAII` to access private and protected members, particularly `cleanup_shm`
+    friend class KoiLaneQueueRAII<T>;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiLaneQueueRAII : public KoiLaneQueue<T>
+{
+public:
+    explicit KoiLaneQueueRAII(const std::string name, size_t num_lanes, size_t lane_capacity, KoiLaneQueueOptions options = {})
+        : KoiLaneQueue<T>(name, num_lanes, lane_capacity, options)
+    {
+    }
+
+    ~KoiLaneQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiLaneQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiLaneQueue<T>::send;
+    using KoiLaneQueue<T>::recv;
+
+private:
+    using KoiLaneQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_lane_queue.tcc"
@@ -0,0 +1,289 @@
+#include "koi_lane_queue.hh"
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// If the shm segment at `shm_name` has already been created, then `num_lanes`, `lane_capacity` and the message
+// block size must match the existing shared memory.
+template <typename T>
+KoiLaneQueue<T>::KoiLaneQueue(const std::string shm_name, size_t num_lanes, size_t lane_capacity, KoiLaneQueueOptions options)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    // `send`/`recv` will do a bitwise memcpy of T into the shared memory
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+
+    spdlog::info("Constructing KoiLaneQueue with shm_name: {}, num_lanes: {}, lane_capacity: {}", shm_name, num_lanes, lane_capacity);
+    spdlog::info("KoiLaneQueue running with message_sz: {}, message_block_sz: {} bytes", message_sz, message_block_sz_);
+    shm_metadata_.shm_name = std::move(shm_name);
+
+    if (num_lanes == 0 || lane_capacity == 0)
+    {
+        throw std::invalid_argument("num_lanes " + std::to_string(num_lanes) + " and lane_capacity " +
+                                    std::to_string(lane_capacity) + " must be at least 1");
+    }
+    if (options.schedule == LaneSchedule::WEIGHTED &&
+        (options.weights.size() != num_lanes || std::find(options.weights.begin(), options.weights.end(), 0) != options.weights.end()))
+    {
+        throw std::invalid_argument("LaneSchedule::WEIGHTED requires one positive weight for each of the " +
+                                    std::to_string(num_lanes) + " lanes");
+    }
+    shm_metadata_.num_lanes = num_lanes;
+    shm_metadata_.lane_capacity = lane_capacity;
+    shm_metadata_.pow_2_lanes = (lane_capacity & (lane_capacity - 1)) == 0;
+    options_ = std::move(options);
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = shm_metadata_.open();
+        // The lane positions and the rings follow the control block
+        const size_t control_block_sz = size_rounded_to_cache_line<LaneControlBlock>();
+        const size_t positions_sz = num_lanes * sizeof(LanePositions);
+        shm_metadata_.map(control_block_sz + positions_sz + num_lanes * lane_capacity * message_block_sz_);
+        shm_metadata_.lane_positions = reinterpret_cast<LanePositions *>(shm_metadata_.shm_ptr + control_block_sz);
+        shm_metadata_.rings_start = shm_metadata_.shm_ptr + control_block_sz + positions_sz;
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    control_block_ = reinterpret_cast<LaneControlBlock *>(shm_metadata_.shm_ptr);
+    write_positions_.assign(num_lanes, 0);
+    cached_read_positions_.assign(num_lanes, 0);
+    read_positions_.assign(num_lanes, 0);
+    cached_write_positions_.assign(num_lanes, 0);
+    write_slots_.assign(num_lanes, 0);
+    read_slots_.assign(num_lanes, 0);
+    if (options_.schedule == LaneSchedule::WEIGHTED)
+    {
+        lane_credit_ = options_.weights[0];
+    }
+    if (open_ret == SHM_EXISTS)
+    {
+        LaneControlBlockHeader &header = control_block_->header;
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (header.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, header.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // Sanity check that the lanes are the same as the existing shared memory
+        if (header.num_lanes != num_lanes || header.lane_capacity != lane_capacity)
+        {
+            spdlog::error("num_lanes provided: {}, lane_capacity provided: {}, existing num_lanes: {}, lane_capacity: {}",
+                          num_lanes, lane_capacity, header.num_lanes, header.lane_capacity);
+            throw std::runtime_error("num_lanes or lane_capacity provided does not match existing shared memory");
+        }
+        // Sanity check that the message block size is the same as the existing shared memory
+        if (header.message_block_sz != message_block_sz_)
+        {
+            spdlog::error("message_block_sz_ provided: {}, existing message_block_sz: {}", message_block_sz_, header.message_block_sz);
+            throw std::runtime_error("message_block_sz_ provided does not match existing shared memory");
+        }
+        // Pick up where the previous senders and receiver left off
+        for (size_t lane = 0; lane < num_lanes; ++lane)
+        {
+            write_positions_[lane] = shm_metadata_.lane_positions[lane].write.load(std::memory_order_relaxed);
+            read_positions_[lane] = shm_metadata_.lane_positions[lane].read.load(std::memory_order_relaxed);
+            cached_read_positions_[lane] = read_positions_[lane];
+            cached_write_positions_[lane] = read_positions_[lane];
+            write_slots_[lane] = write_positions_[lane] % lane_capacity;
+            read_slots_[lane] = read_positions_[lane] % lane_capacity;
+        }
+        return;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so every lane starts empty at position 0.
+    control_block_->header.num_lanes = num_lanes;
+    control_block_->header.lane_capacity = lane_capacity;
+    control_block_->header.message_block_sz = message_block_sz_;
+    control_block_->header.cache_line_bytes = CACHE_LINE_BYTES;
+    spdlog::debug("Control block initialized with num_lanes: {}, lane_capacity: {}", num_lanes, lane_capacity);
+}
+
+template <typename T>
+KoiLaneQueue<T>::~KoiLaneQueue()
+{
+    spdlog::debug("Starting KoiLaneQueue destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`
+}
+
+template <typename T>
+void KoiLaneQueue<T>::cleanup_shm() noexcept
+{
+    shm_metadata_.cleanup();
+}
+
+template <typename T>
+size_t KoiLaneQueue<T>::num_lanes() const
+{
+    return shm_metadata_.num_lanes;
+}
+
+template <typename T>
+size_t KoiLaneQueue<T>::lane_capacity() const
+{
+    return shm_metadata_.lane_capacity;
+}
+
+template <typename T>
+constexpr size_t KoiLaneQueue<T>::message_block_sz_bytes()
+{
+    return message_block_sz_;
+}
+
+template <typename T>
+size_t KoiLaneQueue<T>::size(size_t lane) const
+{
+    const LanePositions &positions = shm_metadata_.lane_positions[lane];
+    const uint64_t read_position = positions.read.load(std::memory_order_acquire);
+    const uint64_t write_position = positions.write.load(std::memory_order_acquire);
+    return write_position > read_position ? static_cast<size_t>(write_position - read_position) : 0;
+}
+
+template <typename T>
+size_t KoiLaneQueue<T>::size() const
+{
+    size_t total = 0;
+    for (size_t lane = 0; lane < shm_metadata_.num_lanes; ++lane)
+    {
+        total += size(lane);
+    }
+    return total;
+}
+
+template <typename T>
+bool KoiLaneQueue<T>::is_empty() const
+{
+    return size() == 0;
+}
+
+template <typename T>
+KoiQueueRet KoiLaneQueue<T>::send(size_t lane, T message)
+{
+    if (lane >= shm_metadata_.num_lanes)
+    {
+        throw std::out_of_range("lane " + std::to_string(lane) + " is not less than num_lanes " + std::to_string(shm_metadata_.num_lanes));
+    }
+    const uint64_t write_position = write_positions_[lane];
+    LanePositions &positions = shm_metadata_.lane_positions[lane];
+    if (write_position - cached_read_positions_[lane] == shm_metadata_.lane_capacity)
+    {
+        cached_read_positions_[lane] = positions.read.load(std::memory_order_acquire);
+        if (write_position - cached_read_positions_[lane] == shm_metadata_.lane_capacity)
+        {
+            return KoiQueueRet::QUEUE_FULL;
+        }
+    }
+    char *message_ptr = reinterpret_cast<char *>(&message);
+    std::copy(message_ptr, message_ptr + message_sz, message_at(lane, write_slots_[lane]));
+    write_slots_[lane] = slot_after(write_slots_[lane]);
+    write_positions_[lane] = write_position + 1;
+    positions.write.store(write_position + 1, std::memory_order_release);
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+std::optional<T> KoiLaneQueue<T>::recv()
+{
+    T message;
+    const size_t num_lanes = shm_metadata_.num_lanes;
+    if (options_.schedule == LaneSchedule::STRICT_PRIORITY)
+    {
+        // Each empty lane before the first non empty one costs a load of its write position
+        for (size_t lane = 0; lane < num_lanes; ++lane)
+        {
+            if (recv_from(lane, message))
+            {
+                return message;
+            }
+        }
+        return std::nullopt;
+    }
+    // The current lane is tried again after all others, in case it was out of credit at the start
+    for (size_t tried = 0; tried <= num_lanes; ++tried)
+    {
+        if (lane_credit_ == 0)
+        {
+            current_lane_ = current_lane_ + 1 == num_lanes ? 0 : current_lane_ + 1;
+            lane_credit_ = options_.weights[current_lane_];
+        }
+        if (recv_from(current_lane_, message))
+        {
+            --lane_credit_;
+            return message;
+        }
+        lane_credit_ = 0;
+    }
+    return std::nullopt;
+}
+
+template <typename T>
+std::optional<T> KoiLaneQueue<T>::recv(size_t lane)
+{
+    if (lane >= shm_metadata_.num_lanes)
+    {
+        throw std::out_of_range("lane " + std::to_string(lane) + " is not less than num_lanes " + std::to_string(shm_metadata_.num_lanes));
+    }
+    T message;
+    if (recv_from(lane, message))
+    {
+        return message;
+    }
+    return std::nullopt;
+}
+
+template <typename T>
+bool KoiLaneQueue<T>::recv_from(size_t lane, T &message)
+{
+    const uint64_t read_position = read_positions_[lane];
+    LanePositions &positions = shm_metadata_.lane_positions[lane];
+    if (read_position == cached_write_positions_[lane])
+    {
+        cached_write_positions_[lane] = positions.write.load(std::memory_order_acquire);
+        if (read_position == cached_write_positions_[lane])
+        {
+            return false;
+        }
+    }
+    const char *message_ptr = message_at(lane, read_slots_[lane]);
+    std::copy(message_ptr, message_ptr + message_sz, reinterpret_cast<char *>(&message));
+    read_slots_[lane] = slot_after(read_slots_[lane]);
+    read_positions_[lane] = read_position + 1;
+    // Hands the slot back to the lane's sender
+    positions.read.store(read_position + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+char *KoiLaneQueue<T>::message_at(size_t lane, size_t slot) const
+{
+    return shm_metadata_.rings_start + (lane * shm_metadata_.lane_capacity + slot) * message_block_sz_;
+}
+
+template <typename T>
+size_t KoiLaneQueue<T>::slot_after(size_t slot) const
+{
+    // As in `KoiQueue::offset_after`, a mask for power of 2 lanes, otherwise a compare and subtract
+    if (shm_metadata_.pow_2_lanes)
+    {
+        return (slot + 1) & (shm_metadata_.lane_capacity - 1);
+    }
+    size_t next_slot = slot + 1;
+    if (next_slot >= shm_metadata_.lane_capacity)
+    {
+        next_slot -= shm_metadata_.lane_capacity;
+    }
+    return next_slot;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "koi_lane_queue.hh"
+
+namespace koi
+{
+    // An IPC receiver which drains the lanes of a `KoiLaneQueue` by priority, or by weight with `LaneSchedule::WEIGHTED`
+    template <typename T>
+    class KoiLaneReceiver : public KoiLaneQueue<T>
+    {
+    public:
+        KoiLaneReceiver(const std::string name, size_t num_lanes, size_t lane_capacity, KoiLaneQueueOptions options = {})
+            : KoiLaneQueue<T>(name, num_lanes, lane_capacity, options)
+        {
+        }
+
+        using KoiLaneQueue<T>::recv;
+    };
+} // namespace koi
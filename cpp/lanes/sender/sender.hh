@@ -0,0 +1,21 @@
+#pragma once
+
+#include "koi_lane_queue.hh"
+
+namespace koi
+{
+    // An IPC sender to one or more lanes of a `KoiLaneQueue`. Each lane must have only one sender
+    template <typename T>
+    class KoiLaneSender : public KoiLaneQueue<T>
+    {
+    public:
+        KoiLaneSender(const std::string name, size_t num_lanes, size_t lane_capacity)
+            : KoiLaneQueue<T>(name, num_lanes, lane_capacity)
+        {
+        }
+
+        using KoiLaneQueue<T>::send;
+        // The sender may clean up the shared memory segment once the receiver has finished
+        using KoiLaneQueue<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_slot.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Contains read/write metadata on one cacheline
+struct LossyControlBlockInner
+{
+    // Either the next position to be sent or to be received.
+    // Positions only increase, the slot is the position modulo the capacity
+    std::atomic<uint64_t> position;
+    // Duplicate the read only fields for the read/write cache line for prefetching.
+    // The values are identical between the read/write cache lines.
+    size_t user_shm_size;
+    size_t message_block_sz;
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+};
+
+// Shared information among all processes encoded in the shared memory
+struct LossyControlBlock
+{
+    // The below are aligned to the nearest cache line to avoid false sharing
+    // "tail"
+    alignas(CACHE_LINE_BYTES) LossyControlBlockInner write;
+    // "head"
+    alignas(CACHE_LINE_BYTES) LossyControlBlockInner read;
+};
+
+// Forward declaration of KoiLossyQueueRAII
+template <typename T>
+class KoiLossyQueueRAII;
+
+// A fixed size single producer single consumer queue which overwrites the oldest message when full, for feeds
+// where stale messages are worth less than a stalled sender. `send` never waits for the receiver. Each slot
+// carries the position of its message instead of an `occupied` flag, so a receiver which was lapped knows
+// exactly how many messages it lost, and resumes from the oldest message still in the ring.
+template <typename T>
+class KoiLossyQueue
+{
+public:
+    // Returns total size of the shm segment that the user allocated
+    size_t user_shm_size() const;
+    // Returns the number of messages which fit in the ring buffer
+    size_t capacity() const;
+    // Returns the size of each message plus its header, rounded up to the nearest cache line
+    static constexpr size_t message_block_sz_bytes();
+    // Returns the number of messages sent and not yet received, which may exceed `capacity()` if the receiver
+    // was lapped. Only a snapshot, the sender and receiver may move concurrently
+    size_t size() const;
+    bool is_empty() const;
+    // Receiver: returns the number of messages overwritten before this receiver could receive them
+    uint64_t lost_messages() const;
+
+protected:
+    // `buffer_bytes` is rounded down to a whole number of message blocks, and must hold at least one
+    explicit KoiLossyQueue(const std::string name, size_t buffer_bytes);
+    virtual ~KoiLossyQueue();
+
+    // Always returns `KoiQueueRet::OK`, overwriting the oldest message if the queue is full.
+    // The return value keeps `send` interchangeable with the other queues
+    KoiQueueRet send(T message);
+    // Returns the oldest message which was not overwritten, or `std::nullopt` if there is none
+    std::optional<T> recv();
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    // Offset of the message from the start of its block. The header is padded so messages are aligned for `T`
+    static constexpr size_t message_offset_ = (sizeof(SequencedSlotHeader) + alignof(T) - 1) & ~(alignof(T) - 1);
+    static constexpr size_t message_block_sz_ = size_rounded_up_to_cache_line(message_offset_ + sizeof(T));
+    static constexpr size_t message_sz = sizeof(T);
+
+    LossyControlBlock *control_block_;
+
+    struct ShmMetadata : ShmSegment
+    {
+        // `shm_ptr` + sizeof(LossyControlBlock) (aligned to the nearest cache line)
+        // Start of the ring buffer
+        char *user_shm_start;
+        size_t user_shm_size;
+        size_t capacity;
+    };
+
+    ShmMetadata shm_metadata_;
+
+    // Process local copies of the write and read positions, see `KoiQueue::write_offset_`
+    uint64_t write_position_ = 0;
+    uint64_t read_position_ = 0;
+    // Slots of `write_position_` and `read_position_` in the ring buffer, so the hot path does not divide
+    size_t write_slot_ = 0;
+    size_t read_slot_ = 0;
+    uint64_t lost_messages_ = 0;
+
+    // Receiver: moves `read_position_` past the messages the sender has overwritten or is overwriting
+    void skip_overwritten();
+
+    SequencedSlotHeader *header_at(size_t slot) const;
+    char *message_at(size_t slot) const;
+    // Returns the slot after `slot`, wrapping around the ring buffer
+    size_t slot_after(size_t slot) const;
+
+    // Allow `KoiLossyQueueRAII` to access private and protected members, particularly `cleanup_shm`
+    friend class KoiLossyQueueRAII<T>;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiLossyQueueRAII : public KoiLossyQueue<T>
+{
+public:
+    explicit KoiLossyQueueRAII(const std::string name, size_t buffer_bytes) : KoiLossyQueue<T>(name, buffer_bytes)
+    {
+    }
+
+    ~KoiLossyQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiLossyQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiLossyQueue<T>::send;
+    using KoiLossyQueue<T>::recv;
+
+private:
+    using KoiLossyQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_lossy_queue.tcc"
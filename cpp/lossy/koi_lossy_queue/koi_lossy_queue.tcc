@@ -0,0 +1,222 @@
+#include "koi_lossy_queue.hh"
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// If the shm segment at `shm_name` has already been created, then the provided `buffer_bytes` must round down to
+// the same ring size as the existing shared memory, and the message block size must match the existing one.
+template <typename T>
+KoiLossyQueue<T>::KoiLossyQueue(const std::string shm_name, size_t buffer_bytes)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    // `send`/`recv` will do a bitwise memcpy of T into the shared memory
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+
+    spdlog::info("Constructing KoiLossyQueue with shm_name: {}, buffer_bytes: {} bytes", shm_name, buffer_bytes);
+    spdlog::info("KoiLossyQueue running with message_sz: {}, message_block_sz: {} bytes", message_sz, message_block_sz_);
+    shm_metadata_.shm_name = std::move(shm_name);
+
+    // The ring buffer holds whole message blocks, any trailing bytes are unused
+    const size_t capacity = buffer_bytes / message_block_sz_;
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("buffer_bytes provided " + std::to_string(buffer_bytes) +
+                                    " is smaller than the message block size of " + std::to_string(message_block_sz_));
+    }
+    const size_t user_shm_size = capacity * message_block_sz_;
+    shm_metadata_.user_shm_size = user_shm_size;
+    shm_metadata_.capacity = capacity;
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = shm_metadata_.open();
+        // The shared memory is initialized with extra space bytes which holds the control block
+        size_t control_block_sz = size_rounded_to_cache_line<LossyControlBlock>();
+        shm_metadata_.map(control_block_sz + user_shm_size);
+        // The ring buffer starts after the control block
+        shm_metadata_.user_shm_start = shm_metadata_.shm_ptr + control_block_sz;
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    control_block_ = reinterpret_cast<LossyControlBlock *>(shm_metadata_.shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (control_block_->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block_->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // Sanity check that the user_shm_size is the same as the existing shared memory
+        if (control_block_->write.user_shm_size != user_shm_size)
+        {
+            spdlog::error("user_shm_size provided: {}, existing user_shm_size: {}", user_shm_size, control_block_->write.user_shm_size);
+            throw std::runtime_error("user_shm_size provided does not match existing shared memory");
+        }
+        // Sanity check that the message block size is the same as the existing shared memory
+        if (control_block_->write.message_block_sz != message_block_sz_)
+        {
+            spdlog::error("message_block_sz_ provided: {}, existing message_block_sz: {}",
+                          message_block_sz_, control_block_->write.message_block_sz);
+            throw std::runtime_error("message_block_sz_ provided does not match existing shared memory");
+        }
+        // Pick up where the previous sender and receiver left off
+        write_position_ = control_block_->write.position.load(std::memory_order_relaxed);
+        read_position_ = control_block_->read.position.load(std::memory_order_relaxed);
+        write_slot_ = write_position_ % capacity;
+        read_slot_ = read_position_ % capacity;
+        return;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so no slot holds a published message.
+    control_block_->write.user_shm_size = user_shm_size;
+    control_block_->write.message_block_sz = message_block_sz_;
+    control_block_->write.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->write.position = 0;
+    control_block_->read.user_shm_size = user_shm_size;
+    control_block_->read.message_block_sz = message_block_sz_;
+    control_block_->read.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->read.position = 0;
+    spdlog::debug("Control block initialized with user_shm_size: {}, message_block_sz: {}", user_shm_size, message_block_sz_);
+}
+
+template <typename T>
+KoiLossyQueue<T>::~KoiLossyQueue()
+{
+    spdlog::debug("Starting KoiLossyQueue destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`
+}
+
+template <typename T>
+void KoiLossyQueue<T>::cleanup_shm() noexcept
+{
+    shm_metadata_.cleanup();
+}
+
+template <typename T>
+size_t KoiLossyQueue<T>::user_shm_size() const
+{
+    return shm_metadata_.user_shm_size;
+}
+
+template <typename T>
+size_t KoiLossyQueue<T>::capacity() const
+{
+    return shm_metadata_.capacity;
+}
+
+template <typename T>
+constexpr size_t KoiLossyQueue<T>::message_block_sz_bytes()
+{
+    return message_block_sz_;
+}
+
+template <typename T>
+size_t KoiLossyQueue<T>::size() const
+{
+    const uint64_t read_position = control_block_->read.position.load(std::memory_order_acquire);
+    const uint64_t write_position = control_block_->write.position.load(std::memory_order_acquire);
+    return write_position > read_position ? static_cast<size_t>(write_position - read_position) : 0;
+}
+
+template <typename T>
+bool KoiLossyQueue<T>::is_empty() const
+{
+    return size() == 0;
+}
+
+template <typename T>
+uint64_t KoiLossyQueue<T>::lost_messages() const
+{
+    return lost_messages_;
+}
+
+template <typename T>
+KoiQueueRet KoiLossyQueue<T>::send(T message)
+{
+    // The sender never reads the receiver's state, so it is not slowed down by a lagging receiver
+    write_sequenced_slot(header_at(write_slot_), message_at(write_slot_), reinterpret_cast<char *>(&message),
+                         message_sz, write_position_);
+    write_slot_ = slot_after(write_slot_);
+    ++write_position_;
+    // Read by the receiver only once it finds it was lapped, see `skip_overwritten`
+    control_block_->write.position.store(write_position_, std::memory_order_release);
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+std::optional<T> KoiLossyQueue<T>::recv()
+{
+    while (true)
+    {
+        T message;
+        const SequencedRead read = read_sequenced_slot(header_at(read_slot_), message_at(read_slot_),
+                                                       reinterpret_cast<char *>(&message), message_sz, read_position_,
+                                                       control_block_->write.position, shm_metadata_.capacity);
+        if (read == SequencedRead::EMPTY)
+        {
+            return std::nullopt;
+        }
+        if (read == SequencedRead::LAPPED)
+        {
+            skip_overwritten();
+            continue;
+        }
+        read_slot_ = slot_after(read_slot_);
+        ++read_position_;
+        // Write back for `size()` and for a later receiver
+        control_block_->read.position.store(read_position_, std::memory_order_release);
+        return message;
+    }
+}
+
+template <typename T>
+void KoiLossyQueue<T>::skip_overwritten()
+{
+    const uint64_t write_position = control_block_->write.position.load(std::memory_order_acquire);
+    const uint64_t next = position_after_lap(read_position_, write_position, shm_metadata_.capacity);
+    lost_messages_ += next - read_position_;
+    spdlog::debug("KoiLossyQueue receiver lapped at position {}, skipping to {}", read_position_, next);
+    read_position_ = next;
+    // Only taken when lapped, so the divide is off the hot path
+    read_slot_ = read_position_ % shm_metadata_.capacity;
+    control_block_->read.position.store(read_position_, std::memory_order_release);
+}
+
+template <typename T>
+SequencedSlotHeader *KoiLossyQueue<T>::header_at(size_t slot) const
+{
+    return reinterpret_cast<SequencedSlotHeader *>(shm_metadata_.user_shm_start + slot * message_block_sz_);
+}
+
+template <typename T>
+char *KoiLossyQueue<T>::message_at(size_t slot) const
+{
+    return reinterpret_cast<char *>(header_at(slot)) + message_offset_;
+}
+
+template <typename T>
+size_t KoiLossyQueue<T>::slot_after(size_t slot) const
+{
+    // As in `KoiQueue::offset_after`, a compare and subtract instead of a modulo
+    size_t next_slot = slot + 1;
+    if (next_slot >= shm_metadata_.capacity)
+    {
+        next_slot -= shm_metadata_.capacity;
+    }
+    return next_slot;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "koi_lossy_queue.hh"
+
+namespace koi
+{
+    // An IPC receiver which skips the messages it was too slow to receive, counted by `lost_messages()`
+    template <typename T>
+    class KoiLossyReceiver : public KoiLossyQueue<T>
+    {
+    public:
+        KoiLossyReceiver(const std::string name, size_t buffer_bytes) : KoiLossyQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiLossyQueue<T>::recv;
+    };
+} // namespace koi
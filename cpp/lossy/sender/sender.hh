@@ -0,0 +1,20 @@
+#pragma once
+
+#include "koi_lossy_queue.hh"
+
+namespace koi
+{
+    // An IPC sender which never waits for its receiver, overwriting the oldest message when the queue is full
+    template <typename T>
+    class KoiLossySender : public KoiLossyQueue<T>
+    {
+    public:
+        KoiLossySender(const std::string name, size_t buffer_bytes) : KoiLossyQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiLossyQueue<T>::send;
+        // The sender may clean up the shared memory segment once the receiver has finished
+        using KoiLossyQueue<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_slot.hh"
+#include "koi_slot_queue.hh"
+#include "koi_utils.hh"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+// A fixed size message queue with many producers and many consumers, on the same persistent shm model as `KoiQueue`
+// and without a broker thread or lock. Producers claim a position with one compare and swap on the shared write
+// position and consumers claim a published message with one compare and swap on the shared read position. The
+// slot's `sequence` orders the two, so producers and consumers only contend with their own kind. As in
+// `KoiMpscQueue`, a producer which dies between claiming and publishing a slot stalls the consumers at that slot,
+// and as in `KoiSpmcQueue`, a consumer which dies between claiming and copying a message stalls the producers.
+template <typename T>
+class KoiMpmcQueue : public KoiSlotQueue<T>
+{
+protected:
+    // `buffer_bytes` is rounded down to a whole number of message blocks, and must hold at least one
+    explicit KoiMpmcQueue(const std::string name, size_t buffer_bytes);
+
+    // Returns `KoiQueueRet::QUEUE_FULL` if the queue is full, otherwise `KoiQueueRet::OK`.
+    // Safe to call concurrently from any number of processes, and threads each with their own queue
+    KoiQueueRet send(T message);
+    // Safe to call concurrently from any number of processes, and threads each with their own queue
+    std::optional<T> recv();
+
+private:
+    using KoiSlotQueue<T>::message_sz;
+    using KoiSlotQueue<T>::ring_;
+    using KoiSlotQueue<T>::write_cursor_;
+    using KoiSlotQueue<T>::read_cursor_;
+    using KoiSlotQueue<T>::message_at;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiMpmcQueueRAII : public KoiMpmcQueue<T>
+{
+public:
+    explicit KoiMpmcQueueRAII(const std::string name, size_t buffer_bytes) : KoiMpmcQueue<T>(name, buffer_bytes)
+    {
+    }
+
+    ~KoiMpmcQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiSlotQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiMpmcQueue<T>::send;
+    using KoiMpmcQueue<T>::recv;
+
+private:
+    using KoiMpmcQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_mpmc_queue.tcc"
@@ -0,0 +1,43 @@
+#include "koi_mpmc_queue.hh"
+#include "koi_slot.hh"
+
+#include <algorithm>
+#include <string>
+
+template <typename T>
+KoiMpmcQueue<T>::KoiMpmcQueue(const std::string shm_name, size_t buffer_bytes)
+    : KoiSlotQueue<T>(shm_name, buffer_bytes, "KoiMpmcQueue")
+{
+}
+
+template <typename T>
+KoiQueueRet KoiMpmcQueue<T>::send(T message)
+{
+    SlotClaim claim;
+    if (!claim_free_slot(ring_, write_cursor_, claim))
+    {
+        return KoiQueueRet::QUEUE_FULL;
+    }
+
+    // Copy the message into the shared memory
+    char *message_ptr = reinterpret_cast<char *>(&message);
+    std::copy(message_ptr, message_ptr + message_sz, message_at(claim.header));
+    complete_slot(claim);
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+std::optional<T> KoiMpmcQueue<T>::recv()
+{
+    SlotClaim claim;
+    if (!claim_published_slot(ring_, read_cursor_, claim))
+    {
+        return std::nullopt;
+    }
+
+    T message;
+    const char *message_ptr = message_at(claim.header);
+    std::copy(message_ptr, message_ptr + message_sz, reinterpret_cast<char *>(&message));
+    complete_slot(claim);
+    return message;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "koi_mpmc_queue.hh"
+
+namespace koi
+{
+    // One of many competing IPC receivers of a queue with many senders. Each message is received by exactly one
+    // receiver
+    template <typename T>
+    class KoiMpmcReceiver : public KoiMpmcQueue<T>
+    {
+    public:
+        KoiMpmcReceiver(const std::string name, size_t buffer_bytes) : KoiMpmcQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiMpmcQueue<T>::recv;
+    };
+} // namespace koi
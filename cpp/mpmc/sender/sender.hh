@@ -0,0 +1,22 @@
+#pragma once
+
+#include "koi_mpmc_queue.hh"
+
+namespace koi
+{
+    // One of many IPC senders to a queue with many receivers. A sender keeps its view of the write position,
+    // so each thread needs its own sender
+    template <typename T>
+    class KoiMpmcSender : public KoiMpmcQueue<T>
+    {
+    public:
+        KoiMpmcSender(const std::string name, size_t buffer_bytes) : KoiMpmcQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiMpmcQueue<T>::send;
+        // Any sender may clean up the shared memory segment, which should only be done after all senders and
+        // receivers have finished
+        using KoiMpmcQueue<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_slot.hh"
+#include "koi_slot_queue.hh"
+#include "koi_utils.hh"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+// A fixed size message queue with many producers and a single consumer, on the same persistent shm model as
+// `KoiQueue`. Producers in any number of threads and processes claim a position with one compare and swap on the
+// shared write position, then copy their message and publish it with the slot's `sequence` independently of each
+// other. The consumer receives in position order, so a message claimed but not yet published holds back the
+// ones after it. A producer which dies between claiming and publishing a slot stalls the consumer at that slot.
+template <typename T>
+class KoiMpscQueue : public KoiSlotQueue<T>
+{
+protected:
+    // `buffer_bytes` is rounded down to a whole number of message blocks, and must hold at least one
+    explicit KoiMpscQueue(const std::string name, size_t buffer_bytes);
+
+    // Returns `KoiQueueRet::QUEUE_FULL` if the queue is full, otherwise `KoiQueueRet::OK`.
+    // Safe to call concurrently from any number of processes, and threads each with their own queue
+    KoiQueueRet send(T message);
+    // Only one consumer may call `recv`
+    std::optional<T> recv();
+
+private:
+    using KoiSlotQueue<T>::message_sz;
+    using KoiSlotQueue<T>::ring_;
+    using KoiSlotQueue<T>::write_cursor_;
+    using KoiSlotQueue<T>::read_cursor_;
+    using KoiSlotQueue<T>::message_at;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiMpscQueueRAII : public KoiMpscQueue<T>
+{
+public:
+    explicit KoiMpscQueueRAII(const std::string name, size_t buffer_bytes) : KoiMpscQueue<T>(name, buffer_bytes)
+    {
+    }
+
+    ~KoiMpscQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiSlotQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiMpscQueue<T>::send;
+    using KoiMpscQueue<T>::recv;
+
+private:
+    using KoiMpscQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_mpsc_queue.tcc"
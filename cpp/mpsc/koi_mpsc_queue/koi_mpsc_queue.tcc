@@ -0,0 +1,51 @@
+#include "koi_mpsc_queue.hh"
+#include "koi_slot.hh"
+
+#include <algorithm>
+#include <string>
+
+template <typename T>
+KoiMpscQueue<T>::KoiMpscQueue(const std::string shm_name, size_t buffer_bytes)
+    : KoiSlotQueue<T>(shm_name, buffer_bytes, "KoiMpscQueue")
+{
+}
+
+template <typename T>
+KoiQueueRet KoiMpscQueue<T>::send(T message)
+{
+    SlotClaim claim;
+    if (!claim_free_slot(ring_, write_cursor_, claim))
+    {
+        return KoiQueueRet::QUEUE_FULL;
+    }
+
+    // Copy the message into the shared memory
+    char *message_ptr = reinterpret_cast<char *>(&message);
+    std::copy(message_ptr, message_ptr + message_sz, message_at(claim.header));
+    complete_slot(claim);
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+std::optional<T> KoiMpscQueue<T>::recv()
+{
+    // 1 cache miss. The read position is process local, only the slot header is shared
+    SlotHeader *header = ring_.header_at(read_cursor_);
+    const uint64_t published_sequence = 2 * read_cursor_.lap + 1;
+    if (header->sequence.load(std::memory_order_acquire) != published_sequence)
+    {
+        return std::nullopt;
+    }
+
+    T message;
+    const char *message_ptr = message_at(header);
+    std::copy(message_ptr, message_ptr + message_sz, reinterpret_cast<char *>(&message));
+    ring_.advance(read_cursor_);
+    // Write back for introspection and for a later consumer, see `KoiQueue::commit`
+    // `memory_order_release` pairs with the load in `size`. The producer's claim of every received position
+    // happened before this store, so `size` never sees the write position behind the read position
+    ring_.control_block->read.position.store(read_cursor_.position, std::memory_order_release);
+    // Free the slot for the producer of the next lap
+    header->sequence.store(published_sequence + 1, std::memory_order_release);
+    return message;
+}
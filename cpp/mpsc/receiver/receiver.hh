@@ -0,0 +1,18 @@
+#pragma once
+
+#include "koi_mpsc_queue.hh"
+
+namespace koi
+{
+    // The single IPC receiver of a queue with many senders
+    template <typename T>
+    class KoiMpscReceiver : public KoiMpscQueue<T>
+    {
+    public:
+        KoiMpscReceiver(const std::string name, size_t buffer_bytes) : KoiMpscQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiMpscQueue<T>::recv;
+    };
+} // namespace koi
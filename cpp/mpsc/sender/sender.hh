@@ -0,0 +1,21 @@
+#pragma once
+
+#include "koi_mpsc_queue.hh"
+
+namespace koi
+{
+    // An IPC sender to a queue shared with other senders. Any number of senders may send concurrently.
+    // A sender keeps its view of the write position, so each thread needs its own sender
+    template <typename T>
+    class KoiMpscSender : public KoiMpscQueue<T>
+    {
+    public:
+        KoiMpscSender(const std::string name, size_t buffer_bytes) : KoiMpscQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiMpscQueue<T>::send;
+        // Any sender may clean up the shared memory segment, which should only be done after all senders have finished
+        using KoiMpscQueue<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "koi_doorbell.hh"
+#include "koi_queue.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace koi
+{
+    // How `KoiMux::poll` shares the receiver between sources with messages
+    enum class MuxSchedule : uint32_t
+    {
+        // One message from each source in turn
+        ROUND_ROBIN,
+        // Up to `KoiMuxOptions::weights[source]` messages from each source in turn. A source which runs out of
+        // messages ends its turn early
+        WEIGHTED,
+    };
+
+    struct KoiMuxOptions
+    {
+        MuxSchedule schedule = MuxSchedule::ROUND_ROBIN;
+        // `MuxSchedule::WEIGHTED`: one positive weight per source
+        std::vector<size_t> weights = {};
+        // Options of every source's `KoiMuxReceiver`
+        KoiQueueOptions queue_options = {};
+    };
+
+    // The receiving end of one source of a `KoiMux`, a plain `KoiQueue` receiver
+    template <typename T>
+    class KoiMuxReceiver : public KoiQueue<T>
+    {
+    public:
+        KoiMuxReceiver(const std::string name, size_t buffer_bytes, KoiQueueOptions options = {})
+            : KoiQueue<T>(name, buffer_bytes, options)
+        {
+        }
+
+        using KoiQueue<T>::recv;
+        using KoiQueue<T>::size;
+        // Used by `KoiMux::cleanup_shm`
+        using KoiQueue<T>::cleanup_shm;
+    };
+
+    // A message received by `KoiMux`, with the index of the queue it came from
+    template <typename T>
+    struct MuxMessage
+    {
+        size_t source;
+        T message;
+    };
+
+    // A receiver of many `KoiQueue`s, the sources, through one `poll`. Each source is fed by a `KoiMuxSender`,
+    // which rings the source's bit in a shared `KoiDoorbell` after publishing, so `poll` only reads the queues
+    // whose bit was set instead of the head slot of every queue. Sources are served in index order according to
+    // the `MuxSchedule`, and the doorbell is read again each time the scan wraps around.
+    template <typename T>
+    class KoiMux
+    {
+    public:
+        // Attaches a `KoiMuxReceiver` to each of `queue_names` with `buffer_bytes`, which become sources
+        // `[0, queue_names.size())` of the doorbell `doorbell_name`.
+        // Throws `std::invalid_argument` if `MuxSchedule::WEIGHTED` is not given one positive weight per source
+        KoiMux(const std::string doorbell_name, const std::vector<std::string> &queue_names, size_t buffer_bytes, KoiMuxOptions options = {});
+
+        size_t num_sources() const;
+        // Returns the next message according to the schedule, or `std::nullopt` if no source has a message
+        std::optional<MuxMessage<T>> poll();
+        // The receiver of `source`, e.g. for its `size()`. Messages received from it directly bypass the schedule
+        KoiMuxReceiver<T> &receiver(size_t source);
+
+        // Unlinks the doorbell and the queue of every source, once the senders have finished
+        void cleanup_shm() noexcept;
+
+    private:
+        static constexpr size_t NO_SOURCE = static_cast<size_t>(-1);
+
+        KoiDoorbell doorbell_;
+        std::vector<std::unique_ptr<KoiMuxReceiver<T>>> receivers_;
+        KoiMuxOptions options_;
+        // Sources which may have messages: taken from the doorbell, and cleared once the source is found empty.
+        // A source stays marked when its turn ends with messages left
+        std::vector<uint64_t> ready_;
+        // Source whose turn it is, and the messages it may still take this turn
+        size_t current_;
+        size_t credit_ = 0;
+
+        // Returns the first marked source at or after `source`, or `NO_SOURCE`
+        size_t find_ready(size_t source) const;
+        // Marks the sources rung since the last call
+        void take_doorbell();
+        // Starts the turn of the next marked source after `current_`. Returns `false` if no source is marked
+        bool next_turn();
+    };
+
+    // A sender to one source of a `KoiMux`, which rings the source's doorbell bit after publishing
+    template <typename T>
+    class KoiMuxSender : public KoiQueue<T>
+    {
+    public:
+        // `source` is the index of `queue_name` in the `KoiMux`, of the `num_sources` sharing `doorbell_name`
+        KoiMuxSender(const std::string doorbell_name, size_t num_sources, size_t source, const std::string queue_name,
+                     size_t buffer_bytes, KoiQueueOptions options = {});
+
+        // See `KoiQueue::send`
+        KoiQueueRet send(T message);
+        // See `KoiQueue::send_batch`. Rings the doorbell once for the batch
+        size_t send_batch(std::span<const T> messages);
+
+        // The sender may clean up its queue's shared memory segment once the receiver has finished
+        using KoiQueue<T>::cleanup_shm;
+        using KoiQueue<T>::size;
+
+    private:
+        KoiDoorbell doorbell_;
+        size_t source_;
+    };
+} // namespace koi
+
+// Ensure all dependencies are declared
+#include "koi_mux.tcc"
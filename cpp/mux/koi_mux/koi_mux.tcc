@@ -0,0 +1,164 @@
+#include "koi_mux.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+namespace koi
+{
+    template <typename T>
+    KoiMux<T>::KoiMux(const std::string doorbell_name, const std::vector<std::string> &queue_names, size_t buffer_bytes, KoiMuxOptions options)
+        : doorbell_(doorbell_name, queue_names.size()), options_(std::move(options))
+    {
+        const size_t num_sources = queue_names.size();
+        if (options_.schedule == MuxSchedule::WEIGHTED &&
+            (options_.weights.size() != num_sources || std::find(options_.weights.begin(), options_.weights.end(), 0) != options_.weights.end()))
+        {
+            throw std::invalid_argument("MuxSchedule::WEIGHTED requires one positive weight for each of the " +
+                                        std::to_string(num_sources) + " sources");
+        }
+        spdlog::info("Constructing KoiMux with doorbell: {}, num_sources: {}", doorbell_name, num_sources);
+        receivers_.reserve(num_sources);
+        for (const std::string &queue_name : queue_names)
+        {
+            receivers_.push_back(std::make_unique<KoiMuxReceiver<T>>(queue_name, buffer_bytes, options_.queue_options));
+        }
+        // Every source is checked once, for messages whose bit a previous receiver took but did not drain
+        ready_.assign(doorbell_.num_words(), ~uint64_t{0});
+        if (num_sources % DOORBELL_WORD_BITS != 0)
+        {
+            ready_.back() = (uint64_t{1} << (num_sources % DOORBELL_WORD_BITS)) - 1;
+        }
+        // The first turn goes to source 0
+        current_ = num_sources - 1;
+    }
+
+    template <typename T>
+    size_t KoiMux<T>::num_sources() const
+    {
+        return receivers_.size();
+    }
+
+    template <typename T>
+    KoiMuxReceiver<T> &KoiMux<T>::receiver(size_t source)
+    {
+        return *receivers_.at(source);
+    }
+
+    template <typename T>
+    void KoiMux<T>::cleanup_shm() noexcept
+    {
+        for (std::unique_ptr<KoiMuxReceiver<T>> &receiver : receivers_)
+        {
+            receiver->cleanup_shm();
+        }
+        doorbell_.cleanup_shm();
+    }
+
+    template <typename T>
+    std::optional<MuxMessage<T>> KoiMux<T>::poll()
+    {
+        while (true)
+        {
+            if (credit_ > 0)
+            {
+                if (std::optional<T> message = receivers_[current_]->recv())
+                {
+                    --credit_;
+                    return MuxMessage<T>{current_, std::move(message.value())};
+                }
+                // The source rings again for its next message
+                ready_[current_ / DOORBELL_WORD_BITS] &= ~(uint64_t{1} << (current_ % DOORBELL_WORD_BITS));
+                credit_ = 0;
+            }
+            if (!next_turn())
+            {
+                return std::nullopt;
+            }
+        }
+    }
+
+    template <typename T>
+    bool KoiMux<T>::next_turn()
+    {
+        size_t next = find_ready(current_ + 1);
+        if (next == NO_SOURCE)
+        {
+            // Sources rung since the last scan join at the wrap around, so a busy source ahead of them in the
+            // scan cannot keep them waiting for more than one round
+            take_doorbell();
+            next = find_ready(0);
+            if (next == NO_SOURCE)
+            {
+                return false;
+            }
+        }
+        current_ = next;
+        credit_ = options_.schedule == MuxSchedule::WEIGHTED ? options_.weights[next] : 1;
+        return true;
+    }
+
+    template <typename T>
+    size_t KoiMux<T>::find_ready(size_t source) const
+    {
+        for (size_t word = source / DOORBELL_WORD_BITS; word < ready_.size(); ++word)
+        {
+            uint64_t bits = ready_[word];
+            if (word == source / DOORBELL_WORD_BITS)
+            {
+                // Only the sources at or after `source`
+                bits &= ~uint64_t{0} << (source % DOORBELL_WORD_BITS);
+            }
+            if (bits != 0)
+            {
+                return word * DOORBELL_WORD_BITS + std::countr_zero(bits);
+            }
+        }
+        return NO_SOURCE;
+    }
+
+    template <typename T>
+    void KoiMux<T>::take_doorbell()
+    {
+        for (size_t word = 0; word < ready_.size(); ++word)
+        {
+            ready_[word] |= doorbell_.take(word);
+        }
+    }
+
+    template <typename T>
+    KoiMuxSender<T>::KoiMuxSender(const std::string doorbell_name, size_t num_sources, size_t source,
+                                  const std::string queue_name, size_t buffer_bytes, KoiQueueOptions options)
+        : KoiQueue<T>(queue_name, buffer_bytes, options), doorbell_(doorbell_name, num_sources), source_(source)
+    {
+        if (source >= num_sources)
+        {
+            throw std::out_of_range("source " + std::to_string(source) + " is not less than num_sources " + std::to_string(num_sources));
+        }
+    }
+
+    template <typename T>
+    KoiQueueRet KoiMuxSender<T>::send(T message)
+    {
+        const KoiQueueRet ret = KoiQueue<T>::send(message);
+        if (ret == KoiQueueRet::OK)
+        {
+            doorbell_.ring(source_);
+        }
+        return ret;
+    }
+
+    template <typename T>
+    size_t KoiMuxSender<T>::send_batch(std::span<const T> messages)
+    {
+        const size_t sent = KoiQueue<T>::send_batch(messages);
+        if (sent > 0)
+        {
+            doorbell_.ring(source_);
+        }
+        return sent;
+    }
+} // namespace koi
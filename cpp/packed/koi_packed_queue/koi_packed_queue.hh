@@ -0,0 +1,142 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// `LineHeader` starts each cache line of the ring buffer
+struct LineHeader
+{
+    // Number of messages published in the line, 0 while the line is free
+    std::atomic<uint32_t> count;
+};
+
+// Contains read/write metadata on one cacheline
+struct PackedControlBlockInner
+{
+    // Either read or write offset of a line
+    std::atomic<size_t> offset;
+    // Duplicate the read only fields for the read/write cache line for prefetching.
+    // The values are identical between the read/write cache lines.
+    size_t user_shm_size;
+    size_t message_sz;
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+};
+
+// Shared information among all processes encoded in the shared memory
+struct PackedControlBlock
+{
+    // The below are aligned to the nearest cache line to avoid false sharing
+    // "tail"
+    alignas(CACHE_LINE_BYTES) PackedControlBlockInner write;
+    // "head"
+    alignas(CACHE_LINE_BYTES) PackedControlBlockInner read;
+};
+
+// Forward declaration of KoiPackedQueueRAII
+template <typename T>
+class KoiPackedQueueRAII;
+
+// A queue for tiny fixed size messages (e.g. 4 to 16 byte ids or acks) which packs many messages into each
+// cache line under a single `LineHeader`, instead of one message per cache line sized block like `KoiQueue`.
+//
+// The sender fills a line in process local order and publishes it in one store of the line's `count` once the
+// line is full, or early on `flush`. The receiver reads the published messages of a line and frees the whole
+// line after the last one. One flag handoff (and one cache line transfer) therefore moves up to
+// `messages_per_line()` messages. Messages are only visible to the receiver once their line is published, so a
+// sender must `flush` before going idle. A flushed partial line is not appended to, the sender continues on the
+// next line.
+template <typename T>
+class KoiPackedQueue
+{
+public:
+    // Returns total size of the shm segment that the user allocated
+    size_t user_shm_size() const;
+    // Returns if no published messages are waiting to be received
+    bool is_empty() const;
+    // Returns the number of lines in the ring buffer
+    size_t num_lines() const;
+    // Returns the number of messages packed into each line
+    static constexpr size_t messages_per_line();
+
+protected:
+    // `buffer_bytes` is rounded down to a whole number of cache lines, and must hold at least one
+    explicit KoiPackedQueue(const std::string name, size_t buffer_bytes);
+    virtual ~KoiPackedQueue();
+
+    // Returns `KoiQueueRet::QUEUE_FULL` if the queue is full, otherwise `KoiQueueRet::OK`.
+    // The message is published once its line is full or on `flush`
+    KoiQueueRet send(T message);
+    // Publishes the messages in the current line, if any
+    void flush();
+    std::optional<T> recv();
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    // Offset of the first message from the start of its line. The header is padded so messages are aligned for `T`
+    static constexpr size_t message_offset_ = (sizeof(LineHeader) + alignof(T) - 1) & ~(alignof(T) - 1);
+    static constexpr size_t messages_per_line_ = (CACHE_LINE_BYTES - message_offset_) / sizeof(T);
+    static constexpr size_t message_sz = sizeof(T);
+
+    PackedControlBlock *control_block_;
+
+    struct ShmMetadata : ShmSegment
+    {
+        // `shm_ptr` + sizeof(PackedControlBlock) (aligned to the nearest cache line)
+        // Start of the ring buffer
+        char *user_shm_start;
+        size_t user_shm_size;
+    };
+
+    ShmMetadata shm_metadata_;
+
+    // Process local copies of the write and read line offsets, see `KoiQueue::write_offset_`
+    size_t write_offset_ = 0;
+    size_t read_offset_ = 0;
+    // Sender: number of messages written into the line at `write_offset_` which are not yet published
+    size_t write_count_ = 0;
+    // Receiver: number of messages already received from the line at `read_offset_`
+    size_t read_count_ = 0;
+
+    LineHeader *header_at(size_t offset) const;
+    T *message_at(size_t offset, size_t index) const;
+    // Returns the offset of the line after `offset`, wrapping around the ring buffer
+    size_t offset_after(size_t offset) const;
+
+    // Allow `KoiPackedQueueRAII` to access private and protected members, particularly `cleanup_shm`
+    friend class KoiPackedQueueRAII<T>;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiPackedQueueRAII : public KoiPackedQueue<T>
+{
+public:
+    explicit KoiPackedQueueRAII(const std::string name, size_t buffer_bytes) : KoiPackedQueue<T>(name, buffer_bytes)
+    {
+    }
+
+    ~KoiPackedQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiPackedQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiPackedQueue<T>::send;
+    using KoiPackedQueue<T>::flush;
+    using KoiPackedQueue<T>::recv;
+
+private:
+    using KoiPackedQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_packed_queue.tcc"
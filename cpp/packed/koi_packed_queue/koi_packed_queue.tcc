@@ -0,0 +1,232 @@
+#include "koi_packed_queue.hh"
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// If the shm segment at `shm_name` has already been created, then the provided `buffer_bytes` must round down to
+// the same number of lines as the existing shared memory, and the message size must match the existing one.
+template <typename T>
+KoiPackedQueue<T>::KoiPackedQueue(const std::string shm_name, size_t buffer_bytes)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    // `send`/`recv` will do a bitwise memcpy of T into the shared memory
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+    // Larger messages gain nothing from packing, use `KoiQueue` instead
+    static_assert(messages_per_line_ >= 2, "T is too large to pack at least two messages into a cache line");
+    // The read position written back to the control block keeps the index into a line in the offset's low bits
+    static_assert(messages_per_line_ < CACHE_LINE_BYTES, "Messages per line must fit in the low bits of a line offset");
+
+    spdlog::info("Constructing KoiPackedQueue with shm_name: {}, buffer_bytes: {} bytes", shm_name, buffer_bytes);
+    spdlog::info("KoiPackedQueue running with message_sz: {}, messages_per_line: {}", message_sz, messages_per_line_);
+    shm_metadata_.shm_name = std::move(shm_name);
+
+    // The ring buffer holds whole lines, any trailing bytes are unused
+    const size_t user_shm_size = buffer_bytes & ~(CACHE_LINE_BYTES - 1);
+    if (user_shm_size == 0)
+    {
+        throw std::invalid_argument("buffer_bytes provided " + std::to_string(buffer_bytes) +
+                                    " is smaller than a cache line of " + std::to_string(CACHE_LINE_BYTES) + " bytes");
+    }
+    shm_metadata_.user_shm_size = user_shm_size;
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = shm_metadata_.open();
+        // The shared memory is initialized with extra space bytes which holds the control block
+        size_t control_block_sz = size_rounded_to_cache_line<PackedControlBlock>();
+        shm_metadata_.map(control_block_sz + user_shm_size);
+        // The ring buffer starts after the control block
+        shm_metadata_.user_shm_start = shm_metadata_.shm_ptr + control_block_sz;
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    control_block_ = reinterpret_cast<PackedControlBlock *>(shm_metadata_.shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (control_block_->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block_->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // Sanity check that the user_shm_size is the same as the existing shared memory
+        if (control_block_->write.user_shm_size != user_shm_size)
+        {
+            spdlog::error("user_shm_size provided: {}, existing user_shm_size: {}", user_shm_size, control_block_->write.user_shm_size);
+            throw std::runtime_error("user_shm_size provided does not match existing shared memory");
+        }
+        // The message size decides how many messages share a line, so it must match as well
+        if (control_block_->write.message_sz != message_sz)
+        {
+            spdlog::error("message_sz provided: {}, existing message_sz: {}", message_sz, control_block_->write.message_sz);
+            throw std::runtime_error("message_sz provided does not match existing shared memory");
+        }
+        // Pick up where the previous sender or receiver left off, including a partially received line
+        write_offset_ = control_block_->write.offset.load(std::memory_order_relaxed);
+        const size_t read_position = control_block_->read.offset.load(std::memory_order_relaxed);
+        read_offset_ = read_position & ~(CACHE_LINE_BYTES - 1);
+        read_count_ = read_position & (CACHE_LINE_BYTES - 1);
+        return;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so every line header is already free.
+    control_block_->write.user_shm_size = user_shm_size;
+    control_block_->write.message_sz = message_sz;
+    control_block_->write.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->write.offset = 0;
+    control_block_->read.user_shm_size = user_shm_size;
+    control_block_->read.message_sz = message_sz;
+    control_block_->read.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->read.offset = 0;
+    spdlog::debug("Control block initialized with user_shm_size: {}, message_sz: {}", user_shm_size, message_sz);
+}
+
+template <typename T>
+KoiPackedQueue<T>::~KoiPackedQueue()
+{
+    spdlog::debug("Starting KoiPackedQueue destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`
+
+    // Publish the sender's partial line so its messages are not lost.
+    // `shm_ptr` is unset if the segment was already cleaned up (e.g. by `KoiPackedQueueRAII`)
+    if (write_count_ > 0 && shm_metadata_.shm_ptr != nullptr)
+    {
+        flush();
+    }
+}
+
+template <typename T>
+void KoiPackedQueue<T>::cleanup_shm() noexcept
+{
+    shm_metadata_.cleanup();
+}
+
+template <typename T>
+size_t KoiPackedQueue<T>::user_shm_size() const
+{
+    return shm_metadata_.user_shm_size;
+}
+
+template <typename T>
+size_t KoiPackedQueue<T>::num_lines() const
+{
+    return shm_metadata_.user_shm_size / CACHE_LINE_BYTES;
+}
+
+template <typename T>
+constexpr size_t KoiPackedQueue<T>::messages_per_line()
+{
+    return messages_per_line_;
+}
+
+template <typename T>
+bool KoiPackedQueue<T>::is_empty() const
+{
+    // `read_offset_` is process local, so load the receiver's line from the control block as the sender may call this.
+    // A line is freed as soon as its last message is received, so a published line always has messages left
+    const size_t read_position = control_block_->read.offset.load(std::memory_order_relaxed);
+    return header_at(read_position & ~(CACHE_LINE_BYTES - 1))->count.load(std::memory_order_acquire) == 0;
+}
+
+template <typename T>
+KoiQueueRet KoiPackedQueue<T>::send(T message)
+{
+    // Only the first message of a line touches the shared header. The rest of the line is process local until
+    // it is published
+    if (write_count_ == 0)
+    {
+        // `memory_order_acquire` so the receiver has finished reading the line before it is overwritten
+        if (header_at(write_offset_)->count.load(std::memory_order_acquire) != 0)
+        {
+            return KoiQueueRet::QUEUE_FULL;
+        }
+    }
+
+    // Copy the message into the shared memory
+    char *message_ptr = reinterpret_cast<char *>(&message);
+    std::copy(message_ptr, message_ptr + message_sz, reinterpret_cast<char *>(message_at(write_offset_, write_count_)));
+    if (++write_count_ == messages_per_line_)
+    {
+        flush();
+    }
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+void KoiPackedQueue<T>::flush()
+{
+    if (write_count_ == 0)
+    {
+        return;
+    }
+    LineHeader *header = header_at(write_offset_);
+    const uint32_t count = static_cast<uint32_t>(write_count_);
+    write_offset_ = offset_after(write_offset_);
+    write_count_ = 0;
+    // Write back for introspection, see `KoiQueue::commit`
+    // `memory_order_relaxed` because synchronization occurs via the line's `count`
+    control_block_->write.offset.store(write_offset_, std::memory_order_relaxed);
+    // One release store publishes every message in the line
+    header->count.store(count, std::memory_order_release);
+}
+
+template <typename T>
+std::optional<T> KoiPackedQueue<T>::recv()
+{
+    // Only the first message of a line misses on the shared header, the rest of the line is already in cache
+    LineHeader *header = header_at(read_offset_);
+    const uint32_t count = header->count.load(std::memory_order_acquire);
+    if (count == 0)
+    {
+        return std::nullopt;
+    }
+
+    T message;
+    const char *message_ptr = reinterpret_cast<const char *>(message_at(read_offset_, read_count_));
+    std::copy(message_ptr, message_ptr + message_sz, reinterpret_cast<char *>(&message));
+    if (++read_count_ == count)
+    {
+        // The whole line has been received, hand it back to the sender
+        read_offset_ = offset_after(read_offset_);
+        read_count_ = 0;
+        header->count.store(0, std::memory_order_release);
+    }
+    // Write back for introspection and for a later receiver. The index into the line is kept in the low bits,
+    // which are always zero in a line offset.
+    // `memory_order_relaxed` because synchronization occurs via the line's `count`
+    control_block_->read.offset.store(read_offset_ + read_count_, std::memory_order_relaxed);
+    return message;
+}
+
+template <typename T>
+LineHeader *KoiPackedQueue<T>::header_at(size_t offset) const
+{
+    return reinterpret_cast<LineHeader *>(shm_metadata_.user_shm_start + offset);
+}
+
+template <typename T>
+T *KoiPackedQueue<T>::message_at(size_t offset, size_t index) const
+{
+    return reinterpret_cast<T *>(shm_metadata_.user_shm_start + offset + message_offset_ + index * message_sz);
+}
+
+template <typename T>
+size_t KoiPackedQueue<T>::offset_after(size_t offset) const
+{
+    const size_t next_offset = offset + CACHE_LINE_BYTES;
+    return next_offset == shm_metadata_.user_shm_size ? 0 : next_offset;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "koi_packed_queue.hh"
+
+namespace koi
+{
+    // An IPC receiver of tiny messages packed many to a cache line
+    template <typename T>
+    class KoiPackedReceiver : public KoiPackedQueue<T>
+    {
+    public:
+        KoiPackedReceiver(const std::string name, size_t buffer_bytes) : KoiPackedQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiPackedQueue<T>::recv;
+    };
+} // namespace koi
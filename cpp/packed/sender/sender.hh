@@ -0,0 +1,23 @@
+#pragma once
+
+#include "koi_packed_queue.hh"
+
+namespace koi
+{
+    // An IPC sender of tiny messages packed many to a cache line.
+    // Messages are visible to the receiver once their line fills up or on `flush`
+    template <typename T>
+    class KoiPackedSender : public KoiPackedQueue<T>
+    {
+    public:
+        KoiPackedSender(const std::string name, size_t buffer_bytes) : KoiPackedQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiPackedQueue<T>::send;
+        using KoiPackedQueue<T>::flush;
+        // Currently only the sender is allowed to clean up the shared memory segment
+        // since there is only one sender
+        using KoiPackedQueue<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Contains the writer's metadata on one cacheline
+struct SnapshotControlBlockInner
+{
+    // Seqlock sequence. Odd while the writer is copying a value in, and incremented twice per publish, so
+    // `sequence / 2` is the number of values published. 0 until the first value is published
+    std::atomic<uint64_t> sequence;
+    size_t value_sz;
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+};
+
+// Shared information among all processes encoded in the shared memory
+struct SnapshotControlBlock
+{
+    // Aligned to the nearest cache line, so the value starts on its own cache line after it
+    alignas(CACHE_LINE_BYTES) SnapshotControlBlockInner write;
+};
+
+// Forward declaration of KoiSnapshotRAII
+template <typename T>
+class KoiSnapshotRAII;
+
+// A single slot channel holding the latest published value of `T`, for state where only the most recent value
+// matters (e.g. risk limits or the top of a book). Publishing replaces the value instead of queueing it, so
+// readers never drain stale values. The writer publishes under a seqlock. Readers retry until they copy the value
+// without a publish overlapping the copy, so any number of readers get untorn values without writing to shared
+// memory. Only one writer may publish at a time. A writer which dies mid publish leaves the sequence odd, and
+// readers wait until a later writer publishes again.
+template <typename T>
+class KoiSnapshot
+{
+public:
+    // Returns the size of the stored value in bytes
+    static constexpr size_t value_sz_bytes();
+    // Returns the number of values published to the segment, by any writer
+    uint64_t version() const;
+
+protected:
+    explicit KoiSnapshot(const std::string name);
+    virtual ~KoiSnapshot();
+
+    // Replaces the value
+    void publish(const T &value);
+    // Returns a copy of the latest value, or `std::nullopt` if none was published. Spins while a publish is in
+    // progress
+    std::optional<T> read() const;
+    // Returns a copy of the latest value if it was published after version `last_version`, and updates
+    // `last_version`. Otherwise returns `std::nullopt`
+    std::optional<T> read_if_newer(uint64_t &last_version) const;
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    static constexpr size_t value_sz_ = sizeof(T);
+
+    SnapshotControlBlock *control_block_;
+    // Start of the value, on the cache line after the control block
+    char *value_;
+
+    ShmSegment shm_segment_;
+
+    // Copies the value out under the seqlock, and returns the even sequence it was copied at
+    uint64_t read_into(T &value) const;
+
+    // Allow `KoiSnapshotRAII` to access private and protected members, particularly `cleanup_shm`
+    friend class KoiSnapshotRAII<T>;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiSnapshotRAII : public KoiSnapshot<T>
+{
+public:
+    explicit KoiSnapshotRAII(const std::string name) : KoiSnapshot<T>(name)
+    {
+    }
+
+    ~KoiSnapshotRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiSnapshot` destructor
+        cleanup_shm();
+    }
+
+    using KoiSnapshot<T>::publish;
+    using KoiSnapshot<T>::read;
+    using KoiSnapshot<T>::read_if_newer;
+
+private:
+    using KoiSnapshot<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_snapshot.tcc"
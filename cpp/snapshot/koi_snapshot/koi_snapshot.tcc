@@ -0,0 +1,151 @@
+#include "koi_snapshot.hh"
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// If the shm segment at `shm_name` has already been created, then `T` must have the same size as the value
+// stored in it.
+template <typename T>
+KoiSnapshot<T>::KoiSnapshot(const std::string shm_name)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    // `publish`/`read` will do a bitwise memcpy of T into the shared memory
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+    static_assert(alignof(T) <= CACHE_LINE_BYTES, "T must not be aligned to more than a cache line");
+
+    spdlog::info("Constructing KoiSnapshot with shm_name: {}, value_sz: {} bytes", shm_name, value_sz_);
+    shm_segment_.shm_name = std::move(shm_name);
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = shm_segment_.open();
+        // The value starts on the cache line after the control block
+        size_t control_block_sz = size_rounded_to_cache_line<SnapshotControlBlock>();
+        shm_segment_.map(control_block_sz + value_sz_);
+        value_ = shm_segment_.shm_ptr + control_block_sz;
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    control_block_ = reinterpret_cast<SnapshotControlBlock *>(shm_segment_.shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (control_block_->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block_->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // Sanity check that the value size is the same as the existing shared memory
+        if (control_block_->write.value_sz != value_sz_)
+        {
+            spdlog::error("value_sz provided: {}, existing value_sz: {}", value_sz_, control_block_->write.value_sz);
+            throw std::runtime_error("value_sz provided does not match existing shared memory");
+        }
+        return;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so the sequence says no value was published.
+    control_block_->write.value_sz = value_sz_;
+    control_block_->write.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->write.sequence = 0;
+    spdlog::debug("Control block initialized with value_sz: {}", value_sz_);
+}
+
+template <typename T>
+KoiSnapshot<T>::~KoiSnapshot()
+{
+    spdlog::debug("Starting KoiSnapshot destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`. Readers attaching later read the last value
+}
+
+template <typename T>
+void KoiSnapshot<T>::cleanup_shm() noexcept
+{
+    shm_segment_.cleanup();
+}
+
+template <typename T>
+constexpr size_t KoiSnapshot<T>::value_sz_bytes()
+{
+    return value_sz_;
+}
+
+template <typename T>
+uint64_t KoiSnapshot<T>::version() const
+{
+    return control_block_->write.sequence.load(std::memory_order_acquire) / 2;
+}
+
+template <typename T>
+void KoiSnapshot<T>::publish(const T &value)
+{
+    std::atomic<uint64_t> &sequence = control_block_->write.sequence;
+    uint64_t start = sequence.load(std::memory_order_relaxed);
+    // An odd sequence was left by a writer which died mid publish. The value is overwritten anyway
+    start += start & 1;
+    sequence.store(start + 1, std::memory_order_relaxed);
+    // Orders the odd sequence before the copy, so a reader which sees part of the new value sees the sequence move
+    std::atomic_thread_fence(std::memory_order_release);
+    const char *value_ptr = reinterpret_cast<const char *>(&value);
+    std::copy(value_ptr, value_ptr + value_sz_, value_);
+    sequence.store(start + 2, std::memory_order_release);
+}
+
+template <typename T>
+uint64_t KoiSnapshot<T>::read_into(T &value) const
+{
+    const std::atomic<uint64_t> &sequence = control_block_->write.sequence;
+    while (true)
+    {
+        const uint64_t start = sequence.load(std::memory_order_acquire);
+        if (start & 1)
+        {
+            // A publish is in progress
+            continue;
+        }
+        std::copy(value_, value_ + value_sz_, reinterpret_cast<char *>(&value));
+        // Orders the copy before the second load, which only confirms the copy if no publish overlapped it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == start)
+        {
+            return start;
+        }
+    }
+}
+
+template <typename T>
+std::optional<T> KoiSnapshot<T>::read() const
+{
+    T value;
+    if (read_into(value) == 0)
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+template <typename T>
+std::optional<T> KoiSnapshot<T>::read_if_newer(uint64_t &last_version) const
+{
+    // Checked before copying, so polling an unchanged value only reads the sequence
+    if (version() <= last_version)
+    {
+        return std::nullopt;
+    }
+    T value;
+    last_version = read_into(value) / 2;
+    return value;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "koi_snapshot.hh"
+
+namespace koi
+{
+    // One of any number of IPC readers of a latest value channel. Reading never writes to the shared memory
+    template <typename T>
+    class KoiSnapshotReceiver : public KoiSnapshot<T>
+    {
+    public:
+        explicit KoiSnapshotReceiver(const std::string name) : KoiSnapshot<T>(name)
+        {
+        }
+
+        using KoiSnapshot<T>::read;
+        using KoiSnapshot<T>::read_if_newer;
+    };
+} // namespace koi
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "koi_snapshot.hh"
+
+namespace koi
+{
+    // The single IPC writer of a latest value channel
+    template <typename T>
+    class KoiSnapshotSender : public KoiSnapshot<T>
+    {
+    public:
+        explicit KoiSnapshotSender(const std::string name) : KoiSnapshot<T>(name)
+        {
+        }
+
+        using KoiSnapshot<T>::publish;
+        // The writer may clean up the shared memory segment once the readers have finished
+        using KoiSnapshot<T>::cleanup_shm;
+    };
+} // namespace koi
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_slot.hh"
+#include "koi_slot_queue.hh"
+#include "koi_utils.hh"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+// A fixed size work queue with a single producer and many competing consumers, where each message is received by
+// exactly one consumer. Consumers in any number of threads and processes claim the next published message with one
+// compare and swap on the shared read position, so an idle consumer takes the next message instead of it waiting
+// behind a busy one. The producer reuses a slot once the consumer which claimed it has copied the message out, so a
+// consumer which dies between claiming and copying a message stalls the producer at that slot on the next lap.
+template <typename T>
+class KoiSpmcQueue : public KoiSlotQueue<T>
+{
+protected:
+    // `buffer_bytes` is rounded down to a whole number of message blocks, and must hold at least one
+    explicit KoiSpmcQueue(const std::string name, size_t buffer_bytes);
+
+    // Returns `KoiQueueRet::QUEUE_FULL` if the queue is full, otherwise `KoiQueueRet::OK`.
+    // Only one producer may call `send`
+    KoiQueueRet send(T message);
+    // Safe to call concurrently from any number of processes, and threads each with their own queue
+    std::optional<T> recv();
+
+private:
+    using KoiSlotQueue<T>::message_sz;
+    using KoiSlotQueue<T>::ring_;
+    using KoiSlotQueue<T>::write_cursor_;
+    using KoiSlotQueue<T>::read_cursor_;
+    using KoiSlotQueue<T>::message_at;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+template <typename T>
+class KoiSpmcQueueRAII : public KoiSpmcQueue<T>
+{
+public:
+    explicit KoiSpmcQueueRAII(const std::string name, size_t buffer_bytes) : KoiSpmcQueue<T>(name, buffer_bytes)
+    {
+    }
+
+    ~KoiSpmcQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiSlotQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiSpmcQueue<T>::send;
+    using KoiSpmcQueue<T>::recv;
+
+private:
+    using KoiSpmcQueue<T>::cleanup_shm;
+};
+
+// Ensure all dependencies are declared
+#include "koi_spmc_queue.tcc"
@@ -0,0 +1,51 @@
+#include "koi_spmc_queue.hh"
+#include "koi_slot.hh"
+
+#include <algorithm>
+#include <string>
+
+template <typename T>
+KoiSpmcQueue<T>::KoiSpmcQueue(const std::string shm_name, size_t buffer_bytes)
+    : KoiSlotQueue<T>(shm_name, buffer_bytes, "KoiSpmcQueue")
+{
+}
+
+template <typename T>
+KoiQueueRet KoiSpmcQueue<T>::send(T message)
+{
+    // 1 cache miss. The write position is process local, only the slot header is shared
+    SlotHeader *header = ring_.header_at(write_cursor_);
+    const uint64_t free_sequence = 2 * write_cursor_.lap;
+    // `memory_order_acquire` so the consumer has finished copying the message out before the slot is overwritten
+    if (header->sequence.load(std::memory_order_acquire) != free_sequence)
+    {
+        // The slot is still in use by the previous lap, the queue is full
+        return KoiQueueRet::QUEUE_FULL;
+    }
+
+    // Copy the message into the shared memory
+    char *message_ptr = reinterpret_cast<char *>(&message);
+    std::copy(message_ptr, message_ptr + message_sz, message_at(header));
+    header->sequence.store(free_sequence + 1, std::memory_order_release);
+    ring_.advance(write_cursor_);
+    // Write back for introspection and for a later producer, see `KoiQueue::commit`.
+    // Consumers never read it, they claim from the slot sequences and the read position
+    ring_.control_block->write.position.store(write_cursor_.position, std::memory_order_release);
+    return KoiQueueRet::OK;
+}
+
+template <typename T>
+std::optional<T> KoiSpmcQueue<T>::recv()
+{
+    SlotClaim claim;
+    if (!claim_published_slot(ring_, read_cursor_, claim))
+    {
+        return std::nullopt;
+    }
+
+    T message;
+    const char *message_ptr = message_at(claim.header);
+    std::copy(message_ptr, message_ptr + message_sz, reinterpret_cast<char *>(&message));
+    complete_slot(claim);
+    return message;
+}
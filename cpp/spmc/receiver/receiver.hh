@@ -0,0 +1,19 @@
+#pragma once
+
+#include "koi_spmc_queue.hh"
+
+namespace koi
+{
+    // One of many competing IPC receivers of a work queue. Each message is received by exactly one receiver.
+    // A receiver keeps its view of the read position, so each thread needs its own receiver
+    template <typename T>
+    class KoiSpmcReceiver : public KoiSpmcQueue<T>
+    {
+    public:
+        KoiSpmcReceiver(const std::string name, size_t buffer_bytes) : KoiSpmcQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiSpmcQueue<T>::recv;
+    };
+} // namespace koi
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "koi_spmc_queue.hh"
+
+namespace koi
+{
+    // The single IPC sender of a work queue shared by many receivers
+    template <typename T>
+    class KoiSpmcSender : public KoiSpmcQueue<T>
+    {
+    public:
+        KoiSpmcSender(const std::string name, size_t buffer_bytes) : KoiSpmcQueue<T>(name, buffer_bytes)
+        {
+        }
+
+        using KoiSpmcQueue<T>::send;
+        // The sender may clean up the shared memory segment once the receivers have finished
+        using KoiSpmcQueue<T>::cleanup_shm;
+    };
+} // namespace koi
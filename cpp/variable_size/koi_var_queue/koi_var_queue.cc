@@ -0,0 +1,260 @@
+#include "koi_var_queue.hh"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+// If the shm segment at `shm_name` has already been created, then the provided `user_shm_size` must be
+// the same as the existing shared memory size encoded in the shared memory control block.
+KoiVarQueue::KoiVarQueue(const std::string shm_name, size_t user_shm_size)
+{
+    load_spdlog_level();
+    check_cache_line_bytes();
+    spdlog::info("Constructing KoiVarQueue with shm_name: {}, user_shm_size: {} bytes", shm_name, user_shm_size);
+    shm_metadata_.shm_name = std::move(shm_name);
+
+    // The `user_shm_size` must be a power of 2 so positions map to offsets with a mask.
+    // A record and the header of the following record always need at least two cache lines.
+    if ((user_shm_size & (user_shm_size - 1)) != 0 || user_shm_size < 2 * CACHE_LINE_BYTES)
+    {
+        throw std::invalid_argument("user_shm_size provided " + std::to_string(user_shm_size) +
+                                    " is not a power of 2 of at least two cache lines");
+    }
+    shm_metadata_.user_shm_size = user_shm_size;
+
+    int open_ret = -1;
+    try
+    {
+        open_ret = shm_metadata_.open();
+        // The shared memory is initialized with extra space bytes which holds the control block
+        size_t control_block_sz = size_rounded_to_cache_line<VarControlBlock>();
+        shm_metadata_.map(control_block_sz + user_shm_size);
+        // The ring buffer starts after the control block
+        shm_metadata_.user_shm_start = shm_metadata_.shm_ptr + control_block_sz;
+    }
+    catch (const std::exception &e)
+    {
+        // Destructor will not be called. Clean up the shared memory file, if any
+        cleanup_shm();
+        throw;
+    }
+
+    control_block_ = reinterpret_cast<VarControlBlock *>(shm_metadata_.shm_ptr);
+    if (open_ret == SHM_EXISTS)
+    {
+        // Checked first, see `KoiQueue::KoiQueue`
+        if (control_block_->write.cache_line_bytes != CACHE_LINE_BYTES)
+        {
+            spdlog::error("CACHE_LINE_BYTES: {}, existing cache_line_bytes: {}", CACHE_LINE_BYTES, control_block_->write.cache_line_bytes);
+            throw std::runtime_error("CACHE_LINE_BYTES does not match existing shared memory built with a different line size");
+        }
+        // Sanity check that the user_shm_size is the same as the existing shared memory
+        if (control_block_->write.user_shm_size != user_shm_size)
+        {
+            spdlog::error("user_shm_size provided: {}, existing user_shm_size: {}", user_shm_size, control_block_->write.user_shm_size);
+            throw std::runtime_error("user_shm_size provided does not match existing shared memory");
+        }
+        // Pick up where the previous sender or receiver left off
+        write_position_ = control_block_->write.position.load(std::memory_order_relaxed);
+        read_position_ = control_block_->read.position.load(std::memory_order_acquire);
+        cached_read_position_ = read_position_;
+        return;
+    }
+    // The shared memory was created, so initialize the control block.
+    // The new segment is zero filled, so the first record header is already unoccupied.
+    control_block_->write.user_shm_size = user_shm_size;
+    control_block_->write.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->write.position = 0;
+    control_block_->read.user_shm_size = user_shm_size;
+    control_block_->read.cache_line_bytes = CACHE_LINE_BYTES;
+    control_block_->read.position = 0;
+    spdlog::debug("Control block initialized with user_shm_size: {}", user_shm_size);
+}
+
+KoiVarQueue::~KoiVarQueue()
+{
+    spdlog::debug("Starting KoiVarQueue destructor");
+    // The shm segment is not cleaned up, see `KoiQueue::~KoiQueue`
+}
+
+void KoiVarQueue::cleanup_shm() noexcept
+{
+    shm_metadata_.cleanup();
+}
+
+RecordHeader *KoiVarQueue::header_at(size_t position) const
+{
+    return reinterpret_cast<RecordHeader *>(shm_metadata_.user_shm_start + (position & (shm_metadata_.user_shm_size - 1)));
+}
+
+bool KoiVarQueue::has_free_bytes(size_t write_position, size_t bytes)
+{
+    const size_t user_shm_size = shm_metadata_.user_shm_size;
+    if (user_shm_size - (write_position - cached_read_position_) >= bytes)
+    {
+        return true;
+    }
+    // `memory_order_acquire` so the receiver has finished reading the bytes before they are overwritten
+    cached_read_position_ = control_block_->read.position.load(std::memory_order_acquire);
+    return user_shm_size - (write_position - cached_read_position_) >= bytes;
+}
+
+void KoiVarQueue::publish(RecordHeader *header, size_t next_write_position)
+{
+    // Clear the header of the following record before publishing this one. The line may hold stale bytes from
+    // an earlier lap, and the receiver must see it as unoccupied once it has read this record.
+    header_at(next_write_position)->occupied.store(false, std::memory_order_relaxed);
+    write_position_ = next_write_position;
+    // Write back for introspection, see `KoiQueue::commit`
+    // `memory_order_relaxed` because synchronization occurs via the `occupied` flag
+    control_block_->write.position.store(next_write_position, std::memory_order_relaxed);
+    header->occupied.store(true, std::memory_order_release);
+}
+
+KoiQueueRet KoiVarQueue::send(std::span<const std::byte> message)
+{
+    if (message.size() > max_message_sz())
+    {
+        throw std::invalid_argument("Message size " + std::to_string(message.size()) +
+                                    " is larger than the max message size " + std::to_string(max_message_sz()));
+    }
+    const size_t block_sz = record_block_sz(message.size());
+    const size_t user_shm_size = shm_metadata_.user_shm_size;
+    size_t write_position = write_position_;
+
+    // Records are never split across the end of the ring buffer. If the record does not fit before the end,
+    // a wrap record pads out the end and the record starts at the beginning of the ring buffer.
+    const size_t bytes_to_end = user_shm_size - (write_position & (user_shm_size - 1));
+    if (bytes_to_end < block_sz) [[unlikely]]
+    {
+        // The wrap record covers the rest of the ring buffer, plus the first header of the next lap
+        if (!has_free_bytes(write_position, bytes_to_end + CACHE_LINE_BYTES))
+        {
+            return KoiQueueRet::QUEUE_FULL;
+        }
+        RecordHeader *wrap_header = header_at(write_position);
+        wrap_header->wrap = true;
+        wrap_header->length = 0;
+        write_position += bytes_to_end;
+        publish(wrap_header, write_position);
+    }
+
+    // The record plus the header of the following record must be free
+    if (!has_free_bytes(write_position, block_sz + CACHE_LINE_BYTES))
+    {
+        return KoiQueueRet::QUEUE_FULL;
+    }
+    RecordHeader *header = header_at(write_position);
+    std::copy(message.begin(), message.end(), reinterpret_cast<std::byte *>(header) + sizeof(RecordHeader));
+    header->wrap = false;
+    header->length = static_cast<uint32_t>(message.size());
+    publish(header, write_position + block_sz);
+    return KoiQueueRet::OK;
+}
+
+RecordHeader *KoiVarQueue::next_record(size_t &read_position)
+{
+    RecordHeader *header = header_at(read_position);
+    if (!header->occupied.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+    if (header->wrap) [[unlikely]]
+    {
+        // Skip to the start of the ring buffer. At most one wrap record precedes a record since any record
+        // fits in the ring buffer from offset 0.
+        const size_t user_shm_size = shm_metadata_.user_shm_size;
+        read_position += user_shm_size - (read_position & (user_shm_size - 1));
+        advance_read_position(read_position);
+        header = header_at(read_position);
+        if (!header->occupied.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+    }
+    return header;
+}
+
+std::optional<size_t> KoiVarQueue::recv(std::span<std::byte> buffer)
+{
+    size_t read_position = read_position_;
+    RecordHeader *header = next_record(read_position);
+    if (header == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    const size_t length = header->length;
+    if (buffer.size() < length)
+    {
+        throw std::length_error("Buffer size " + std::to_string(buffer.size()) +
+                                " is smaller than the message size " + std::to_string(length));
+    }
+    const std::byte *message_ptr = reinterpret_cast<const std::byte *>(header) + sizeof(RecordHeader);
+    std::copy(message_ptr, message_ptr + length, buffer.begin());
+
+    advance_read_position(read_position + record_block_sz(length));
+    return length;
+}
+
+std::optional<std::span<const std::byte>> KoiVarQueue::peek()
+{
+    size_t read_position = read_position_;
+    RecordHeader *header = next_record(read_position);
+    if (header == nullptr)
+    {
+        return std::nullopt;
+    }
+    const std::byte *message_ptr = reinterpret_cast<const std::byte *>(header) + sizeof(RecordHeader);
+    return std::span<const std::byte>(message_ptr, header->length);
+}
+
+void KoiVarQueue::release()
+{
+    // `peek` has already skipped any wrap record, so the read position is at the peeked record
+    const size_t length = header_at(read_position_)->length;
+    advance_read_position(read_position_ + record_block_sz(length));
+}
+
+void KoiVarQueue::advance_read_position(size_t read_position)
+{
+    read_position_ = read_position;
+    // Unlike `KoiQueue`, the shared read position is how the sender finds free space, not only introspection.
+    // `memory_order_release` so the message is read before the sender can overwrite the record
+    control_block_->read.position.store(read_position, std::memory_order_release);
+}
+
+size_t KoiVarQueue::user_shm_size() const
+{
+    return shm_metadata_.user_shm_size;
+}
+
+size_t KoiVarQueue::curr_queue_sz_bytes() const
+{
+    return control_block_->write.position.load(std::memory_order_relaxed) -
+           control_block_->read.position.load(std::memory_order_relaxed);
+}
+
+bool KoiVarQueue::is_empty() const
+{
+    const RecordHeader *header = header_at(control_block_->read.position.load(std::memory_order_relaxed));
+    if (!header->occupied)
+    {
+        return true;
+    }
+    if (header->wrap)
+    {
+        // A wrap record is not a message, the queue is empty unless a record follows it at the start of the ring buffer
+        return !reinterpret_cast<const RecordHeader *>(shm_metadata_.user_shm_start)->occupied;
+    }
+    return false;
+}
+
+size_t KoiVarQueue::max_message_sz() const
+{
+    // A record block plus the header of the following record must fit in the ring buffer
+    return std::min<size_t>(shm_metadata_.user_shm_size - CACHE_LINE_BYTES - sizeof(RecordHeader),
+                            std::numeric_limits<uint32_t>::max());
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "koi_shm.hh"
+#include "koi_utils.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+// `RecordHeader` precedes each record and always starts on a cache line
+struct RecordHeader
+{
+    // Indicates if the record has been written to
+    std::atomic<bool> occupied;
+    // Marks a wrap record, which pads out the end of the ring buffer when the next record does not fit.
+    // The receiver skips from a wrap record to the start of the ring buffer.
+    bool wrap;
+    // Number of message bytes following the header
+    uint32_t length;
+};
+
+// Contains read/write metadata on one cacheline
+struct VarControlBlockInner
+{
+    // Either read or write position. Positions are byte counts which only increase,
+    // the offset into the ring buffer is the position modulo `user_shm_size`.
+    std::atomic<size_t> position;
+    // Duplicate the read only fields for the read/write cache line for prefetching.
+    size_t user_shm_size;
+    // `CACHE_LINE_BYTES` of the creating process, see `ControlBlockInner::cache_line_bytes`
+    size_t cache_line_bytes;
+};
+
+// Shared information among all processes encoded in the shared memory
+struct VarControlBlock
+{
+    // The below are aligned to the nearest cache line to avoid false sharing
+    // "tail"
+    alignas(CACHE_LINE_BYTES) VarControlBlockInner write;
+    // "head"
+    alignas(CACHE_LINE_BYTES) VarControlBlockInner read;
+};
+
+// Forward declaration of KoiVarQueueRAII
+class KoiVarQueueRAII;
+
+// A variable length message queue. Each record is a `RecordHeader` followed by the message bytes,
+// padded to the next cache line so records are packed at cache line granularity.
+//
+// Terminology: "record block" = "record header" + "message", rounded up to a multiple of `CACHE_LINE_BYTES`
+//
+// The receiver detects new records with the `occupied` flag in the record header, like `KoiQueue`.
+// Since records vary in size, the sender cannot use the flags to find free space, so it checks the
+// receiver's position instead, refreshing a process local copy only when the cached free space runs out.
+class KoiVarQueue
+{
+public:
+    // Returns total size of the shm segment that the user allocated
+    size_t user_shm_size() const;
+    // Returns the current queue size in bytes, including record headers and padding
+    size_t curr_queue_sz_bytes() const;
+    // Returns if the queue is empty
+    bool is_empty() const;
+    // Returns the largest message in bytes which can be sent
+    size_t max_message_sz() const;
+    // Returns the size of the record block holding a message of `message_sz` bytes
+    static constexpr size_t record_block_sz(size_t message_sz)
+    {
+        return (sizeof(RecordHeader) + message_sz + CACHE_LINE_BYTES - 1) & ~(CACHE_LINE_BYTES - 1);
+    }
+
+protected:
+    // `user_shm_size` is the size of the ring buffer in bytes, and must be a power of 2 and at least
+    // two cache lines
+    explicit KoiVarQueue(const std::string name, size_t user_shm_size);
+    virtual ~KoiVarQueue();
+
+    // Returns `KoiQueueRet::QUEUE_FULL` if the queue does not have space for the message, otherwise
+    // `KoiQueueRet::OK`. Throws `std::invalid_argument` if the message is larger than `max_message_sz()`
+    KoiQueueRet send(std::span<const std::byte> message);
+    // Copies the next message into the front of `buffer` and returns its length, or `std::nullopt` if the
+    // queue is empty. Throws `std::length_error` if `buffer` is smaller than the message, leaving it queued
+    std::optional<size_t> recv(std::span<std::byte> buffer);
+
+    // Zero-copy receive. Returns a view of the next message, or `std::nullopt` if the queue is empty.
+    // The view stays valid until `release` hands the record back to the sender.
+    std::optional<std::span<const std::byte>> peek();
+    // Releases the record returned by the last successful `peek`. Must not be called otherwise.
+    void release();
+
+    // Exception safety. Marked as `noexcept` such that an exception is not thrown during stack unwinding which leads to terminate.
+    void cleanup_shm() noexcept;
+
+private:
+    VarControlBlock *control_block_;
+
+    struct ShmMetadata : ShmSegment
+    {
+        // `shm_ptr` + sizeof(VarControlBlock) (aligned to the nearest cache line)
+        // Start of the ring buffer
+        char *user_shm_start;
+        size_t user_shm_size;
+    };
+
+    ShmMetadata shm_metadata_;
+
+    // Process local copies of the write and read positions, see `KoiQueue::write_offset_`
+    size_t write_position_ = 0;
+    size_t read_position_ = 0;
+    // Process local copy of the receiver's position, only refreshed from the control block when the
+    // free space it implies is insufficient. Only used by the sender.
+    size_t cached_read_position_ = 0;
+
+    RecordHeader *header_at(size_t position) const;
+    // Returns true if `bytes` from the write position are free, refreshing `cached_read_position_` if needed
+    bool has_free_bytes(size_t write_position, size_t bytes);
+    // Publishes the record at `header`, whose block ends at `next_write_position`
+    void publish(RecordHeader *header, size_t next_write_position);
+    // Returns the header of the next record at or after `read_position`, skipping a wrap record if present.
+    // `read_position` is advanced past the wrap record. Returns `nullptr` if there is no record.
+    RecordHeader *next_record(size_t &read_position);
+    // Sets the read position and publishes it to the sender
+    void advance_read_position(size_t read_position);
+
+    // Allow `KoiVarQueueRAII` to access private and protected members, particularly `cleanup_shm`
+    friend class KoiVarQueueRAII;
+};
+
+// RAII class to optionally cleanup the shared memory segment, typically used for test cleanup
+class KoiVarQueueRAII : public KoiVarQueue
+{
+public:
+    explicit KoiVarQueueRAII(const std::string name, size_t user_shm_size) : KoiVarQueue(name, user_shm_size)
+    {
+    }
+
+    ~KoiVarQueueRAII()
+    {
+        // `cleanup_shm` is not called in the default `KoiVarQueue` destructor
+        cleanup_shm();
+    }
+
+    using KoiVarQueue::peek;
+    using KoiVarQueue::recv;
+    using KoiVarQueue::release;
+    using KoiVarQueue::send;
+
+private:
+    using KoiVarQueue::cleanup_shm;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "koi_var_queue.hh"
+
+namespace koi
+{
+    // An IPC receiver of variable length messages
+    class KoiVarReceiver : public KoiVarQueue
+    {
+    public:
+        KoiVarReceiver(const std::string name, size_t buffer_bytes) : KoiVarQueue(name, buffer_bytes)
+        {
+        }
+
+        using KoiVarQueue::recv;
+        using KoiVarQueue::peek;
+        using KoiVarQueue::release;
+    };
+} // namespace koi
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "koi_var_queue.hh"
+
+namespace koi
+{
+    // An IPC sender of variable length messages
+    class KoiVarSender : public KoiVarQueue
+    {
+    public:
+        KoiVarSender(const std::string name, size_t buffer_bytes) : KoiVarQueue(name, buffer_bytes)
+        {
+        }
+
+        using KoiVarQueue::send;
+        // Currently only the sender is allowed to clean up the shared memory segment
+        // since there is only one sender
+        using KoiVarQueue::cleanup_shm;
+    };
+} // namespace koi
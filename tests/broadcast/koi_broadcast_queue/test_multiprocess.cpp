@@ -0,0 +1,188 @@
+#include "koi_broadcast_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <algorithm>
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace koi;
+
+TEST_CASE("Broadcast Send Recv Polling", "[KoiBroadcastQueue][MultiProcess]")
+{
+    // Several reader processes poll the queue while the writer sends, retrying while the slowest reader is a ring
+    // behind. Every reader must receive every message in order.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_readers = 4;
+    constexpr uint32_t num_msgs = 20000;
+    // Each message should certainly be received within 500ms
+    constexpr std::chrono::milliseconds timeout_duration(500);
+
+    // Create the queue before forking so all processes attach to the same segment
+    KoiBroadcastSender<uint32_t> sender(shm_name, SHM_SIZE);
+    std::vector<pid_t> reader_pids;
+    for (uint32_t reader = 0; reader < num_readers; ++reader)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is a reader. The receiver is scoped so its destructor detaches it before `exit`
+            bool received_all = true;
+            {
+                KoiBroadcastReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+                for (uint32_t i = 0; i < num_msgs && received_all; ++i)
+                {
+                    auto start_time = std::chrono::steady_clock::now();
+                    std::optional<uint32_t> message;
+                    while (!(message = receiver.recv()).has_value() &&
+                           std::chrono::steady_clock::now() - start_time <= timeout_duration)
+                    {
+                    }
+                    received_all = message == i;
+                }
+                received_all = received_all && receiver.is_empty();
+            }
+            exit(received_all ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        reader_pids.push_back(pid);
+    }
+
+    // Readers receive the messages sent after they attach, so wait for all of them
+    auto start_time = std::chrono::steady_clock::now();
+    while (sender.num_readers() != num_readers)
+    {
+        if (std::chrono::steady_clock::now() - start_time > std::chrono::seconds(5))
+        {
+            FAIL("Timed out waiting for the readers to attach");
+        }
+    }
+
+    // Parent process is the writer
+    for (uint32_t i = 0; i < num_msgs; ++i)
+    {
+        while (sender.send(i) != KoiQueueRet::OK)
+        {
+        }
+    }
+
+    for (pid_t pid : reader_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    REQUIRE(sender.num_readers() == 0);
+    sender.cleanup_shm();
+}
+
+// Every word holds the message's position, so a message overwritten while it was copied shows up as torn
+struct PositionMessage
+{
+    uint64_t words[8];
+};
+
+TEST_CASE("Broadcast Attach While The Writer Is Far Ahead", "[KoiBroadcastQueue][MultiProcess]")
+{
+    // Reader processes attach at staggered times while the writer keeps sending into a small ring, so a reader may
+    // be lapped before the writer has seen its cursor. A reader must never return a torn message, and must receive
+    // increasing positions, skipping only the messages it counts as lost.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_readers = 4;
+    constexpr uint64_t num_msgs = 2000;
+    constexpr std::chrono::milliseconds timeout_duration(500);
+    const size_t buffer_bytes = 4 * KoiBroadcastQueue<PositionMessage>::message_block_sz_bytes();
+
+    KoiBroadcastSender<PositionMessage> sender(shm_name, buffer_bytes);
+    std::vector<pid_t> reader_pids;
+    for (uint32_t reader = 0; reader < num_readers; ++reader)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Let the writer get ahead before attaching
+            usleep(1000 * (reader + 1));
+            bool received_all = true;
+            {
+                KoiBroadcastReceiver<PositionMessage> receiver(shm_name, buffer_bytes);
+                std::optional<uint64_t> last_position;
+                uint64_t last_lost = 0;
+                for (uint64_t i = 0; i < num_msgs && received_all; ++i)
+                {
+                    auto start_time = std::chrono::steady_clock::now();
+                    std::optional<PositionMessage> message;
+                    while (!(message = receiver.recv()).has_value() &&
+                           std::chrono::steady_clock::now() - start_time <= timeout_duration)
+                    {
+                    }
+                    if (!message.has_value())
+                    {
+                        received_all = false;
+                        break;
+                    }
+                    const uint64_t position = message->words[0];
+                    for (uint64_t word : message->words)
+                    {
+                        received_all = received_all && word == position;
+                    }
+                    const uint64_t lost = receiver.lost_messages();
+                    if (last_position.has_value())
+                    {
+                        received_all = received_all && position == *last_position + 1 + (lost - last_lost);
+                    }
+                    last_position = position;
+                    last_lost = lost;
+                }
+            }
+            exit(received_all ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        reader_pids.push_back(pid);
+    }
+
+    // Parent process is the writer, sending until every reader has exited
+    size_t running = reader_pids.size();
+    std::vector<int> statuses;
+    uint64_t position = 0;
+    while (running > 0)
+    {
+        PositionMessage message;
+        std::fill(std::begin(message.words), std::end(message.words), position);
+        if (sender.send(message) == KoiQueueRet::OK)
+        {
+            ++position;
+        }
+        if (position % 1024 == 0)
+        {
+            int status = 0;
+            while (running > 0 && waitpid(-1, &status, WNOHANG) > 0)
+            {
+                statuses.push_back(status);
+                --running;
+            }
+        }
+    }
+
+    for (int status : statuses)
+    {
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    REQUIRE(sender.num_readers() == 0);
+    sender.cleanup_shm();
+}
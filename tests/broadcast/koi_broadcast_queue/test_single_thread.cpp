@@ -0,0 +1,197 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_broadcast_queue.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+TEST_CASE("KoiBroadcastQueue Send Recv", "[KoiBroadcastQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Every Reader Receives Every Message")
+    {
+        KoiBroadcastQueueRAII<uint64_t> writer(shm_name, SHM_SIZE);
+        KoiBroadcastQueueRAII<uint64_t> first(shm_name, SHM_SIZE);
+        KoiBroadcastQueueRAII<uint64_t> second(shm_name, SHM_SIZE);
+        first.attach_reader();
+        second.attach_reader();
+        REQUIRE(writer.num_readers() == 2);
+        REQUIRE(first.is_empty());
+        REQUIRE_FALSE(first.recv().has_value());
+
+        for (uint64_t i = 0; i < 10; ++i)
+        {
+            REQUIRE(writer.send(i) == KoiQueueRet::OK);
+        }
+        for (uint64_t i = 0; i < 10; ++i)
+        {
+            REQUIRE(first.recv() == i);
+        }
+        REQUIRE(first.is_empty());
+        for (uint64_t i = 0; i < 10; ++i)
+        {
+            REQUIRE(second.recv() == i);
+        }
+        REQUIRE_FALSE(second.recv().has_value());
+    }
+
+    SECTION("Gated On The Slowest Reader")
+    {
+        KoiBroadcastQueueRAII<uint32_t> writer(shm_name, 4 * KoiBroadcastQueue<uint32_t>::message_block_sz_bytes());
+        KoiBroadcastQueueRAII<uint32_t> fast(shm_name, writer.user_shm_size());
+        KoiBroadcastQueueRAII<uint32_t> slow(shm_name, writer.user_shm_size());
+        fast.attach_reader();
+        slow.attach_reader();
+        REQUIRE(writer.capacity() == 4);
+        uint32_t sent = 0;
+        while (writer.send(sent) == KoiQueueRet::OK)
+        {
+            ++sent;
+            while (fast.recv().has_value())
+            {
+            }
+        }
+        // The fast reader keeps up, but the slow one has not read anything
+        REQUIRE(sent == writer.capacity());
+        REQUIRE(slow.recv() == 0);
+        REQUIRE(writer.send(sent++) == KoiQueueRet::OK);
+        REQUIRE(writer.send(sent) == KoiQueueRet::QUEUE_FULL);
+
+        // Once the slow reader detaches, only the fast reader holds the writer back
+        slow.detach_reader();
+        REQUIRE(writer.num_readers() == 1);
+        REQUIRE(fast.recv() == 4);
+        REQUIRE(writer.send(sent++) == KoiQueueRet::OK);
+        REQUIRE(fast.recv() == 5);
+        REQUIRE(fast.lost_messages() == 0);
+    }
+
+    SECTION("No Readers")
+    {
+        // Without attached readers the writer is never gated
+        KoiBroadcastQueueRAII<uint32_t> writer(shm_name, 2 * KoiBroadcastQueue<uint32_t>::message_block_sz_bytes());
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            REQUIRE(writer.send(i) == KoiQueueRet::OK);
+        }
+    }
+
+    SECTION("Late Attach")
+    {
+        KoiBroadcastQueueRAII<uint32_t> writer(shm_name, SHM_SIZE);
+        KoiBroadcastQueueRAII<uint32_t> early(shm_name, SHM_SIZE);
+        early.attach_reader();
+        REQUIRE(writer.send(1) == KoiQueueRet::OK);
+        REQUIRE(writer.send(2) == KoiQueueRet::OK);
+
+        // A reader attaching later starts from the next message
+        KoiBroadcastQueueRAII<uint32_t> late(shm_name, SHM_SIZE);
+        late.attach_reader();
+        REQUIRE(late.is_empty());
+        REQUIRE(writer.send(3) == KoiQueueRet::OK);
+        REQUIRE(late.recv() == 3);
+        REQUIRE_FALSE(late.recv().has_value());
+        REQUIRE(early.recv() == 1);
+        REQUIRE(early.recv() == 2);
+        REQUIRE(early.recv() == 3);
+    }
+
+    SECTION("Attach While The Writer Is Far Ahead")
+    {
+        const size_t buffer_bytes = 4 * KoiBroadcastQueue<uint32_t>::message_block_sz_bytes();
+        KoiBroadcastQueueRAII<uint32_t> writer(shm_name, buffer_bytes);
+        // Without readers the writer laps the ring several times, and stops mid lap
+        uint32_t sent = 0;
+        for (; sent < 10 * writer.capacity() + 1; ++sent)
+        {
+            REQUIRE(writer.send(sent) == KoiQueueRet::OK);
+        }
+
+        // The new reader holds the writer back from the next scan of the cursors on
+        KoiBroadcastQueueRAII<uint32_t> reader(shm_name, buffer_bytes);
+        reader.attach_reader();
+        const uint32_t first = sent;
+        while (writer.send(sent) == KoiQueueRet::OK)
+        {
+            ++sent;
+        }
+        REQUIRE(sent - first == writer.capacity());
+        for (uint32_t i = first; i < sent; ++i)
+        {
+            REQUIRE(reader.recv() == i);
+        }
+        REQUIRE_FALSE(reader.recv().has_value());
+        REQUIRE(reader.lost_messages() == 0);
+    }
+
+    SECTION("Lossy Reader Is Lapped")
+    {
+        const size_t buffer_bytes = 4 * KoiBroadcastQueue<uint32_t>::message_block_sz_bytes();
+        KoiBroadcastQueueRAII<uint32_t> writer(shm_name, buffer_bytes, BroadcastMode::LOSSY);
+        KoiBroadcastQueueRAII<uint32_t> reader(shm_name, buffer_bytes, BroadcastMode::LOSSY);
+        reader.attach_reader();
+        REQUIRE(reader.mode() == BroadcastMode::LOSSY);
+        // The writer never waits for the reader
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            REQUIRE(writer.send(i) == KoiQueueRet::OK);
+        }
+        // Messages 0 to 5 were overwritten. The reader also skips 6, which the writer's next send overwrites
+        REQUIRE(reader.recv() == 7);
+        REQUIRE(reader.lost_messages() == 7);
+        REQUIRE(reader.recv() == 8);
+        REQUIRE(reader.recv() == 9);
+        REQUIRE_FALSE(reader.recv().has_value());
+
+        // A reader which keeps up loses nothing
+        REQUIRE(writer.send(10) == KoiQueueRet::OK);
+        REQUIRE(reader.recv() == 10);
+        REQUIRE(reader.lost_messages() == 7);
+    }
+}
+
+TEST_CASE("KoiBroadcastQueue Metadata", "[KoiBroadcastQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Reader Cursors")
+    {
+        // Cursors are padded to a cache line, so readers do not false share
+        STATIC_REQUIRE(sizeof(ReaderCursor) == CACHE_LINE_BYTES);
+        KoiBroadcastQueueRAII<char> writer(shm_name, SHM_SIZE);
+        std::vector<std::unique_ptr<KoiBroadcastQueueRAII<char>>> readers;
+        for (size_t i = 0; i < MAX_BROADCAST_READERS; ++i)
+        {
+            readers.push_back(std::make_unique<KoiBroadcastQueueRAII<char>>(shm_name, SHM_SIZE));
+            readers.back()->attach_reader();
+        }
+        REQUIRE(writer.num_readers() == MAX_BROADCAST_READERS);
+        KoiBroadcastQueueRAII<char> extra(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(extra.attach_reader(), std::runtime_error);
+
+        // A detached cursor is reused
+        readers[3]->detach_reader();
+        REQUIRE(writer.num_readers() == MAX_BROADCAST_READERS - 1);
+        extra.attach_reader();
+        REQUIRE(writer.num_readers() == MAX_BROADCAST_READERS);
+    }
+
+    SECTION("Buffer Size")
+    {
+        // Rounded down to whole blocks
+        KoiBroadcastQueueRAII<char> queue(shm_name, 3 * CACHE_LINE_BYTES + 1);
+        REQUIRE(queue.user_shm_size() == 3 * CACHE_LINE_BYTES);
+        REQUIRE(queue.capacity() == 3);
+        REQUIRE_THROWS_AS(KoiBroadcastQueueRAII<char>(generate_unique_shm_name(), CACHE_LINE_BYTES - 1), std::invalid_argument);
+    }
+
+    SECTION("Mismatched Attach")
+    {
+        KoiBroadcastQueueRAII<char> queue(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(KoiBroadcastQueueRAII<char>(shm_name, SHM_SIZE / 2), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiBroadcastQueueRAII<char>(shm_name, SHM_SIZE, BroadcastMode::LOSSY), std::runtime_error);
+    }
+}
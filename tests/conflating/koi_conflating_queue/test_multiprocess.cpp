@@ -0,0 +1,89 @@
+#include "koi_conflating_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <sys/wait.h>
+#include <vector>
+
+using namespace koi;
+
+// Spans several cache lines, so a torn read would mix the fields of different updates
+struct Update
+{
+    uint64_t version;
+    uint64_t payload[15];
+};
+
+TEST_CASE("Conflating Send Recv Polling", "[KoiConflatingQueue][MultiProcess]")
+{
+    // The sender process updates the keys round robin while the receiver polls. For each key the receiver must see
+    // untorn values with increasing versions, and once the sender is done, the last version of every key.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_keys = 64;
+    constexpr uint64_t num_rounds = 5000;
+
+    KoiConflatingReceiver<Update> receiver(shm_name, num_keys);
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+        // Child process is the sender
+        KoiConflatingSender<Update> sender(shm_name, num_keys);
+        for (uint64_t version = 1; version <= num_rounds; ++version)
+        {
+            for (uint32_t key = 0; key < num_keys; ++key)
+            {
+                Update update{.version = version};
+                std::fill(std::begin(update.payload), std::end(update.payload), version * num_keys + key);
+                sender.send(key, update);
+            }
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    // Parent process is the receiver
+    std::vector<uint64_t> last_version(num_keys, 0);
+    uint64_t received = 0;
+    auto check = [&](const KeyedValue<Update> &update)
+    {
+        REQUIRE(update.key < num_keys);
+        for (uint64_t value : update.value.payload)
+        {
+            REQUIRE(value == update.value.version * num_keys + update.key);
+        }
+        REQUIRE(update.value.version > last_version[update.key]);
+        last_version[update.key] = update.value.version;
+        ++received;
+    };
+    int status = 0;
+    pid_t waited = 0;
+    while ((waited = waitpid(pid, &status, WNOHANG)) == 0)
+    {
+        if (std::optional<KeyedValue<Update>> update = receiver.recv())
+        {
+            check(update.value());
+        }
+    }
+    REQUIRE(waited == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    // Drain the keys still pending after the sender exited
+    while (std::optional<KeyedValue<Update>> update = receiver.recv())
+    {
+        check(update.value());
+    }
+    for (uint32_t key = 0; key < num_keys; ++key)
+    {
+        REQUIRE(last_version[key] == num_rounds);
+    }
+    // Updates were coalesced, unless the receiver kept up with every one
+    REQUIRE(received <= num_keys * num_rounds);
+    KoiConflatingSender<Update>(shm_name, num_keys).cleanup_shm();
+}
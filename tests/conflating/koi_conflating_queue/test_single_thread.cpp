@@ -0,0 +1,145 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_conflating_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+
+struct Quote
+{
+    double bid;
+    double ask;
+};
+
+TEST_CASE("KoiConflatingQueue Send Recv", "[KoiConflatingQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Send Recv Single")
+    {
+        KoiConflatingQueueRAII<uint64_t> queue(shm_name, 16);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+
+        REQUIRE(queue.send(3, 42) == KoiQueueRet::OK);
+        REQUIRE(queue.size() == 1);
+        std::optional<KeyedValue<uint64_t>> update = queue.recv();
+        REQUIRE(update.has_value());
+        REQUIRE(update->key == 3);
+        REQUIRE(update->value == 42);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+    }
+
+    SECTION("Coalesces Pending Keys")
+    {
+        KoiConflatingQueueRAII<Quote> queue(shm_name, 5000);
+        // Keys are received in the order they first became pending, each with its latest value
+        for (int round = 0; round < 10; ++round)
+        {
+            REQUIRE(queue.send(7, Quote{100.0 + round, 101.0 + round}) == KoiQueueRet::OK);
+            REQUIRE(queue.send(4999, Quote{1.0 * round, 2.0 * round}) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.send(0, Quote{5.0, 6.0}) == KoiQueueRet::OK);
+        REQUIRE(queue.size() == 3);
+
+        std::optional<KeyedValue<Quote>> update = queue.recv();
+        REQUIRE(update->key == 7);
+        REQUIRE(update->value.bid == 109.0);
+        REQUIRE(update->value.ask == 110.0);
+        update = queue.recv();
+        REQUIRE(update->key == 4999);
+        REQUIRE(update->value.bid == 9.0);
+        update = queue.recv();
+        REQUIRE(update->key == 0);
+        REQUIRE(update->value.ask == 6.0);
+        REQUIRE_FALSE(queue.recv().has_value());
+
+        // A key taken by the receiver becomes pending again on its next update
+        REQUIRE(queue.send(7, Quote{1.0, 2.0}) == KoiQueueRet::OK);
+        update = queue.recv();
+        REQUIRE(update->key == 7);
+        REQUIRE(update->value.bid == 1.0);
+    }
+
+    SECTION("Every Key Pending")
+    {
+        // The pending ring never overflows, however the updates interleave with the receives
+        constexpr uint32_t num_keys = 4;
+        KoiConflatingQueueRAII<uint32_t> queue(shm_name, num_keys);
+        for (uint32_t lap = 0; lap < 10; ++lap)
+        {
+            for (uint32_t key = 0; key < num_keys; ++key)
+            {
+                REQUIRE(queue.send(key, lap) == KoiQueueRet::OK);
+                REQUIRE(queue.send(key, lap + 1) == KoiQueueRet::OK);
+            }
+            REQUIRE(queue.size() == num_keys);
+            for (uint32_t key = 0; key < num_keys; ++key)
+            {
+                std::optional<KeyedValue<uint32_t>> update = queue.recv();
+                REQUIRE(update->key == key);
+                REQUIRE(update->value == lap + 1);
+            }
+        }
+        REQUIRE(queue.is_empty());
+    }
+
+    SECTION("Attach Mid Lap")
+    {
+        // Three keys make a power of 2 ring. A side which attaches picks up its entry from the control block
+        KoiConflatingQueueRAII<uint32_t> sender(shm_name, 3);
+        uint32_t sent = 0;
+        {
+            // Not RAII, so dropping it leaves the segment in place
+            koi::KoiConflatingReceiver<uint32_t> receiver(shm_name, 3);
+            for (; sent < 6; ++sent)
+            {
+                REQUIRE(sender.send(sent % 3, sent) == KoiQueueRet::OK);
+                REQUIRE(receiver.recv()->value == sent);
+            }
+        }
+        REQUIRE(sender.send(sent % 3, sent) == KoiQueueRet::OK);
+        ++sent;
+        KoiConflatingQueueRAII<uint32_t> receiver(shm_name, 3);
+        uint32_t received = sent - 1;
+        for (; sent < 20; ++sent)
+        {
+            REQUIRE(sender.send(sent % 3, sent) == KoiQueueRet::OK);
+            std::optional<KeyedValue<uint32_t>> update = receiver.recv();
+            REQUIRE(update->key == received % 3);
+            REQUIRE(update->value == received++);
+        }
+        REQUIRE(receiver.recv()->value == received++);
+        REQUIRE(received == sent);
+        REQUIRE(receiver.is_empty());
+    }
+
+    SECTION("Key Out Of Range")
+    {
+        KoiConflatingQueueRAII<uint32_t> queue(shm_name, 4);
+        REQUIRE_THROWS_AS(queue.send(4, 1), std::out_of_range);
+        REQUIRE(queue.is_empty());
+    }
+}
+
+TEST_CASE("KoiConflatingQueue Metadata", "[KoiConflatingQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Key Slot Size")
+    {
+        // The slot header and the value are rounded up to the nearest cache line
+        STATIC_REQUIRE(KoiConflatingQueue<char>::key_slot_sz_bytes() == CACHE_LINE_BYTES);
+        REQUIRE_THROWS_AS(KoiConflatingQueueRAII<char>(generate_unique_shm_name(), 0), std::invalid_argument);
+    }
+
+    SECTION("Mismatched Attach")
+    {
+        KoiConflatingQueueRAII<char> queue(shm_name, 16);
+        REQUIRE(queue.num_keys() == 16);
+        REQUIRE_THROWS_AS(KoiConflatingQueueRAII<char>(shm_name, 8), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiConflatingQueueRAII<Quote[8]>(shm_name, 16), std::runtime_error);
+    }
+}
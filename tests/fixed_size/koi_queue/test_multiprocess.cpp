@@ -6,6 +6,7 @@
 
 #include <catch2/catch_all.hpp>
 #include <chrono>
+#include <poll.h>
 #include <thread>
 
 using namespace koi;
@@ -283,4 +284,107 @@ TEST_CASE("Send Recv Two Full Queues", "[KoiQueue][MultiProcess]")
         perror("waitpid");
         exit(EXIT_FAILURE);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Blocking Send Recv Futex", "[KoiQueue][MultiProcess]")
+{
+    // The receiver parks in `recv_wait` before the sender starts, and the sender parks in `send_wait`
+    // when the small queue fills up, so both sides are woken through the futex
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr size_t shm_size = 8 * CACHE_LINE_BYTES;
+    constexpr unsigned int num_msgs = 1000;
+    const KoiQueueOptions options{.wait_strategy = WaitStrategy::FUTEX};
+
+    KoiReceiver<unsigned int> receiver(shm_name, shm_size, options);
+    pid_t sender_pid = spawn_process();
+    if (sender_pid == 0)
+    {
+        // Child process is sender. Give the receiver time to park
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        KoiSender<unsigned int> sender(shm_name, shm_size, options);
+        for (unsigned int i = 0; i < num_msgs; ++i)
+        {
+            if (sender.send_wait(i, std::chrono::seconds(10)) != KoiQueueRet::OK)
+            {
+                exit(EXIT_FAILURE);
+            }
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    // Parent process is receiver
+    for (unsigned int i = 0; i < num_msgs; ++i)
+    {
+        auto recv_msg = receiver.recv_wait(std::chrono::seconds(10));
+        REQUIRE(recv_msg.has_value());
+        REQUIRE(recv_msg.value() == i);
+        if (i % 100 == 0)
+        {
+            // Let the queue fill up so the sender parks
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    int status;
+    if (waitpid(sender_pid, &status, 0) == -1)
+    {
+        perror("waitpid");
+        exit(EXIT_FAILURE);
+    }
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+}
+
+TEST_CASE("Notify Fd Wakeup", "[KoiQueue][MultiProcess]")
+{
+    // The receiver blocks in `poll` on the notification descriptor instead of polling the queue
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr unsigned int num_bursts = 20;
+    constexpr unsigned int burst_size = 5;
+
+    KoiReceiver<unsigned int> receiver(shm_name, SHM_SIZE);
+    const int fd = receiver.notify_fd();
+    pid_t sender_pid = spawn_process();
+    if (sender_pid == 0)
+    {
+        // Child process is sender, sending bursts with idle gaps in between
+        KoiSender<unsigned int> sender(shm_name, SHM_SIZE);
+        for (unsigned int i = 0; i < num_bursts; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            for (unsigned int j = 0; j < burst_size; ++j)
+            {
+                while (!sender.send(i * burst_size + j))
+                {
+                }
+            }
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    // Parent process is receiver
+    unsigned int next = 0;
+    while (next < num_bursts * burst_size)
+    {
+        while (auto msg = receiver.recv())
+        {
+            REQUIRE(msg.value() == next++);
+        }
+        // Only block once the queue is empty and more messages are expected
+        if (next == num_bursts * burst_size || !receiver.arm_notify())
+        {
+            continue;
+        }
+        struct pollfd pfd = {fd, POLLIN, 0};
+        REQUIRE(poll(&pfd, 1, 10000) == 1);
+    }
+
+    int status;
+    if (waitpid(sender_pid, &status, 0) == -1)
+    {
+        perror("waitpid");
+        exit(EXIT_FAILURE);
+    }
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+}
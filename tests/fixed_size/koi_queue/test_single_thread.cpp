@@ -1,10 +1,14 @@
 #define CATCH_CONFIG_MAIN
+#include "koi_affinity.hh"
 #include "koi_queue.hh"
 #include "test_utils.hh"
 
 // No longer <catch2/catch.hpp> since v3
 // https://github.com/catchorg/Catch2/blob/devel/docs/migrate-v2-to-v3.md#how-to-migrate-projects-from-v2-to-v3
 #include <catch2/catch_all.hpp>
+#include <chrono>
+#include <limits>
+#include <poll.h>
 #include <sys/mman.h>
 #include <sys/stat.h> /* For mode constants */
 #include <fcntl.h>    /* For O_* constants */
@@ -49,14 +53,16 @@ TEST_CASE("KoiQueue Metadata", "[KoiQueue][SingleThread]")
     const std::string shm_name = generate_unique_shm_name();
     SECTION("Message Size")
     {
-        // The KoiQueue should add padding until each message is the next greatest power of two of the cache line size
-        // This way the total shm size is a multiple of the message size
+        // The KoiQueue should add padding until each message block is the next multiple of the cache line size
         struct Message
         {
             char data[CACHE_LINE_BYTES * 2 + 1];
         };
         KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
-        REQUIRE(queue.message_block_sz_bytes() == CACHE_LINE_BYTES * 4);
+        REQUIRE(queue.message_block_sz_bytes() == CACHE_LINE_BYTES * 3);
+        // The ring buffer is rounded down to a whole number of message blocks
+        REQUIRE(queue.capacity() == SHM_SIZE / (CACHE_LINE_BYTES * 3));
+        REQUIRE(queue.user_shm_size() == queue.capacity() * CACHE_LINE_BYTES * 3);
     }
 }
 
@@ -107,6 +113,808 @@ TEST_CASE("KoiQueue Send Recv", "[KoiQueue][SingleThread]")
     }
 }
 
+TEST_CASE("KoiQueue Batch Send Recv", "[KoiQueue][SingleThread][Batch]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    struct Message
+    {
+        int x;
+        int y;
+    };
+    const size_t capacity = SHM_SIZE / CACHE_LINE_BYTES;
+
+    SECTION("Send Batch Recv Batch")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        std::vector<Message> msgs;
+        for (int i = 0; i < 10; ++i)
+        {
+            msgs.push_back({i, -i});
+        }
+        REQUIRE(queue.send_batch(msgs) == msgs.size());
+        REQUIRE(queue.size() == msgs.size());
+
+        std::vector<Message> received(16);
+        REQUIRE(queue.recv_batch(received) == msgs.size());
+        for (size_t i = 0; i < msgs.size(); ++i)
+        {
+            REQUIRE(received[i].x == msgs[i].x);
+            REQUIRE(received[i].y == msgs[i].y);
+        }
+        REQUIRE(queue.size() == 0);
+        REQUIRE(queue.recv_batch(received) == 0);
+    }
+
+    SECTION("Send Batch Stops When Full")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        std::vector<Message> msgs(capacity + 5, Message{1, 2});
+        REQUIRE(queue.send_batch(msgs) == capacity);
+        REQUIRE(queue.is_full());
+        REQUIRE(queue.send_batch(msgs) == 0);
+
+        // Freeing a few slots lets exactly that many messages through
+        std::vector<Message> received(3);
+        REQUIRE(queue.recv_batch(received) == 3);
+        REQUIRE(queue.send_batch(msgs) == 3);
+        REQUIRE(queue.size() == capacity);
+    }
+
+    SECTION("Batches Wrap Around")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        // Batch sizes which do not divide the capacity force runs across the end of the ring buffer
+        constexpr size_t batch_size = 7;
+        std::vector<Message> msgs(batch_size);
+        std::vector<Message> received(batch_size);
+        int next_send = 0;
+        int next_recv = 0;
+        for (size_t it = 0; it < capacity; ++it)
+        {
+            for (auto &msg : msgs)
+            {
+                msg = {next_send, next_send};
+                next_send++;
+            }
+            REQUIRE(queue.send_batch(msgs) == batch_size);
+            REQUIRE(queue.recv_batch(received) == batch_size);
+            for (const auto &msg : received)
+            {
+                REQUIRE(msg.x == next_recv);
+                next_recv++;
+            }
+        }
+        REQUIRE(queue.size() == 0);
+    }
+
+    SECTION("Interleaves With Single Messages")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        std::vector<Message> msgs = {{0, 0}, {1, 1}, {2, 2}};
+        REQUIRE(queue.send_batch(msgs) == msgs.size());
+        REQUIRE(queue.send({3, 3}) == KoiQueueRet::OK);
+
+        auto recv_msg = queue.recv();
+        REQUIRE(recv_msg.has_value());
+        REQUIRE(recv_msg.value().x == 0);
+
+        std::vector<Message> received(8);
+        REQUIRE(queue.recv_batch(received) == 3);
+        REQUIRE(received[2].x == 3);
+    }
+
+    SECTION("Drain")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            queue.send({i, i});
+        }
+
+        int expected = 0;
+        auto check = [&expected](const Message &msg)
+        {
+            REQUIRE(msg.x == expected);
+            expected++;
+        };
+        REQUIRE(queue.drain(check, 4) == 4);
+        REQUIRE(queue.size() == 6);
+        REQUIRE(queue.drain(check, 100) == 6);
+        REQUIRE(queue.size() == 0);
+        REQUIRE(queue.drain(check, 100) == 0);
+        REQUIRE(expected == 10);
+    }
+}
+
+TEST_CASE("KoiQueue Reserve Commit", "[KoiQueue][SingleThread][ZeroCopy]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    struct Message
+    {
+        int x;
+        double y;
+    };
+    const size_t capacity = SHM_SIZE / CACHE_LINE_BYTES;
+
+    SECTION("Reserve Commit")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        Message *slot = queue.reserve();
+        REQUIRE(slot != nullptr);
+        // The slot is aligned for the message type
+        REQUIRE(reinterpret_cast<uintptr_t>(slot) % alignof(Message) == 0);
+        slot->x = 1;
+        slot->y = 2.5;
+        // Nothing is visible until the slot is committed
+        REQUIRE(queue.is_empty());
+        queue.commit();
+        REQUIRE(queue.size() == 1);
+
+        auto recv_msg = queue.recv();
+        REQUIRE(recv_msg.has_value());
+        REQUIRE(recv_msg.value().x == 1);
+        REQUIRE(recv_msg.value().y == 2.5);
+    }
+
+    SECTION("Emplace")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        REQUIRE(queue.emplace(3, 4.5) == KoiQueueRet::OK);
+        auto recv_msg = queue.recv();
+        REQUIRE(recv_msg.has_value());
+        REQUIRE(recv_msg.value().x == 3);
+        REQUIRE(recv_msg.value().y == 4.5);
+    }
+
+    SECTION("Reserve Full Queue")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            REQUIRE(queue.emplace(static_cast<int>(i), 0.0) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.reserve() == nullptr);
+        REQUIRE(queue.emplace(0, 0.0) == KoiQueueRet::QUEUE_FULL);
+
+        // Freeing a slot makes it available to `reserve` again, wrapping around the ring buffer
+        REQUIRE(queue.recv().value().x == 0);
+        Message *slot = queue.reserve();
+        REQUIRE(slot != nullptr);
+        slot->x = -1;
+        queue.commit();
+        for (size_t i = 1; i < capacity; ++i)
+        {
+            REQUIRE(queue.recv().value().x == static_cast<int>(i));
+        }
+        REQUIRE(queue.recv().value().x == -1);
+    }
+}
+
+TEST_CASE("KoiQueue Peek Release", "[KoiQueue][SingleThread][ZeroCopy]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    struct Message
+    {
+        int x;
+        double y;
+    };
+
+    SECTION("Peek Release")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        REQUIRE(queue.peek() == nullptr);
+        queue.send({1, 1.5});
+        queue.send({2, 2.5});
+
+        const Message *view = queue.peek();
+        REQUIRE(view != nullptr);
+        REQUIRE(reinterpret_cast<uintptr_t>(view) % alignof(Message) == 0);
+        REQUIRE(view->x == 1);
+        // Peeking does not consume the message
+        REQUIRE(queue.peek() == view);
+        REQUIRE(queue.size() == 2);
+
+        queue.release();
+        REQUIRE(queue.size() == 1);
+        view = queue.peek();
+        REQUIRE(view != nullptr);
+        REQUIRE(view->x == 2);
+        REQUIRE(view->y == 2.5);
+        queue.release();
+        REQUIRE(queue.peek() == nullptr);
+        REQUIRE(queue.is_empty());
+    }
+
+    SECTION("Recv Into")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        Message msg = {0, 0.0};
+        REQUIRE_FALSE(queue.recv_into(msg));
+        queue.send({3, 3.5});
+        REQUIRE(queue.recv_into(msg));
+        REQUIRE(msg.x == 3);
+        REQUIRE(msg.y == 3.5);
+        REQUIRE(queue.size() == 0);
+    }
+
+    SECTION("Peek Wraps Around")
+    {
+        KoiQueueRAII<Message> queue(shm_name, SHM_SIZE);
+
+        const int num_it = static_cast<int>(queue.capacity()) * 2 + 1;
+        for (int i = 0; i < num_it; ++i)
+        {
+            queue.send({i, 0.0});
+            const Message *view = queue.peek();
+            REQUIRE(view != nullptr);
+            REQUIRE(view->x == i);
+            queue.release();
+        }
+        REQUIRE(queue.size() == 0);
+    }
+}
+
+TEST_CASE("KoiQueue Separate Sender Receiver", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Size Visible To Both Sides")
+    {
+        // Each side keeps its own offset locally, so `size()` relies on the offsets written back to the control block
+        KoiQueueRAII<int> sender(shm_name, SHM_SIZE);
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE);
+
+        sender.send(1);
+        sender.send(2);
+        sender.send(3);
+        REQUIRE(sender.size() == 3);
+        REQUIRE(receiver.size() == 3);
+
+        REQUIRE(receiver.recv() == 1);
+        REQUIRE(sender.size() == 2);
+        REQUIRE(receiver.size() == 2);
+    }
+
+    SECTION("Attach Resumes From Offsets")
+    {
+        KoiQueueRAII<int> first_sender(shm_name, SHM_SIZE);
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE);
+        const int capacity = static_cast<int>(first_sender.capacity());
+
+        // Move both offsets past the start of the ring buffer
+        for (int i = 0; i < capacity - 1; ++i)
+        {
+            first_sender.send(i);
+            REQUIRE(receiver.recv() == i);
+        }
+        first_sender.send(-1);
+
+        // A later sender picks up the write offset from the control block and wraps around the ring buffer
+        KoiQueueRAII<int> second_sender(shm_name, SHM_SIZE);
+        REQUIRE(second_sender.size() == 1);
+        for (int i = 0; i < capacity - 1; ++i)
+        {
+            REQUIRE(second_sender.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(second_sender.send(capacity) == KoiQueueRet::QUEUE_FULL);
+
+        REQUIRE(receiver.recv() == -1);
+        for (int i = 0; i < capacity - 1; ++i)
+        {
+            REQUIRE(receiver.recv() == i);
+        }
+        REQUIRE(receiver.is_empty());
+        REQUIRE(second_sender.size() == 0);
+    }
+}
+
+TEST_CASE("KoiQueue Compile Time Capacity", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr size_t capacity = 64;
+    using StaticQueue = KoiQueueRAII<int, capacity>;
+    constexpr size_t shm_size = capacity * StaticQueue::message_block_sz_bytes();
+
+    SECTION("Send Recv Wraps Around")
+    {
+        StaticQueue queue(shm_name);
+        REQUIRE(queue.capacity() == capacity);
+        REQUIRE(queue.user_shm_size() == shm_size);
+
+        for (int i = 0; i < static_cast<int>(capacity) * 2 + 1; ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+            REQUIRE(queue.recv() == i);
+        }
+        for (int i = 0; i < static_cast<int>(capacity); ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.send(0) == KoiQueueRet::QUEUE_FULL);
+        REQUIRE(queue.size() == capacity);
+    }
+
+    SECTION("Interoperates With Runtime Capacity")
+    {
+        StaticQueue sender(shm_name);
+        KoiQueueRAII<int> receiver(shm_name, shm_size);
+        REQUIRE(receiver.capacity() == capacity);
+
+        for (int i = 0; i < static_cast<int>(capacity) * 2 + 1; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+            REQUIRE(receiver.recv() == i);
+        }
+    }
+
+    SECTION("Mismatched Capacity")
+    {
+        // The buffer size passed at runtime must match the compile time capacity
+        REQUIRE_THROWS_AS(StaticQueue(shm_name, shm_size * 2), std::invalid_argument);
+
+        // The compile time capacity must match the capacity of an existing queue
+        KoiQueueRAII<int> queue(shm_name, shm_size * 2);
+        REQUIRE_THROWS_AS(StaticQueue(shm_name), std::runtime_error);
+    }
+}
+
+TEST_CASE("KoiQueue Non Power Of 2 Capacity", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr size_t capacity = 100;
+
+    auto send_recv_wraps_around = [](auto &sender, auto &receiver)
+    {
+        for (int i = 0; i < static_cast<int>(capacity) * 2 + 1; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+            REQUIRE(receiver.recv() == i);
+        }
+        for (int i = 0; i < static_cast<int>(capacity); ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+            REQUIRE(receiver.size() == static_cast<size_t>(i) + 1);
+        }
+        REQUIRE(sender.send(0) == KoiQueueRet::QUEUE_FULL);
+        REQUIRE(receiver.is_full());
+        for (int i = 0; i < static_cast<int>(capacity); ++i)
+        {
+            REQUIRE(receiver.recv() == i);
+        }
+        REQUIRE(receiver.is_empty());
+    };
+
+    SECTION("Runtime Capacity")
+    {
+        KoiQueueRAII<int> queue(shm_name, QueueCapacity{capacity});
+        REQUIRE(queue.capacity() == capacity);
+        REQUIRE(queue.user_shm_size() == capacity * queue.message_block_sz_bytes());
+        send_recv_wraps_around(queue, queue);
+    }
+
+    SECTION("Compile Time Capacity")
+    {
+        KoiQueueRAII<int, capacity> sender(shm_name);
+        KoiQueueRAII<int> receiver(shm_name, QueueCapacity{capacity});
+        REQUIRE(sender.capacity() == capacity);
+        send_recv_wraps_around(sender, receiver);
+    }
+
+    SECTION("Power Of 2 Capacity With Non Power Of 2 Blocks")
+    {
+        // The ring buffer size is not a power of 2, so it must not wrap around with a mask
+        struct Message
+        {
+            int value;
+            char data[CACHE_LINE_BYTES * 2];
+        };
+        constexpr size_t pow_2_capacity = 64;
+        KoiQueueRAII<Message, pow_2_capacity> queue(shm_name);
+        REQUIRE(queue.message_block_sz_bytes() == CACHE_LINE_BYTES * 3);
+        for (int i = 0; i < static_cast<int>(pow_2_capacity) * 3; ++i)
+        {
+            REQUIRE(queue.send(Message{.value = i}) == KoiQueueRet::OK);
+            REQUIRE(queue.recv()->value == i);
+        }
+    }
+}
+
+TEST_CASE("KoiQueue Separate Headers", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    struct Message
+    {
+        int value;
+        char data[CACHE_LINE_BYTES - sizeof(int)];
+    };
+    constexpr size_t capacity = 100;
+    using SeparateQueue = KoiQueueRAII<Message, DYNAMIC_CAPACITY, SlotLayout::SEPARATE_HEADERS>;
+
+    SECTION("One Cache Line Per Message")
+    {
+        SeparateQueue queue(shm_name, QueueCapacity{capacity});
+        REQUIRE(queue.message_block_sz_bytes() == CACHE_LINE_BYTES);
+        REQUIRE(KoiQueueRAII<Message>::message_block_sz_bytes() == CACHE_LINE_BYTES * 2);
+        REQUIRE(queue.user_shm_size() == capacity * CACHE_LINE_BYTES);
+    }
+
+    SECTION("Send Recv Wraps Around")
+    {
+        SeparateQueue queue(shm_name, QueueCapacity{capacity});
+        for (int i = 0; i < static_cast<int>(capacity) * 2 + 1; ++i)
+        {
+            REQUIRE(queue.send(Message{.value = i}) == KoiQueueRet::OK);
+            const Message *message = queue.peek();
+            REQUIRE(message != nullptr);
+            REQUIRE(message->value == i);
+            queue.release();
+        }
+        for (int i = 0; i < static_cast<int>(capacity); ++i)
+        {
+            REQUIRE(queue.send(Message{.value = i}) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.send(Message{}) == KoiQueueRet::QUEUE_FULL);
+        REQUIRE(queue.is_full());
+        REQUIRE(queue.size() == capacity);
+
+        std::vector<Message> received(capacity);
+        REQUIRE(queue.recv_batch(std::span(received)) == capacity);
+        for (int i = 0; i < static_cast<int>(capacity); ++i)
+        {
+            REQUIRE(received[i].value == i);
+        }
+        REQUIRE(queue.is_empty());
+    }
+
+    SECTION("Layout Must Match On Attach")
+    {
+        SeparateQueue queue(shm_name, QueueCapacity{capacity});
+        REQUIRE_THROWS_AS(KoiQueueRAII<Message>(shm_name, QueueCapacity{capacity}), std::runtime_error);
+    }
+}
+
+TEST_CASE("KoiQueue Lookahead And Batched Release", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Send Recv Wraps Around")
+    {
+        KoiQueueRAII<int> sender(shm_name, SHM_SIZE, KoiQueueOptions{.send_lookahead = 8});
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE, KoiQueueOptions{.release_batch = 4});
+        const int capacity = static_cast<int>(sender.capacity());
+
+        int next_recv = 0;
+        for (int i = 0; i < capacity * 3; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+            // Receive in bursts so both sides wrap around at different points
+            if (i % 5 == 4)
+            {
+                std::optional<int> msg;
+                while ((msg = receiver.recv()).has_value())
+                {
+                    REQUIRE(msg.value() == next_recv++);
+                }
+            }
+        }
+        while (auto msg = receiver.recv())
+        {
+            REQUIRE(msg.value() == next_recv++);
+        }
+        REQUIRE(next_recv == capacity * 3);
+    }
+
+    SECTION("Releases Are Deferred")
+    {
+        KoiQueueRAII<int> sender(shm_name, SHM_SIZE, KoiQueueOptions{.send_lookahead = 8});
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE, KoiQueueOptions{.release_batch = 4});
+        const int capacity = static_cast<int>(sender.capacity());
+
+        for (int i = 0; i < capacity; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(sender.send(0) == KoiQueueRet::QUEUE_FULL);
+
+        // Consumed slots are not handed back to the sender until a group of 4 is pending
+        for (int i = 0; i < 3; ++i)
+        {
+            REQUIRE(receiver.recv() == i);
+            REQUIRE(sender.send(0) == KoiQueueRet::QUEUE_FULL);
+        }
+        // `size()` only counts unconsumed messages, while `is_full()` counts the unreleased slots
+        REQUIRE(sender.size() == static_cast<size_t>(capacity - 3));
+        REQUIRE(sender.is_full());
+        REQUIRE(receiver.recv() == 3);
+        for (int i = 0; i < 4; ++i)
+        {
+            REQUIRE(sender.send(capacity + i) == KoiQueueRet::OK);
+        }
+        REQUIRE(sender.send(0) == KoiQueueRet::QUEUE_FULL);
+
+        // An explicit flush releases the pending slots early
+        REQUIRE(receiver.recv() == 4);
+        receiver.flush_releases();
+        REQUIRE(sender.send(capacity + 4) == KoiQueueRet::OK);
+
+        for (int i = 5; i < capacity + 5; ++i)
+        {
+            REQUIRE(receiver.recv() == i);
+        }
+        // Finding the queue empty releases all pending slots
+        REQUIRE_FALSE(receiver.recv().has_value());
+        for (int i = 0; i < capacity; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+        }
+    }
+
+    SECTION("Release Batch Larger Than Capacity")
+    {
+        // The release batch is clamped so the receiver never wraps onto its own unreleased slots
+        KoiQueueRAII<int> sender(shm_name, SHM_SIZE, KoiQueueOptions{.send_lookahead = 1 << 20});
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE, KoiQueueOptions{.release_batch = 1 << 20});
+        const int capacity = static_cast<int>(sender.capacity());
+
+        for (int lap = 0; lap < 3; ++lap)
+        {
+            for (int i = 0; i < capacity; ++i)
+            {
+                REQUIRE(sender.send(i) == KoiQueueRet::OK);
+            }
+            REQUIRE(sender.send(0) == KoiQueueRet::QUEUE_FULL);
+            for (int i = 0; i < capacity; ++i)
+            {
+                REQUIRE(receiver.recv() == i);
+            }
+            REQUIRE_FALSE(receiver.recv().has_value());
+        }
+    }
+
+    SECTION("Batch Recv Flushes Pending Releases")
+    {
+        KoiQueueRAII<int> sender(shm_name, SHM_SIZE);
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE, KoiQueueOptions{.release_batch = 4});
+        const int capacity = static_cast<int>(sender.capacity());
+
+        for (int i = 0; i < capacity; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(receiver.recv() == 0);
+        std::vector<int> received(capacity);
+        REQUIRE(receiver.recv_batch(received) == static_cast<size_t>(capacity - 1));
+        REQUIRE(received[0] == 1);
+        REQUIRE(received[capacity - 2] == capacity - 1);
+        for (int i = 0; i < capacity; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+        }
+    }
+}
+
+TEST_CASE("KoiQueue Blocking Send Recv", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    const WaitStrategy strategy = GENERATE(WaitStrategy::BUSY_SPIN, WaitStrategy::BACKOFF,
+                                           WaitStrategy::YIELD, WaitStrategy::FUTEX);
+    KoiQueueRAII<int> queue(shm_name, SHM_SIZE, KoiQueueOptions{.wait_strategy = strategy});
+    constexpr auto timeout = std::chrono::milliseconds(5);
+
+    SECTION("Recv Wait Times Out")
+    {
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE_FALSE(queue.recv_wait(timeout).has_value());
+        REQUIRE(std::chrono::steady_clock::now() - start >= timeout);
+    }
+
+    SECTION("Send Wait Times Out")
+    {
+        for (size_t i = 0; i < queue.capacity(); ++i)
+        {
+            REQUIRE(queue.send_wait(static_cast<int>(i), timeout) == KoiQueueRet::OK);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE(queue.send_wait(0, timeout) == KoiQueueRet::QUEUE_FULL);
+        REQUIRE(std::chrono::steady_clock::now() - start >= timeout);
+    }
+
+    SECTION("Recv Wait Returns Queued Message")
+    {
+        REQUIRE(queue.send_wait(7) == KoiQueueRet::OK);
+        REQUIRE(queue.recv_wait() == 7);
+        REQUIRE(queue.is_empty());
+    }
+}
+
+TEST_CASE("KoiQueue Notify Fd", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    KoiQueueRAII<int> sender(shm_name, SHM_SIZE);
+    KoiQueueRAII<int> receiver(shm_name, SHM_SIZE);
+    const int fd = receiver.notify_fd();
+    REQUIRE(fd != -1);
+
+    auto is_readable = [fd]()
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+    };
+
+    SECTION("Signals On Empty To Non Empty Edge")
+    {
+        REQUIRE_FALSE(is_readable());
+        // Not armed, so a send does not signal
+        sender.send(1);
+        REQUIRE_FALSE(is_readable());
+        // Messages are queued, so the receiver must not wait on the descriptor
+        REQUIRE_FALSE(receiver.arm_notify());
+        REQUIRE(receiver.recv() == 1);
+
+        REQUIRE(receiver.arm_notify());
+        REQUIRE_FALSE(is_readable());
+        sender.send(2);
+        REQUIRE(is_readable());
+        // Only the first send after arming signals
+        sender.send(3);
+        char buffer[8];
+        REQUIRE(read(fd, buffer, sizeof(buffer)) == 1);
+
+        REQUIRE(receiver.recv() == 2);
+        REQUIRE(receiver.recv() == 3);
+        REQUIRE(receiver.arm_notify());
+        REQUIRE_FALSE(is_readable());
+    }
+
+    SECTION("Arm Clears Descriptor")
+    {
+        REQUIRE(receiver.arm_notify());
+        sender.send(1);
+        REQUIRE(is_readable());
+        REQUIRE(receiver.recv() == 1);
+        REQUIRE(receiver.arm_notify());
+        REQUIRE_FALSE(is_readable());
+    }
+}
+
+TEST_CASE("KoiQueue Notify Fd Path", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    const std::string path = NotifyFifo::fifo_path(shm_name);
+
+    SECTION("Owner Only FIFO")
+    {
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE);
+        REQUIRE(receiver.notify_fd() != -1);
+        struct stat fifo_stat;
+        REQUIRE(stat(path.c_str(), &fifo_stat) == 0);
+        REQUIRE(S_ISFIFO(fifo_stat.st_mode));
+        REQUIRE((fifo_stat.st_mode & 0777 & ~0600) == 0);
+    }
+
+    SECTION("Rejects A Regular File")
+    {
+        // E.g. left behind at the path by a crashed run
+        const int file_fd = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0600);
+        REQUIRE(file_fd != -1);
+        close(file_fd);
+        // A sender never appends to it
+        NotifyFifo fifo;
+        fifo.path = path;
+        fifo.signal();
+        REQUIRE(fifo.write_fd == -1);
+        struct stat file_stat;
+        REQUIRE(stat(path.c_str(), &file_stat) == 0);
+        REQUIRE(file_stat.st_size == 0);
+        // Cleaning up the receiver removes the file
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(receiver.notify_fd(), std::runtime_error);
+    }
+}
+
+TEST_CASE("KoiQueue Mapping Options", "[KoiQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    auto segment_size = [&shm_name]()
+    {
+        int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+        REQUIRE(fd != -1);
+        struct stat shm_stat;
+        REQUIRE(fstat(fd, &shm_stat) == 0);
+        close(fd);
+        return static_cast<size_t>(shm_stat.st_size);
+    };
+
+    SECTION("Send Recv")
+    {
+        // Unsupported options fall back to the default mapping, so every combination must work
+        const bool huge_pages = GENERATE(false, true);
+        const bool prefault = GENERATE(false, true);
+        const bool lock = GENERATE(false, true);
+        const KoiQueueOptions options{.mapping = {.huge_pages = huge_pages, .prefault = prefault, .lock = lock}};
+        KoiQueueRAII<int> sender(shm_name, SHM_SIZE, options);
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE);
+
+        const int num_messages = static_cast<int>(sender.capacity()) * 2 + 1;
+        for (int i = 0; i < num_messages; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+            REQUIRE(receiver.recv() == i);
+        }
+        if (huge_pages)
+        {
+            REQUIRE(segment_size() % HUGE_PAGE_BYTES == 0);
+        }
+    }
+
+    SECTION("Attach Does Not Shrink")
+    {
+        KoiQueueRAII<int> sender(shm_name, SHM_SIZE, KoiQueueOptions{.mapping = {.huge_pages = true}});
+        REQUIRE(segment_size() == HUGE_PAGE_BYTES);
+        KoiQueueRAII<int> receiver(shm_name, SHM_SIZE);
+        REQUIRE(segment_size() == HUGE_PAGE_BYTES);
+        REQUIRE(sender.send(1) == KoiQueueRet::OK);
+        REQUIRE(receiver.recv() == 1);
+    }
+}
+
+TEST_CASE("Cpu Placement", "[Affinity]")
+{
+    SECTION("Parse Cpu List")
+    {
+        REQUIRE(parse_cpu_list("0") == std::vector<int>{0});
+        REQUIRE(parse_cpu_list("0-3,8,10-11") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+        REQUIRE(parse_cpu_list("4,0-1") == std::vector<int>{0, 1, 4});
+        REQUIRE(parse_cpu_list("").empty());
+        REQUIRE(parse_cpu_list("0-x").empty());
+    }
+
+    SECTION("Pin Current Thread")
+    {
+        const std::vector<int> cpus = current_thread_cpus();
+#if defined(__linux__)
+        REQUIRE_FALSE(cpus.empty());
+        REQUIRE(pin_current_thread(cpus.back()));
+        REQUIRE(current_thread_cpus() == std::vector<int>{cpus.back()});
+        // Restore the original placement for the following tests
+        REQUIRE(pin_current_thread(cpus));
+        REQUIRE(current_thread_cpus() == cpus);
+#else
+        REQUIRE(cpus.empty());
+        REQUIRE_FALSE(pin_current_thread(0));
+#endif
+    }
+
+    SECTION("Topology")
+    {
+        const CpuTopology topology = CpuTopology::probe();
+        REQUIRE(topology.cpus() == current_thread_cpus());
+        for (int cpu : topology.cpus())
+        {
+            REQUIRE(topology.distance(cpu, cpu) == CpuDistance::SMT_SIBLING);
+        }
+        for (CpuDistance distance : {CpuDistance::SMT_SIBLING, CpuDistance::SHARED_L2, CpuDistance::SHARED_L3, CpuDistance::CROSS_L3})
+        {
+            const auto pair = topology.find_pair(distance);
+            if (pair.has_value())
+            {
+                REQUIRE(pair->first != pair->second);
+                REQUIRE(topology.distance(pair->first, pair->second) == distance);
+            }
+        }
+    }
+}
+
 TEST_CASE("KoiQueue Send Recv Large Message", "[KoiQueue][SingleThread][LargeMessage]")
 {
     // Use large messages that are already multiples of the cache line
@@ -229,8 +1037,11 @@ TEST_CASE("Sanity Checks", "[KoiQueue]")
     const std::string shm_name = generate_unique_shm_name();
     SECTION("Minimum SHM size")
     {
-        // Ensure the shared memory size is at least the size of the control block
-        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, sizeof(ControlBlock) - 1), std::invalid_argument);
+        // Ensure the shared memory size holds at least one message block
+        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, CACHE_LINE_BYTES - 1), std::invalid_argument);
+        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, QueueCapacity{0}), std::invalid_argument);
+        // The ring buffer size in bytes must not overflow
+        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, QueueCapacity{std::numeric_limits<size_t>::max()}), std::invalid_argument);
     }
 
     SECTION("Message block size rounding")
@@ -242,9 +1053,10 @@ TEST_CASE("Sanity Checks", "[KoiQueue]")
 
     SECTION("Valid byte buffer sizes")
     {
-        // Check a buffer size that is not a power of 2 throws an exception
-        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, CACHE_LINE_BYTES - 1), std::invalid_argument);
-        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, CACHE_LINE_BYTES * 6), std::invalid_argument);
+        // Any whole number of message blocks is valid, trailing bytes are unused
+        KoiQueueRAII<char> queue(shm_name, CACHE_LINE_BYTES * 6 + 1);
+        REQUIRE(queue.capacity() == 6);
+        REQUIRE(queue.user_shm_size() == CACHE_LINE_BYTES * 6);
     }
 
     SECTION("Queue is empty on creation")
@@ -252,4 +1064,32 @@ TEST_CASE("Sanity Checks", "[KoiQueue]")
         KoiQueueRAII<char> queue(shm_name, SHM_SIZE);
         REQUIRE(queue.is_empty());
     }
+    SECTION("Mismatched Futex Wait Strategy")
+    {
+        // A side which does not wake parked peers cannot attach to a `FUTEX` segment, and vice versa
+        KoiQueueRAII<char> queue(shm_name, SHM_SIZE, KoiQueueOptions{.wait_strategy = WaitStrategy::FUTEX});
+        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, SHM_SIZE), std::runtime_error);
+        KoiQueueRAII<char> peer(shm_name, SHM_SIZE, KoiQueueOptions{.wait_strategy = WaitStrategy::FUTEX});
+        REQUIRE(peer.send('a') == KoiQueueRet::OK);
+        REQUIRE(queue.recv() == 'a');
+    }
+    SECTION("Mismatched Cache Line Size")
+    {
+        KoiQueueRAII<char> queue(shm_name, SHM_SIZE);
+        REQUIRE(queue.send('a') == KoiQueueRet::OK);
+
+        // Pretend the segment was created by a build with a different `KOI_CACHE_LINE_BYTES`
+        int shm_fd = shm_open(shm_name.c_str(), O_RDWR, 0666);
+        REQUIRE(shm_fd != -1);
+        void *shm_ptr = mmap(nullptr, sizeof(ControlBlock), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        close(shm_fd);
+        REQUIRE(shm_ptr != MAP_FAILED);
+        ControlBlock *control_block = reinterpret_cast<ControlBlock *>(shm_ptr);
+        REQUIRE(control_block->write.cache_line_bytes == CACHE_LINE_BYTES);
+        control_block->write.cache_line_bytes = CACHE_LINE_BYTES * 2;
+
+        REQUIRE_THROWS_AS(KoiQueueRAII<char>(shm_name, SHM_SIZE), std::runtime_error);
+        control_block->write.cache_line_bytes = CACHE_LINE_BYTES;
+        munmap(shm_ptr, sizeof(ControlBlock));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "koi_lane_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <sys/wait.h>
+#include <vector>
+
+using namespace koi;
+
+struct LaneMessage
+{
+    uint32_t lane;
+    uint32_t seq;
+};
+
+TEST_CASE("Lane Send Recv Polling", "[KoiLaneQueue][MultiProcess]")
+{
+    // One sender process per lane sends concurrently, retrying when its lane is full, while the receiver polls
+    // with each schedule. Each lane's messages must arrive in order, and every message must arrive exactly once.
+    const KoiLaneQueueOptions options = GENERATE(KoiLaneQueueOptions{},
+                                                 KoiLaneQueueOptions{.schedule = LaneSchedule::WEIGHTED, .weights = {4, 2, 1}});
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_lanes = 3;
+    constexpr size_t lane_capacity = 64;
+    constexpr uint32_t num_msgs = 20000;
+    // Each message should certainly be received within 500ms
+    constexpr std::chrono::milliseconds timeout_duration(500);
+
+    // Create the queue before forking so all processes attach to the same segment
+    KoiLaneReceiver<LaneMessage> receiver(shm_name, num_lanes, lane_capacity, options);
+    std::vector<pid_t> sender_pids;
+    for (uint32_t lane = 0; lane < num_lanes; ++lane)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is the sender of one lane
+            KoiLaneSender<LaneMessage> sender(shm_name, num_lanes, lane_capacity);
+            for (uint32_t i = 0; i < num_msgs; ++i)
+            {
+                while (sender.send(lane, LaneMessage{lane, i}) != KoiQueueRet::OK)
+                {
+                }
+            }
+            exit(EXIT_SUCCESS);
+        }
+        sender_pids.push_back(pid);
+    }
+
+    // Parent process is the receiver
+    std::vector<uint32_t> next_seq(num_lanes, 0);
+    for (uint32_t i = 0; i < num_lanes * num_msgs; ++i)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+        std::optional<LaneMessage> message;
+        while (!(message = receiver.recv()).has_value())
+        {
+            if (std::chrono::steady_clock::now() - start_time > timeout_duration)
+            {
+                FAIL("Timed out waiting for message " << i);
+            }
+        }
+        REQUIRE(message->lane < num_lanes);
+        REQUIRE(message->seq == next_seq[message->lane]++);
+    }
+    REQUIRE(receiver.is_empty());
+
+    for (pid_t pid : sender_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    KoiLaneSender<LaneMessage>(shm_name, num_lanes, lane_capacity).cleanup_shm();
+}
@@ -0,0 +1,162 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_lane_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <vector>
+
+// A message of exactly one cache line
+struct Line
+{
+    char data[CACHE_LINE_BYTES];
+};
+
+TEST_CASE("KoiLaneQueue Send Recv", "[KoiLaneQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Send Recv Single")
+    {
+        KoiLaneQueueRAII<uint64_t> queue(shm_name, 2, 4);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+
+        REQUIRE(queue.send(1, 42) == KoiQueueRet::OK);
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.size(1) == 1);
+        REQUIRE(queue.recv() == 42);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+    }
+
+    SECTION("Lanes Fill Independently")
+    {
+        // A capacity which is not a power of 2
+        KoiLaneQueueRAII<uint32_t> queue(shm_name, 3, 5);
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        for (size_t lap = 0; lap < 4; ++lap)
+        {
+            while (queue.send(2, sent) == KoiQueueRet::OK)
+            {
+                ++sent;
+            }
+            REQUIRE(queue.size(2) == queue.lane_capacity());
+            // The full lane does not block the others
+            REQUIRE(queue.send(0, 1000) == KoiQueueRet::OK);
+            REQUIRE(queue.recv(0) == 1000);
+            // Free one slot, so the lane wraps at a different slot on each lap
+            REQUIRE(queue.recv(2) == received++);
+            REQUIRE(queue.send(2, sent++) == KoiQueueRet::OK);
+            REQUIRE(queue.send(2, sent) == KoiQueueRet::QUEUE_FULL);
+            while (auto message = queue.recv())
+            {
+                REQUIRE(message.value() == received++);
+            }
+            REQUIRE(received == sent);
+            REQUIRE(queue.is_empty());
+        }
+    }
+
+    SECTION("Attach Mid Lap")
+    {
+        // A side which attaches picks up each lane's slot from the positions in the control block
+        KoiLaneQueueRAII<uint32_t> sender(shm_name, 2, 5);
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        {
+            // Not RAII, so dropping it leaves the segment in place
+            koi::KoiLaneReceiver<uint32_t> receiver(shm_name, 2, 5);
+            for (; sent < 8; ++sent)
+            {
+                REQUIRE(sender.send(1, sent) == KoiQueueRet::OK);
+                REQUIRE(receiver.recv(1) == received++);
+            }
+        }
+        REQUIRE(sender.send(1, sent++) == KoiQueueRet::OK);
+        KoiLaneQueueRAII<uint32_t> receiver(shm_name, 2, 5);
+        for (; sent < 20; ++sent)
+        {
+            REQUIRE(sender.send(1, sent) == KoiQueueRet::OK);
+            REQUIRE(receiver.recv(1) == received++);
+        }
+        REQUIRE(receiver.recv(1) == received++);
+        REQUIRE(received == sent);
+    }
+
+    SECTION("Strict Priority")
+    {
+        KoiLaneQueueRAII<uint32_t> queue(shm_name, 3, 8);
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            REQUIRE(queue.send(2, 200 + i) == KoiQueueRet::OK);
+            REQUIRE(queue.send(1, 100 + i) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.recv() == 100);
+        // A message sent to the highest priority lane overtakes the backlog of the others
+        REQUIRE(queue.send(0, 0) == KoiQueueRet::OK);
+        REQUIRE(queue.recv() == 0);
+        std::vector<uint32_t> order;
+        while (auto message = queue.recv())
+        {
+            order.push_back(message.value());
+        }
+        REQUIRE(order == std::vector<uint32_t>{101, 102, 103, 200, 201, 202, 203});
+    }
+
+    SECTION("Weighted")
+    {
+        KoiLaneQueueRAII<uint32_t> queue(shm_name, 2, 8, KoiLaneQueueOptions{.schedule = LaneSchedule::WEIGHTED, .weights = {3, 1}});
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            REQUIRE(queue.send(0, i) == KoiQueueRet::OK);
+            REQUIRE(queue.send(1, 100 + i) == KoiQueueRet::OK);
+        }
+        std::vector<uint32_t> order;
+        while (auto message = queue.recv())
+        {
+            order.push_back(message.value());
+        }
+        // Three from lane 0 per one from lane 1, then lane 1 keeps its turn once lane 0 is empty
+        REQUIRE(order == std::vector<uint32_t>{0, 1, 2, 100, 3, 4, 5, 101, 102, 103, 104, 105});
+    }
+
+    SECTION("Lane Out Of Range")
+    {
+        KoiLaneQueueRAII<uint32_t> queue(shm_name, 2, 4);
+        REQUIRE_THROWS_AS(queue.send(2, 0), std::out_of_range);
+        REQUIRE_THROWS_AS(queue.recv(2), std::out_of_range);
+    }
+}
+
+TEST_CASE("KoiLaneQueue Metadata", "[KoiLaneQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Message Block Size")
+    {
+        // Messages are rounded up to the nearest cache line
+        STATIC_REQUIRE(KoiLaneQueue<char>::message_block_sz_bytes() == CACHE_LINE_BYTES);
+        STATIC_REQUIRE(KoiLaneQueue<Line>::message_block_sz_bytes() == CACHE_LINE_BYTES);
+    }
+
+    SECTION("Invalid Options")
+    {
+        REQUIRE_THROWS_AS(KoiLaneQueueRAII<char>(shm_name, 0, 4), std::invalid_argument);
+        REQUIRE_THROWS_AS(KoiLaneQueueRAII<char>(shm_name, 2, 0), std::invalid_argument);
+        REQUIRE_THROWS_AS(KoiLaneQueueRAII<char>(shm_name, 2, 4, KoiLaneQueueOptions{.schedule = LaneSchedule::WEIGHTED, .weights = {1}}),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(KoiLaneQueueRAII<char>(shm_name, 2, 4, KoiLaneQueueOptions{.schedule = LaneSchedule::WEIGHTED, .weights = {1, 0}}),
+                          std::invalid_argument);
+    }
+
+    SECTION("Mismatched Attach")
+    {
+        KoiLaneQueueRAII<char> queue(shm_name, 2, 4);
+        REQUIRE_THROWS_AS(KoiLaneQueueRAII<char>(shm_name, 3, 4), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiLaneQueueRAII<char>(shm_name, 2, 8), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiLaneQueueRAII<Line[2]>(shm_name, 2, 4), std::runtime_error);
+    }
+}
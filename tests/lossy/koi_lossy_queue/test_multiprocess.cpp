@@ -0,0 +1,85 @@
+#include "koi_lossy_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <sys/wait.h>
+#include <thread>
+
+using namespace koi;
+
+// Large enough that a message torn by a concurrent overwrite is detected by the check below
+struct Tick
+{
+    uint64_t seq;
+    uint64_t payload[7];
+};
+
+TEST_CASE("Lossy Send Recv With Slow Receiver", "[KoiLossyQueue][MultiProcess]")
+{
+    // The sender process never waits while the receiver stalls periodically. The receiver must see strictly
+    // increasing, untorn messages, and account for every gap in `lost_messages()`.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint64_t num_msgs = 200000;
+    constexpr size_t buffer_bytes = 64 * KoiLossyQueue<Tick>::message_block_sz_bytes();
+
+    KoiLossyReceiver<Tick> receiver(shm_name, buffer_bytes);
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+        // Child process is the sender. Nothing overwrites the last message, so the receiver always finds it
+        KoiLossySender<Tick> sender(shm_name, buffer_bytes);
+        for (uint64_t i = 0; i < num_msgs; ++i)
+        {
+            Tick tick{.seq = i};
+            std::fill(std::begin(tick.payload), std::end(tick.payload), i);
+            sender.send(tick);
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    // Parent process is the receiver
+    uint64_t received = 0;
+    int64_t last_seq = -1;
+    auto start_time = std::chrono::steady_clock::now();
+    while (last_seq + 1 < static_cast<int64_t>(num_msgs))
+    {
+        if (std::chrono::steady_clock::now() - start_time > std::chrono::seconds(10))
+        {
+            FAIL("Timed out waiting for the last message, received up to " << last_seq);
+        }
+        std::optional<Tick> tick = receiver.recv();
+        if (!tick.has_value())
+        {
+            continue;
+        }
+        for (uint64_t value : tick->payload)
+        {
+            REQUIRE(value == tick->seq);
+        }
+        REQUIRE(static_cast<int64_t>(tick->seq) > last_seq);
+        last_seq = tick->seq;
+        ++received;
+        if (received % 1024 == 0)
+        {
+            // Stall, so the sender laps the receiver
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    // Every message before the last was either received or counted as lost
+    REQUIRE(received + receiver.lost_messages() == num_msgs);
+
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) != -1);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    KoiLossySender<Tick>(shm_name, buffer_bytes).cleanup_shm();
+}
@@ -0,0 +1,126 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_lossy_queue.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+
+// A message of exactly one cache line
+struct Line
+{
+    char data[CACHE_LINE_BYTES];
+};
+
+TEST_CASE("KoiLossyQueue Send Recv", "[KoiLossyQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Send Recv Single")
+    {
+        KoiLossyQueueRAII<uint64_t> queue(shm_name, SHM_SIZE);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+
+        REQUIRE(queue.send(42) == KoiQueueRet::OK);
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.recv() == 42);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+        REQUIRE(queue.lost_messages() == 0);
+    }
+
+    SECTION("Keeps Up Over Several Laps")
+    {
+        // A receiver which never falls a whole ring behind loses nothing
+        KoiLossyQueueRAII<uint32_t> queue(shm_name, 5 * KoiLossyQueue<uint32_t>::message_block_sz_bytes());
+        REQUIRE(queue.capacity() == 5);
+        uint32_t received = 0;
+        for (uint32_t sent = 0; sent < 40;)
+        {
+            for (size_t i = 0; i < 3; ++i)
+            {
+                REQUIRE(queue.send(sent++) == KoiQueueRet::OK);
+            }
+            while (auto message = queue.recv())
+            {
+                REQUIRE(message.value() == received++);
+            }
+        }
+        REQUIRE(queue.lost_messages() == 0);
+    }
+
+    SECTION("Overwrites When Full")
+    {
+        KoiLossyQueueRAII<uint32_t> queue(shm_name, 4 * KoiLossyQueue<uint32_t>::message_block_sz_bytes());
+        // The sender never finds the queue full
+        for (uint32_t i = 0; i < 11; ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.size() == 11);
+        // Messages 0 to 6 were overwritten. The receiver also skips 7, which the next send overwrites
+        REQUIRE(queue.recv() == 8);
+        REQUIRE(queue.lost_messages() == 8);
+        REQUIRE(queue.recv() == 9);
+        REQUIRE(queue.recv() == 10);
+        REQUIRE_FALSE(queue.recv().has_value());
+        REQUIRE(queue.is_empty());
+
+        // Gaps accumulate
+        for (uint32_t i = 11; i < 20; ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.recv() == 17);
+        REQUIRE(queue.lost_messages() == 14);
+    }
+
+    SECTION("Receiver Resumes")
+    {
+        // A later receiver picks up from the previous one's position, counting its own losses
+        KoiLossyQueueRAII<uint32_t> queue(shm_name, 4 * KoiLossyQueue<uint32_t>::message_block_sz_bytes());
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.recv() == 0);
+        KoiLossyQueueRAII<uint32_t> other(shm_name, queue.user_shm_size());
+        REQUIRE(other.size() == 2);
+        REQUIRE(other.recv() == 1);
+        REQUIRE(other.lost_messages() == 0);
+
+        // Both sides wrap around the ring from the slots they attached at
+        for (uint32_t i = 3; i < 6; ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+        }
+        KoiLossyQueueRAII<uint32_t> third(shm_name, queue.user_shm_size());
+        for (uint32_t i = 2; i < 6; ++i)
+        {
+            REQUIRE(third.recv() == i);
+        }
+        REQUIRE(third.lost_messages() == 0);
+        REQUIRE_FALSE(third.recv().has_value());
+    }
+}
+
+TEST_CASE("KoiLossyQueue Metadata", "[KoiLossyQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Buffer Size")
+    {
+        // Rounded down to whole blocks
+        KoiLossyQueueRAII<char> queue(shm_name, 3 * CACHE_LINE_BYTES + 1);
+        REQUIRE(queue.user_shm_size() == 3 * CACHE_LINE_BYTES);
+        REQUIRE(queue.capacity() == 3);
+        REQUIRE_THROWS_AS(KoiLossyQueueRAII<char>(generate_unique_shm_name(), CACHE_LINE_BYTES - 1), std::invalid_argument);
+    }
+
+    SECTION("Mismatched Attach")
+    {
+        KoiLossyQueueRAII<char> queue(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(KoiLossyQueueRAII<char>(shm_name, SHM_SIZE / 2), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiLossyQueueRAII<Line>(shm_name, SHM_SIZE), std::runtime_error);
+    }
+}
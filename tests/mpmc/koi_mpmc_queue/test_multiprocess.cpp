@@ -0,0 +1,183 @@
+#include "koi_mpmc_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace koi;
+
+struct ProducerMessage
+{
+    uint32_t producer;
+    uint32_t seq;
+};
+
+TEST_CASE("Mpmc Send Recv Polling", "[KoiMpmcQueue][MultiProcess]")
+{
+    // Several producer processes send concurrently, retrying when the queue is full, while several consumer processes
+    // compete for the messages. Each consumer reports the messages it received through a pipe. Every message must be
+    // received exactly once, and each consumer must receive each producer's messages in order.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_producers = 3;
+    constexpr uint32_t num_consumers = 3;
+    constexpr uint32_t num_msgs = 10000;
+    // Sent by the parent once the producers have finished, one per consumer, so each consumer stops once it
+    // receives one
+    constexpr ProducerMessage stop{UINT32_MAX, UINT32_MAX};
+
+    // Create the queue before forking so all processes attach to the same segment
+    KoiMpmcSender<ProducerMessage> sender(shm_name, SHM_SIZE);
+    std::vector<pid_t> producer_pids;
+    for (uint32_t producer = 0; producer < num_producers; ++producer)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is a producer
+            KoiMpmcSender<ProducerMessage> producer_sender(shm_name, SHM_SIZE);
+            for (uint32_t i = 0; i < num_msgs; ++i)
+            {
+                while (producer_sender.send(ProducerMessage{producer, i}) != KoiQueueRet::OK)
+                {
+                }
+            }
+            exit(EXIT_SUCCESS);
+        }
+        producer_pids.push_back(pid);
+    }
+
+    std::vector<pid_t> consumer_pids;
+    std::vector<int> result_fds;
+    for (uint32_t consumer = 0; consumer < num_consumers; ++consumer)
+    {
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is a consumer
+            close(fds[0]);
+            KoiMpmcReceiver<ProducerMessage> receiver(shm_name, SHM_SIZE);
+            std::vector<ProducerMessage> received;
+            while (true)
+            {
+                std::optional<ProducerMessage> message = receiver.recv();
+                if (!message.has_value())
+                {
+                    continue;
+                }
+                if (message->producer == stop.producer)
+                {
+                    break;
+                }
+                received.push_back(message.value());
+            }
+            const uint32_t count = received.size();
+            bool ok = write(fds[1], &count, sizeof(count)) == sizeof(count);
+            const ssize_t bytes = count * sizeof(ProducerMessage);
+            ok = ok && write(fds[1], received.data(), bytes) == bytes;
+            close(fds[1]);
+            exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        close(fds[1]);
+        consumer_pids.push_back(pid);
+        result_fds.push_back(fds[0]);
+    }
+
+    for (pid_t pid : producer_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    for (uint32_t consumer = 0; consumer < num_consumers; ++consumer)
+    {
+        while (sender.send(stop) != KoiQueueRet::OK)
+        {
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> times_received(num_producers, std::vector<uint32_t>(num_msgs, 0));
+    for (int fd : result_fds)
+    {
+        // Read the consumer's results before waiting for it, so it does not block on a full pipe
+        uint32_t count = 0;
+        REQUIRE(read(fd, &count, sizeof(count)) == sizeof(count));
+        std::vector<ProducerMessage> received(count);
+        size_t bytes_read = 0;
+        while (bytes_read < count * sizeof(ProducerMessage))
+        {
+            const ssize_t ret = read(fd, reinterpret_cast<char *>(received.data()) + bytes_read, count * sizeof(ProducerMessage) - bytes_read);
+            REQUIRE(ret > 0);
+            bytes_read += ret;
+        }
+        close(fd);
+        std::vector<int64_t> last_seq(num_producers, -1);
+        for (const ProducerMessage &message : received)
+        {
+            REQUIRE(message.producer < num_producers);
+            REQUIRE(message.seq < num_msgs);
+            REQUIRE(last_seq[message.producer] < static_cast<int64_t>(message.seq));
+            last_seq[message.producer] = message.seq;
+            ++times_received[message.producer][message.seq];
+        }
+    }
+    for (uint32_t producer = 0; producer < num_producers; ++producer)
+    {
+        for (uint32_t i = 0; i < num_msgs; ++i)
+        {
+            REQUIRE(times_received[producer][i] == 1);
+        }
+    }
+    REQUIRE(sender.is_empty());
+
+    for (pid_t pid : consumer_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    sender.cleanup_shm();
+}
+
+TEST_CASE("Mpmc Queue Persists", "[KoiMpmcQueue][MultiProcess]")
+{
+    // Messages outlive the sender and receiver which sent and partially received them
+    const std::string shm_name = generate_unique_shm_name();
+    {
+        KoiMpmcSender<uint32_t> sender(shm_name, SHM_SIZE);
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+        }
+        KoiMpmcReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+        REQUIRE(receiver.recv() == 0);
+    }
+    KoiMpmcSender<uint32_t> sender(shm_name, SHM_SIZE);
+    REQUIRE(sender.send(4) == KoiQueueRet::OK);
+    KoiMpmcReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+    REQUIRE(receiver.size() == 4);
+    for (uint32_t i = 1; i < 5; ++i)
+    {
+        REQUIRE(receiver.recv() == i);
+    }
+    REQUIRE(receiver.is_empty());
+    sender.cleanup_shm();
+}
@@ -0,0 +1,91 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_mpmc_queue.hh"
+#include "koi_slot.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <array>
+#include <cstdint>
+
+// The construction, metadata and single claiming side of the slot queues are covered by the `KoiMpscQueue` and
+// `KoiSpmcQueue` tests. These cover producers and consumers both claiming from shared positions
+TEST_CASE("KoiMpmcQueue Claims", "[KoiMpmcQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    // A capacity which is not a power of 2
+    const size_t buffer_bytes = 5 * KoiMpmcQueue<uint32_t>::message_block_sz_bytes();
+
+    SECTION("Interleaved Claims On Both Positions")
+    {
+        // Three handles take turns sending and receiving bursts, so each handle's view of both positions falls behind
+        // the shared positions by less than a lap or by more than one between its own claims
+        KoiMpmcQueueRAII<uint32_t> first(shm_name, buffer_bytes);
+        KoiMpmcQueueRAII<uint32_t> second(shm_name, buffer_bytes);
+        KoiMpmcQueueRAII<uint32_t> third(shm_name, buffer_bytes);
+        const std::array<KoiMpmcQueueRAII<uint32_t> *, 3> handles{&first, &second, &third};
+        REQUIRE(first.capacity() == 5);
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        for (size_t round = 0; round < 60; ++round)
+        {
+            const size_t burst = 1 + round % first.capacity();
+            KoiMpmcQueueRAII<uint32_t> &producer = *handles[round % 3];
+            for (size_t i = 0; i < burst; ++i)
+            {
+                REQUIRE(producer.send(sent++) == KoiQueueRet::OK);
+            }
+            if (burst == first.capacity())
+            {
+                REQUIRE(producer.send(sent) == KoiQueueRet::QUEUE_FULL);
+            }
+            // Each message is received once and in order, whichever handle claims it
+            KoiMpmcQueueRAII<uint32_t> &consumer = *handles[(2 * round + 1) % 3];
+            for (size_t i = 0; i < burst; ++i)
+            {
+                REQUIRE(consumer.recv() == received++);
+            }
+            REQUIRE_FALSE(handles[round % 3]->recv().has_value());
+        }
+        REQUIRE(received == sent);
+        REQUIRE(first.is_empty());
+    }
+
+    SECTION("Consumer Stalled Mid Claim")
+    {
+        KoiMpmcQueueRAII<uint32_t> queue(shm_name, buffer_bytes);
+        KoiMpmcQueueRAII<uint32_t> other(shm_name, buffer_bytes);
+        for (uint32_t i = 0; i < 5; ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+        }
+        // A consumer which claimed message 0 and stalled before copying it out
+        SlotRing stalled;
+        stalled.shm_name = shm_name;
+        REQUIRE(stalled.open_ring(buffer_bytes, KoiMpmcQueue<uint32_t>::message_block_sz_bytes()) == SHM_EXISTS);
+        SlotCursor cursor;
+        SlotClaim claim;
+        REQUIRE(claim_published_slot(stalled, cursor, claim));
+
+        // The other consumers claim the messages behind it
+        for (uint32_t i = 1; i < 5; ++i)
+        {
+            REQUIRE((i % 2 ? other : queue).recv() == i);
+        }
+        REQUIRE(queue.is_empty());
+        // The producers' next position maps to the stalled slot, so they wait for it even with the later slots free
+        REQUIRE(queue.send(5) == KoiQueueRet::QUEUE_FULL);
+        REQUIRE(other.send(5) == KoiQueueRet::QUEUE_FULL);
+
+        complete_slot(claim);
+        for (uint32_t i = 5; i < 10; ++i)
+        {
+            REQUIRE((i % 2 ? other : queue).send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.send(10) == KoiQueueRet::QUEUE_FULL);
+        for (uint32_t i = 5; i < 10; ++i)
+        {
+            REQUIRE((i % 2 ? queue : other).recv() == i);
+        }
+        stalled.cleanup();
+    }
+}
@@ -0,0 +1,104 @@
+#include "koi_mpsc_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <sys/wait.h>
+#include <vector>
+
+using namespace koi;
+
+struct ProducerMessage
+{
+    uint32_t producer;
+    uint32_t seq;
+};
+
+TEST_CASE("Mpsc Send Recv Polling", "[KoiMpscQueue][MultiProcess]")
+{
+    // Several producer processes send concurrently, retrying when the queue is full, while the consumer polls
+    // the queue. Each producer's messages must arrive in order, and every message must arrive exactly once.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_producers = 4;
+    constexpr uint32_t num_msgs = 20000;
+    // Each message should certainly be received within 500ms
+    constexpr std::chrono::milliseconds timeout_duration(500);
+
+    // Create the queue before forking so all processes attach to the same segment
+    KoiMpscReceiver<ProducerMessage> receiver(shm_name, SHM_SIZE);
+    std::vector<pid_t> producer_pids;
+    for (uint32_t producer = 0; producer < num_producers; ++producer)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is a producer
+            KoiMpscSender<ProducerMessage> sender(shm_name, SHM_SIZE);
+            for (uint32_t i = 0; i < num_msgs; ++i)
+            {
+                while (sender.send(ProducerMessage{producer, i}) != KoiQueueRet::OK)
+                {
+                }
+            }
+            exit(EXIT_SUCCESS);
+        }
+        producer_pids.push_back(pid);
+    }
+
+    // Parent process is the consumer
+    std::vector<uint32_t> next_seq(num_producers, 0);
+    for (uint32_t i = 0; i < num_producers * num_msgs; ++i)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+        std::optional<ProducerMessage> message;
+        while (!(message = receiver.recv()).has_value())
+        {
+            if (std::chrono::steady_clock::now() - start_time > timeout_duration)
+            {
+                FAIL("Timed out waiting for message " << i);
+            }
+        }
+        REQUIRE(message->producer < num_producers);
+        REQUIRE(message->seq == next_seq[message->producer]++);
+    }
+    REQUIRE(receiver.is_empty());
+
+    for (pid_t pid : producer_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    KoiMpscSender<ProducerMessage>(shm_name, SHM_SIZE).cleanup_shm();
+}
+
+TEST_CASE("Mpsc Receiver Resumes", "[KoiMpscQueue][MultiProcess]")
+{
+    // A later receiver picks up from the position of the previous one
+    const std::string shm_name = generate_unique_shm_name();
+    KoiMpscSender<uint32_t> sender(shm_name, SHM_SIZE);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        REQUIRE(sender.send(i) == KoiQueueRet::OK);
+    }
+    {
+        KoiMpscReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+        REQUIRE(receiver.recv() == 0);
+        REQUIRE(receiver.recv() == 1);
+    }
+    KoiMpscReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+    REQUIRE(receiver.size() == 2);
+    REQUIRE(receiver.recv() == 2);
+    REQUIRE(receiver.recv() == 3);
+    REQUIRE(receiver.is_empty());
+    sender.cleanup_shm();
+}
@@ -0,0 +1,93 @@
+#include "koi_mux.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <sys/wait.h>
+#include <vector>
+
+using namespace koi;
+
+struct SourceMessage
+{
+    uint32_t source;
+    uint32_t seq;
+};
+
+TEST_CASE("Mux Send Poll", "[KoiMux][MultiProcess]")
+{
+    // One sender process per source sends concurrently, retrying when its queue is full, while the receiver polls
+    // the multiplexer with each schedule. A message whose doorbell ring is missed would only arrive with the
+    // source's next message, so the last message of each source checks that no ring is lost.
+    const KoiMuxOptions options = GENERATE(KoiMuxOptions{},
+                                           KoiMuxOptions{.schedule = MuxSchedule::WEIGHTED, .weights = {1, 2, 3, 4, 5, 6, 7, 8}});
+    const std::string doorbell_name = generate_unique_shm_name();
+    constexpr uint32_t num_sources = 8;
+    constexpr uint32_t num_msgs = 10000;
+    // Each message should certainly be received within 500ms
+    constexpr std::chrono::milliseconds timeout_duration(500);
+
+    std::vector<std::string> names;
+    for (uint32_t source = 0; source < num_sources; ++source)
+    {
+        names.push_back(doorbell_name + "_" + std::to_string(source));
+    }
+    // Create the queues before forking so all processes attach to the same segments
+    KoiMux<SourceMessage> mux(doorbell_name, names, SHM_SIZE, options);
+    std::vector<pid_t> sender_pids;
+    for (uint32_t source = 0; source < num_sources; ++source)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is the sender of one source
+            KoiMuxSender<SourceMessage> sender(doorbell_name, num_sources, source, names[source], SHM_SIZE);
+            for (uint32_t i = 0; i < num_msgs; ++i)
+            {
+                while (sender.send(SourceMessage{source, i}) != KoiQueueRet::OK)
+                {
+                }
+            }
+            exit(EXIT_SUCCESS);
+        }
+        sender_pids.push_back(pid);
+    }
+
+    // Parent process is the receiver
+    std::vector<uint32_t> next_seq(num_sources, 0);
+    for (uint32_t i = 0; i < num_sources * num_msgs; ++i)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+        std::optional<MuxMessage<SourceMessage>> polled;
+        while (!(polled = mux.poll()).has_value())
+        {
+            if (std::chrono::steady_clock::now() - start_time > timeout_duration)
+            {
+                FAIL("Timed out waiting for message " << i);
+            }
+        }
+        REQUIRE(polled->source < num_sources);
+        REQUIRE(polled->message.source == polled->source);
+        REQUIRE(polled->message.seq == next_seq[polled->source]++);
+    }
+    REQUIRE_FALSE(mux.poll().has_value());
+
+    for (pid_t pid : sender_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    for (uint32_t source = 0; source < num_sources; ++source)
+    {
+        KoiMuxSender<SourceMessage>(doorbell_name, num_sources, source, names[source], SHM_SIZE).cleanup_shm();
+    }
+    mux.cleanup_shm();
+}
@@ -0,0 +1,159 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_mux.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace koi;
+
+// Queue names of `num_sources` sources sharing the doorbell `base`
+static std::vector<std::string> source_names(const std::string &base, size_t num_sources)
+{
+    std::vector<std::string> names;
+    for (size_t source = 0; source < num_sources; ++source)
+    {
+        names.push_back(base + "_" + std::to_string(source));
+    }
+    return names;
+}
+
+// Unlinks the queues of every source and the doorbell
+static void cleanup_sources(const std::string &doorbell_name, const std::vector<std::string> &names)
+{
+    for (size_t source = 0; source < names.size(); ++source)
+    {
+        KoiMuxSender<uint32_t>(doorbell_name, names.size(), source, names[source], SHM_SIZE).cleanup_shm();
+    }
+    KoiDoorbell(doorbell_name, names.size()).cleanup_shm();
+}
+
+// Returns the `(source, message)` pairs polled until `mux` has no message
+static std::vector<std::pair<size_t, uint32_t>> poll_all(KoiMux<uint32_t> &mux)
+{
+    std::vector<std::pair<size_t, uint32_t>> polled;
+    while (std::optional<MuxMessage<uint32_t>> polled_message = mux.poll())
+    {
+        polled.emplace_back(polled_message->source, polled_message->message);
+    }
+    return polled;
+}
+
+TEST_CASE("KoiMux Poll", "[KoiMux][SingleThread]")
+{
+    const std::string doorbell_name = generate_unique_shm_name();
+
+    SECTION("Poll Single")
+    {
+        const std::vector<std::string> names = source_names(doorbell_name, 3);
+        KoiMux<uint32_t> mux(doorbell_name, names, SHM_SIZE);
+        KoiMuxSender<uint32_t> sender(doorbell_name, 3, 1, names[1], SHM_SIZE);
+        REQUIRE(mux.num_sources() == 3);
+        REQUIRE_FALSE(mux.poll().has_value());
+
+        REQUIRE(sender.send(42) == KoiQueueRet::OK);
+        std::optional<MuxMessage<uint32_t>> polled = mux.poll();
+        REQUIRE(polled.has_value());
+        REQUIRE(polled->source == 1);
+        REQUIRE(polled->message == 42);
+        REQUIRE_FALSE(mux.poll().has_value());
+
+        // A message sent after the source was found empty rings the doorbell again
+        const std::vector<uint32_t> batch = {1, 2};
+        REQUIRE(sender.send_batch(batch) == 2);
+        REQUIRE(poll_all(mux) == std::vector<std::pair<size_t, uint32_t>>{{1, 1}, {1, 2}});
+        cleanup_sources(doorbell_name, names);
+    }
+
+    SECTION("Schedules")
+    {
+        const std::vector<std::string> names = source_names(doorbell_name, 3);
+        KoiMuxOptions options;
+        std::vector<std::pair<size_t, uint32_t>> expected;
+        SECTION("Round Robin")
+        {
+            expected = {{0, 0}, {2, 200}, {0, 1}, {2, 201}, {0, 2}, {2, 202}};
+        }
+        SECTION("Weighted")
+        {
+            options = KoiMuxOptions{.schedule = MuxSchedule::WEIGHTED, .weights = {2, 1, 1}};
+            expected = {{0, 0}, {0, 1}, {2, 200}, {0, 2}, {2, 201}, {2, 202}};
+        }
+        KoiMux<uint32_t> mux(doorbell_name, names, SHM_SIZE, options);
+        KoiMuxSender<uint32_t> first(doorbell_name, 3, 0, names[0], SHM_SIZE);
+        KoiMuxSender<uint32_t> last(doorbell_name, 3, 2, names[2], SHM_SIZE);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            REQUIRE(first.send(i) == KoiQueueRet::OK);
+            REQUIRE(last.send(200 + i) == KoiQueueRet::OK);
+        }
+        REQUIRE(poll_all(mux) == expected);
+        cleanup_sources(doorbell_name, names);
+    }
+
+    SECTION("Many Words")
+    {
+        // Sources in several doorbell words, including a partial last word
+        constexpr size_t num_sources = 130;
+        const std::vector<std::string> names = source_names(doorbell_name, num_sources);
+        KoiMux<uint32_t> mux(doorbell_name, names, SHM_SIZE);
+        std::vector<std::unique_ptr<KoiMuxSender<uint32_t>>> senders;
+        for (size_t source = 0; source < num_sources; ++source)
+        {
+            senders.push_back(std::make_unique<KoiMuxSender<uint32_t>>(doorbell_name, num_sources, source, names[source], SHM_SIZE));
+        }
+        REQUIRE_FALSE(mux.poll().has_value());
+        for (size_t source : {129, 64, 63, 0})
+        {
+            REQUIRE(senders[source]->send(static_cast<uint32_t>(source)) == KoiQueueRet::OK);
+        }
+        REQUIRE(poll_all(mux) == std::vector<std::pair<size_t, uint32_t>>{{0, 0}, {63, 63}, {64, 64}, {129, 129}});
+        cleanup_sources(doorbell_name, names);
+    }
+
+    SECTION("Messages Before Attach")
+    {
+        const std::vector<std::string> names = source_names(doorbell_name, 2);
+        KoiMuxSender<uint32_t> sender(doorbell_name, 2, 1, names[1], SHM_SIZE);
+        REQUIRE(sender.send(7) == KoiQueueRet::OK);
+        {
+            // A receiver which took the doorbell bit, but not the message
+            KoiMux<uint32_t> mux(doorbell_name, names, SHM_SIZE);
+            REQUIRE(mux.poll()->message == 7);
+        }
+        REQUIRE(sender.send(8) == KoiQueueRet::OK);
+        REQUIRE(sender.send(9) == KoiQueueRet::OK);
+        {
+            KoiMux<uint32_t> mux(doorbell_name, names, SHM_SIZE);
+            REQUIRE(mux.poll()->message == 8);
+        }
+        KoiMux<uint32_t> mux(doorbell_name, names, SHM_SIZE);
+        REQUIRE(poll_all(mux) == std::vector<std::pair<size_t, uint32_t>>{{1, 9}});
+        cleanup_sources(doorbell_name, names);
+    }
+}
+
+TEST_CASE("KoiMux Metadata", "[KoiMux][SingleThread]")
+{
+    const std::string doorbell_name = generate_unique_shm_name();
+    const std::vector<std::string> names = source_names(doorbell_name, 2);
+
+    SECTION("Invalid Options")
+    {
+        REQUIRE_THROWS_AS(KoiMux<uint32_t>(doorbell_name, {}, SHM_SIZE), std::invalid_argument);
+        REQUIRE_THROWS_AS(KoiMux<uint32_t>(doorbell_name, names, SHM_SIZE, KoiMuxOptions{.schedule = MuxSchedule::WEIGHTED, .weights = {1}}),
+                          std::invalid_argument);
+        cleanup_sources(doorbell_name, names);
+    }
+
+    SECTION("Mismatched Doorbell")
+    {
+        KoiDoorbell doorbell(doorbell_name, 2);
+        REQUIRE_THROWS_AS(KoiDoorbell(doorbell_name, 3), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiMuxSender<uint32_t>(doorbell_name, 2, 2, names[0], SHM_SIZE), std::out_of_range);
+        cleanup_sources(doorbell_name, names);
+    }
+}
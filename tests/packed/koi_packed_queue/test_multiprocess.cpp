@@ -0,0 +1,119 @@
+#include "koi_packed_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <sys/wait.h>
+
+using namespace koi;
+
+TEST_CASE("Packed Send Recv Polling", "[KoiPackedQueue][MultiProcess]")
+{
+    // The sender sends bursts of messages, flushing after each burst, retrying when the queue is full,
+    // while the receiver polls the queue. The bursts do not line up with lines, so partial lines are exercised.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint64_t num_msgs = 100000;
+    constexpr uint64_t burst_size = 37;
+    // Each message should certainly be sent within 500ms
+    constexpr std::chrono::milliseconds timeout_duration(500);
+
+    // Create the queue before forking so both processes attach to the same segment
+    KoiPackedSender<uint64_t> sender(shm_name, SHM_SIZE);
+    pid_t receiver_pid = fork();
+    if (receiver_pid == -1)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (receiver_pid == 0)
+    {
+        // Child process is receiver
+        KoiPackedReceiver<uint64_t> queue(shm_name, SHM_SIZE);
+        for (uint64_t i = 0; i < num_msgs; ++i)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            std::optional<uint64_t> message;
+            do
+            {
+                message = queue.recv();
+                if (std::chrono::steady_clock::now() - start_time > timeout_duration)
+                {
+                    // Timeout error, fail test case
+                    exit(EXIT_FAILURE);
+                }
+            } while (!message.has_value());
+            if (message.value() != i)
+            {
+                exit(EXIT_FAILURE);
+            }
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    // Parent process is sender
+    for (uint64_t i = 0; i < num_msgs; ++i)
+    {
+        while (sender.send(i) != KoiQueueRet::OK)
+        {
+        }
+        if (i % burst_size == burst_size - 1)
+        {
+            sender.flush();
+        }
+    }
+    sender.flush();
+
+    int status = 0;
+    if (waitpid(receiver_pid, &status, 0) == -1)
+    {
+        perror("waitpid");
+        exit(EXIT_FAILURE);
+    }
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    sender.cleanup_shm();
+}
+
+TEST_CASE("Packed Receiver Resumes Mid Line", "[KoiPackedQueue][MultiProcess]")
+{
+    // A receiver which stops part way through a line hands the rest of the line to the next receiver
+    const std::string shm_name = generate_unique_shm_name();
+    KoiPackedSender<uint32_t> sender(shm_name, SHM_SIZE);
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        REQUIRE(sender.send(i) == KoiQueueRet::OK);
+    }
+    sender.flush();
+    {
+        KoiPackedReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+        REQUIRE(receiver.recv() == 0);
+        REQUIRE(receiver.recv() == 1);
+    }
+    {
+        KoiPackedReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+        REQUIRE(receiver.recv() == 2);
+        REQUIRE(receiver.recv() == 3);
+        REQUIRE(receiver.recv() == 4);
+        REQUIRE_FALSE(receiver.recv().has_value());
+    }
+    sender.cleanup_shm();
+}
+
+TEST_CASE("Packed Sender Flushes On Destruction", "[KoiPackedQueue][MultiProcess]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    KoiPackedReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+    {
+        KoiPackedSender<uint32_t> sender(shm_name, SHM_SIZE);
+        REQUIRE(sender.send(7) == KoiQueueRet::OK);
+        REQUIRE(sender.send(8) == KoiQueueRet::OK);
+        REQUIRE(receiver.is_empty());
+    }
+    REQUIRE(receiver.recv() == 7);
+    REQUIRE(receiver.recv() == 8);
+    REQUIRE(receiver.is_empty());
+    KoiPackedSender<uint32_t>(shm_name, SHM_SIZE).cleanup_shm();
+}
@@ -0,0 +1,126 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_packed_queue.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+
+TEST_CASE("KoiPackedQueue Send Recv", "[KoiPackedQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr size_t per_line = KoiPackedQueue<uint64_t>::messages_per_line();
+    // The 4 byte line header is padded to the alignment of `uint64_t`
+    STATIC_REQUIRE(per_line == (CACHE_LINE_BYTES - 8) / 8);
+
+    SECTION("Unflushed Messages Are Not Visible")
+    {
+        KoiPackedQueueRAII<uint64_t> queue(shm_name, SHM_SIZE);
+        REQUIRE(queue.is_empty());
+        REQUIRE(queue.send(1) == KoiQueueRet::OK);
+        REQUIRE(queue.send(2) == KoiQueueRet::OK);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+
+        queue.flush();
+        REQUIRE_FALSE(queue.is_empty());
+        REQUIRE(queue.recv() == 1);
+        REQUIRE(queue.recv() == 2);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+        // Flushing with no pending messages publishes nothing
+        queue.flush();
+        REQUIRE(queue.is_empty());
+    }
+
+    SECTION("Full Line Is Published")
+    {
+        KoiPackedQueueRAII<uint64_t> queue(shm_name, SHM_SIZE);
+        for (uint64_t i = 0; i < per_line - 1; ++i)
+        {
+            REQUIRE(queue.send(i) == KoiQueueRet::OK);
+        }
+        REQUIRE(queue.is_empty());
+        // The last message of the line publishes it without a `flush`
+        REQUIRE(queue.send(per_line - 1) == KoiQueueRet::OK);
+        REQUIRE_FALSE(queue.is_empty());
+        for (uint64_t i = 0; i < per_line; ++i)
+        {
+            REQUIRE(queue.recv() == i);
+        }
+        REQUIRE(queue.is_empty());
+    }
+
+    SECTION("Sender Sees The Receiver's Line")
+    {
+        // `is_empty` on the sender follows the receiver's line in the control block, not its own
+        KoiPackedQueueRAII<uint64_t> sender(shm_name, SHM_SIZE);
+        KoiPackedQueueRAII<uint64_t> receiver(shm_name, SHM_SIZE);
+        for (uint64_t i = 0; i < per_line; ++i)
+        {
+            REQUIRE(sender.send(i) == KoiQueueRet::OK);
+        }
+        for (uint64_t i = 0; i < per_line; ++i)
+        {
+            REQUIRE(receiver.recv() == i);
+        }
+        REQUIRE(sender.is_empty());
+        REQUIRE(sender.send(per_line) == KoiQueueRet::OK);
+        sender.flush();
+        REQUIRE_FALSE(sender.is_empty());
+        REQUIRE_FALSE(receiver.is_empty());
+        REQUIRE(receiver.recv() == per_line);
+        REQUIRE(sender.is_empty());
+    }
+
+    SECTION("Fill And Drain Over Several Laps")
+    {
+        // Four lines, mixing full lines with flushed partial lines
+        KoiPackedQueueRAII<uint32_t> queue(shm_name, 4 * CACHE_LINE_BYTES);
+        REQUIRE(queue.num_lines() == 4);
+        constexpr size_t per_line_32 = KoiPackedQueue<uint32_t>::messages_per_line();
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        for (size_t lap = 0; lap < 5; ++lap)
+        {
+            // Three full lines and one partial line fill the queue
+            for (size_t i = 0; i < 3 * per_line_32 + 5; ++i)
+            {
+                REQUIRE(queue.send(sent++) == KoiQueueRet::OK);
+            }
+            queue.flush();
+            // Every line is published and not yet received
+            REQUIRE(queue.send(sent) == KoiQueueRet::QUEUE_FULL);
+            while (auto message = queue.recv())
+            {
+                REQUIRE(message.value() == received++);
+            }
+            REQUIRE(received == sent);
+        }
+    }
+}
+
+TEST_CASE("KoiPackedQueue Metadata", "[KoiPackedQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Buffer Size")
+    {
+        // Rounded down to whole lines
+        KoiPackedQueueRAII<uint16_t> queue(shm_name, 3 * CACHE_LINE_BYTES + 1);
+        REQUIRE(queue.user_shm_size() == 3 * CACHE_LINE_BYTES);
+        REQUIRE(queue.num_lines() == 3);
+        STATIC_REQUIRE(KoiPackedQueue<uint16_t>::messages_per_line() == (CACHE_LINE_BYTES - 4) / 2);
+    }
+
+    SECTION("Minimum Buffer Size")
+    {
+        REQUIRE_THROWS_AS(KoiPackedQueueRAII<uint16_t>(shm_name, CACHE_LINE_BYTES - 1), std::invalid_argument);
+    }
+
+    SECTION("Mismatched Attach")
+    {
+        KoiPackedQueueRAII<uint32_t> queue(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(KoiPackedQueueRAII<uint32_t>(shm_name, SHM_SIZE / 2), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiPackedQueueRAII<uint64_t>(shm_name, SHM_SIZE), std::runtime_error);
+    }
+}
@@ -0,0 +1,85 @@
+#include "koi_snapshot.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+#include <sys/wait.h>
+#include <vector>
+
+using namespace koi;
+
+// Spans several cache lines, so a torn read would mix the fields of different publishes
+struct BookTop
+{
+    uint64_t seq;
+    uint64_t levels[31];
+};
+
+TEST_CASE("Snapshot Concurrent Readers", "[KoiSnapshot][MultiProcess]")
+{
+    // Several reader processes read while the writer publishes. Every read must be untorn, and the values a
+    // reader sees must never go back in time.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_readers = 3;
+    constexpr uint64_t num_publishes = 100000;
+
+    KoiSnapshotSender<BookTop> sender(shm_name);
+    std::vector<pid_t> reader_pids;
+    for (uint32_t reader = 0; reader < num_readers; ++reader)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is a reader. Stops once it sees the last value
+            KoiSnapshotReceiver<BookTop> receiver(shm_name);
+            uint64_t last_seq = 0;
+            while (last_seq + 1 < num_publishes)
+            {
+                std::optional<BookTop> top = receiver.read();
+                if (!top.has_value())
+                {
+                    continue;
+                }
+                for (uint64_t level : top->levels)
+                {
+                    if (level != top->seq)
+                    {
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                if (top->seq < last_seq)
+                {
+                    exit(EXIT_FAILURE);
+                }
+                last_seq = top->seq;
+            }
+            exit(EXIT_SUCCESS);
+        }
+        reader_pids.push_back(pid);
+    }
+
+    // Parent process is the writer
+    for (uint64_t i = 0; i < num_publishes; ++i)
+    {
+        BookTop top{.seq = i};
+        std::fill(std::begin(top.levels), std::end(top.levels), i);
+        sender.publish(top);
+    }
+    REQUIRE(sender.version() == num_publishes);
+
+    for (pid_t pid : reader_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    sender.cleanup_shm();
+}
@@ -0,0 +1,70 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_snapshot.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+
+struct Limits
+{
+    uint64_t max_position;
+    double max_notional;
+};
+
+TEST_CASE("KoiSnapshot Publish Read", "[KoiSnapshot][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Latest Value")
+    {
+        KoiSnapshotRAII<Limits> snapshot(shm_name);
+        REQUIRE(snapshot.version() == 0);
+        REQUIRE_FALSE(snapshot.read().has_value());
+
+        snapshot.publish(Limits{100, 1e6});
+        snapshot.publish(Limits{200, 2e6});
+        REQUIRE(snapshot.version() == 2);
+        // Only the latest value is kept, and reading does not consume it
+        for (size_t i = 0; i < 2; ++i)
+        {
+            std::optional<Limits> limits = snapshot.read();
+            REQUIRE(limits.has_value());
+            REQUIRE(limits->max_position == 200);
+            REQUIRE(limits->max_notional == 2e6);
+        }
+    }
+
+    SECTION("Read If Newer")
+    {
+        KoiSnapshotRAII<uint64_t> snapshot(shm_name);
+        uint64_t last_version = 0;
+        REQUIRE_FALSE(snapshot.read_if_newer(last_version).has_value());
+        snapshot.publish(1);
+        snapshot.publish(2);
+        REQUIRE(snapshot.read_if_newer(last_version) == 2);
+        REQUIRE(last_version == 2);
+        REQUIRE_FALSE(snapshot.read_if_newer(last_version).has_value());
+        snapshot.publish(3);
+        REQUIRE(snapshot.read_if_newer(last_version) == 3);
+        REQUIRE(last_version == 3);
+    }
+
+    SECTION("Shared Between Handles")
+    {
+        // A reader attaching later reads the value published before it attached
+        KoiSnapshotRAII<uint64_t> writer(shm_name);
+        writer.publish(42);
+        KoiSnapshotRAII<uint64_t> reader(shm_name);
+        REQUIRE(reader.version() == 1);
+        REQUIRE(reader.read() == 42);
+        writer.publish(43);
+        REQUIRE(reader.read() == 43);
+    }
+
+    SECTION("Mismatched Attach")
+    {
+        KoiSnapshotRAII<uint64_t> snapshot(shm_name);
+        REQUIRE_THROWS_AS(KoiSnapshotRAII<Limits>(shm_name), std::runtime_error);
+        REQUIRE_NOTHROW(KoiSnapshotRAII<double>(shm_name));
+    }
+}
@@ -0,0 +1,141 @@
+#include "koi_spmc_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdint>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace koi;
+
+TEST_CASE("Spmc Send Recv Polling", "[KoiSpmcQueue][MultiProcess]")
+{
+    // Several consumer processes compete for the messages of one producer, which retries when the queue is full.
+    // Each consumer reports the messages it received through a pipe. Every message must be received exactly once,
+    // and each consumer must receive its messages in order.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr uint32_t num_consumers = 4;
+    constexpr uint32_t num_msgs = 20000;
+    // Sent after the messages, one per consumer, so each consumer stops once it receives one
+    constexpr uint32_t stop = UINT32_MAX;
+
+    // Create the queue before forking so all processes attach to the same segment
+    KoiSpmcSender<uint32_t> sender(shm_name, SHM_SIZE);
+    std::vector<pid_t> consumer_pids;
+    std::vector<int> result_fds;
+    for (uint32_t consumer = 0; consumer < num_consumers; ++consumer)
+    {
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            // Child process is a consumer
+            close(fds[0]);
+            KoiSpmcReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+            std::vector<uint32_t> received;
+            while (true)
+            {
+                std::optional<uint32_t> message = receiver.recv();
+                if (!message.has_value())
+                {
+                    continue;
+                }
+                if (message.value() == stop)
+                {
+                    break;
+                }
+                received.push_back(message.value());
+            }
+            const uint32_t count = received.size();
+            bool ok = write(fds[1], &count, sizeof(count)) == sizeof(count);
+            const ssize_t bytes = count * sizeof(uint32_t);
+            ok = ok && write(fds[1], received.data(), bytes) == bytes;
+            close(fds[1]);
+            exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        close(fds[1]);
+        consumer_pids.push_back(pid);
+        result_fds.push_back(fds[0]);
+    }
+
+    // Parent process is the producer
+    for (uint32_t i = 0; i < num_msgs; ++i)
+    {
+        while (sender.send(i) != KoiQueueRet::OK)
+        {
+        }
+    }
+    for (uint32_t consumer = 0; consumer < num_consumers; ++consumer)
+    {
+        while (sender.send(stop) != KoiQueueRet::OK)
+        {
+        }
+    }
+
+    std::vector<uint32_t> times_received(num_msgs, 0);
+    for (int fd : result_fds)
+    {
+        // Read the consumer's results before waiting for it, so it does not block on a full pipe
+        uint32_t count = 0;
+        REQUIRE(read(fd, &count, sizeof(count)) == sizeof(count));
+        std::vector<uint32_t> received(count);
+        size_t bytes_read = 0;
+        while (bytes_read < count * sizeof(uint32_t))
+        {
+            const ssize_t ret = read(fd, reinterpret_cast<char *>(received.data()) + bytes_read, count * sizeof(uint32_t) - bytes_read);
+            REQUIRE(ret > 0);
+            bytes_read += ret;
+        }
+        close(fd);
+        for (size_t i = 0; i < received.size(); ++i)
+        {
+            REQUIRE(received[i] < num_msgs);
+            REQUIRE((i == 0 || received[i - 1] < received[i]));
+            ++times_received[received[i]];
+        }
+    }
+    for (uint32_t i = 0; i < num_msgs; ++i)
+    {
+        REQUIRE(times_received[i] == 1);
+    }
+    REQUIRE(sender.is_empty());
+
+    for (pid_t pid : consumer_pids)
+    {
+        int status = 0;
+        REQUIRE(waitpid(pid, &status, 0) != -1);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    sender.cleanup_shm();
+}
+
+TEST_CASE("Spmc Sender Resumes", "[KoiSpmcQueue][MultiProcess]")
+{
+    // A later sender picks up from the position of the previous one
+    const std::string shm_name = generate_unique_shm_name();
+    KoiSpmcReceiver<uint32_t> receiver(shm_name, SHM_SIZE);
+    {
+        KoiSpmcSender<uint32_t> sender(shm_name, SHM_SIZE);
+        REQUIRE(sender.send(0) == KoiQueueRet::OK);
+        REQUIRE(sender.send(1) == KoiQueueRet::OK);
+    }
+    KoiSpmcSender<uint32_t> sender(shm_name, SHM_SIZE);
+    REQUIRE(sender.send(2) == KoiQueueRet::OK);
+    REQUIRE(receiver.size() == 3);
+    REQUIRE(receiver.recv() == 0);
+    REQUIRE(receiver.recv() == 1);
+    REQUIRE(receiver.recv() == 2);
+    REQUIRE(receiver.is_empty());
+    sender.cleanup_shm();
+}
@@ -0,0 +1,101 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_spmc_queue.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstdint>
+
+// A message of exactly one cache line
+struct Line
+{
+    char data[CACHE_LINE_BYTES];
+};
+
+TEST_CASE("KoiSpmcQueue Send Recv", "[KoiSpmcQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Send Recv Single")
+    {
+        KoiSpmcQueueRAII<uint64_t> queue(shm_name, SHM_SIZE);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+
+        REQUIRE(queue.send(42) == KoiQueueRet::OK);
+        REQUIRE(queue.size() == 1);
+        REQUIRE(queue.recv() == 42);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv().has_value());
+    }
+
+    SECTION("Fill And Drain Over Several Laps")
+    {
+        // A capacity which is not a power of 2
+        KoiSpmcQueueRAII<uint32_t> queue(shm_name, 5 * KoiSpmcQueue<uint32_t>::message_block_sz_bytes());
+        REQUIRE(queue.capacity() == 5);
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        for (size_t lap = 0; lap < 7; ++lap)
+        {
+            while (queue.send(sent) == KoiQueueRet::OK)
+            {
+                ++sent;
+            }
+            REQUIRE(queue.size() == queue.capacity());
+            // Free one slot, so the queue wraps at a different slot on each lap
+            REQUIRE(queue.recv() == received++);
+            REQUIRE(queue.send(sent++) == KoiQueueRet::OK);
+            REQUIRE(queue.send(sent) == KoiQueueRet::QUEUE_FULL);
+            while (auto message = queue.recv())
+            {
+                REQUIRE(message.value() == received++);
+            }
+            REQUIRE(received == sent);
+            REQUIRE(queue.is_empty());
+        }
+    }
+
+    SECTION("Competing Receivers")
+    {
+        // Two receivers in one process share the read position in the segment, so each message is received once
+        KoiSpmcQueueRAII<uint32_t> queue(shm_name, SHM_SIZE);
+        KoiSpmcQueueRAII<uint32_t> other(shm_name, SHM_SIZE);
+        REQUIRE(queue.send(1) == KoiQueueRet::OK);
+        REQUIRE(queue.send(2) == KoiQueueRet::OK);
+        REQUIRE(queue.send(3) == KoiQueueRet::OK);
+        REQUIRE(other.size() == 3);
+        REQUIRE(other.recv() == 1);
+        REQUIRE(queue.recv() == 2);
+        REQUIRE(other.recv() == 3);
+        REQUIRE_FALSE(queue.recv().has_value());
+        REQUIRE(queue.is_empty());
+    }
+}
+
+TEST_CASE("KoiSpmcQueue Metadata", "[KoiSpmcQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Message Block Size")
+    {
+        // The 8 byte sequence header and the message are rounded up to the nearest cache line
+        STATIC_REQUIRE(KoiSpmcQueue<char>::message_block_sz_bytes() == CACHE_LINE_BYTES);
+        STATIC_REQUIRE(KoiSpmcQueue<Line>::message_block_sz_bytes() == 2 * CACHE_LINE_BYTES);
+    }
+
+    SECTION("Buffer Size")
+    {
+        // Rounded down to whole blocks
+        KoiSpmcQueueRAII<char> queue(shm_name, 3 * CACHE_LINE_BYTES + 1);
+        REQUIRE(queue.user_shm_size() == 3 * CACHE_LINE_BYTES);
+        REQUIRE(queue.capacity() == 3);
+        REQUIRE_THROWS_AS(KoiSpmcQueueRAII<char>(generate_unique_shm_name(), CACHE_LINE_BYTES - 1), std::invalid_argument);
+    }
+
+    SECTION("Mismatched Attach")
+    {
+        KoiSpmcQueueRAII<char> queue(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(KoiSpmcQueueRAII<char>(shm_name, SHM_SIZE / 2), std::runtime_error);
+        REQUIRE_THROWS_AS(KoiSpmcQueueRAII<Line>(shm_name, SHM_SIZE), std::runtime_error);
+    }
+}
@@ -0,0 +1,76 @@
+#include "koi_var_queue.hh"
+#include "test_utils.hh"
+#include "receiver.hh"
+#include "sender.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <sys/wait.h>
+#include <vector>
+
+using namespace koi;
+
+TEST_CASE("Variable Size Send Recv Polling", "[KoiVarQueue][MultiProcess]")
+{
+    // The sender sends messages of varying sizes, retrying when the queue is full, while the receiver
+    // polls the queue. The messages span several laps of the ring buffer so wrap records are exercised.
+    const std::string shm_name = generate_unique_shm_name();
+    constexpr size_t num_msgs = 2000;
+    const std::vector<size_t> sizes = {40, 3 * 1024, 8, 200, 1000};
+    // Each message should certainly be sent within 500ms
+    constexpr std::chrono::milliseconds timeout_duration(500);
+
+    // Create the queue before forking so both processes attach to the same segment
+    KoiVarSender sender(shm_name, SHM_SIZE);
+    pid_t receiver_pid = fork();
+    if (receiver_pid == -1)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (receiver_pid == 0)
+    {
+        // Child process is receiver
+        KoiVarReceiver queue(shm_name, SHM_SIZE);
+        std::vector<std::byte> buffer(SHM_SIZE);
+        for (size_t i = 0; i < num_msgs; ++i)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            std::optional<size_t> length;
+            do
+            {
+                length = queue.recv(buffer);
+                if (std::chrono::steady_clock::now() - start_time > timeout_duration)
+                {
+                    // Timeout error, fail test case
+                    exit(EXIT_FAILURE);
+                }
+            } while (!length.has_value());
+            if (length.value() != sizes[i % sizes.size()] ||
+                (length.value() > 0 && buffer[length.value() - 1] != static_cast<std::byte>(i)))
+            {
+                exit(EXIT_FAILURE);
+            }
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    // Parent process is sender
+    for (size_t i = 0; i < num_msgs; ++i)
+    {
+        std::vector<std::byte> msg(sizes[i % sizes.size()], static_cast<std::byte>(i));
+        while (sender.send(msg) != KoiQueueRet::OK)
+        {
+        }
+    }
+
+    int status = 0;
+    if (waitpid(receiver_pid, &status, 0) == -1)
+    {
+        perror("waitpid");
+        exit(EXIT_FAILURE);
+    }
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+    sender.cleanup_shm();
+}
@@ -0,0 +1,189 @@
+#define CATCH_CONFIG_MAIN
+#include "koi_var_queue.hh"
+#include "test_utils.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstring>
+#include <vector>
+
+// Returns a message of `size` bytes where every byte is `fill`
+static std::vector<std::byte> make_message(size_t size, unsigned char fill)
+{
+    return std::vector<std::byte>(size, static_cast<std::byte>(fill));
+}
+
+TEST_CASE("KoiVarQueue Send Recv", "[KoiVarQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    std::vector<std::byte> buffer(SHM_SIZE);
+
+    SECTION("Send Recv Single")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+        REQUIRE(queue.is_empty());
+
+        auto msg = make_message(40, 7);
+        REQUIRE(queue.send(msg) == KoiQueueRet::OK);
+        REQUIRE_FALSE(queue.is_empty());
+        REQUIRE(queue.curr_queue_sz_bytes() == CACHE_LINE_BYTES);
+
+        auto length = queue.recv(buffer);
+        REQUIRE(length.has_value());
+        REQUIRE(length.value() == msg.size());
+        REQUIRE(std::memcmp(buffer.data(), msg.data(), msg.size()) == 0);
+        REQUIRE(queue.is_empty());
+        REQUIRE_FALSE(queue.recv(buffer).has_value());
+    }
+
+    SECTION("Mixed Sizes")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+
+        const std::vector<size_t> sizes = {0, 1, 40, CACHE_LINE_BYTES, 3 * 1024, 200};
+        size_t queued_bytes = 0;
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            REQUIRE(queue.send(make_message(sizes[i], static_cast<unsigned char>(i))) == KoiQueueRet::OK);
+            queued_bytes += KoiVarQueue::record_block_sz(sizes[i]);
+        }
+        // Records are packed at cache line granularity rather than padded to the largest message
+        REQUIRE(queue.curr_queue_sz_bytes() == queued_bytes);
+
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            auto length = queue.recv(buffer);
+            REQUIRE(length.has_value());
+            REQUIRE(length.value() == sizes[i]);
+            for (size_t j = 0; j < sizes[i]; ++j)
+            {
+                REQUIRE(buffer[j] == static_cast<std::byte>(i));
+            }
+        }
+        REQUIRE(queue.is_empty());
+    }
+
+    SECTION("Peek Release")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+
+        REQUIRE_FALSE(queue.peek().has_value());
+        REQUIRE(queue.send(make_message(100, 1)) == KoiQueueRet::OK);
+        REQUIRE(queue.send(make_message(300, 2)) == KoiQueueRet::OK);
+
+        auto view = queue.peek();
+        REQUIRE(view.has_value());
+        REQUIRE(view->size() == 100);
+        REQUIRE((*view)[99] == std::byte{1});
+        queue.release();
+
+        view = queue.peek();
+        REQUIRE(view.has_value());
+        REQUIRE(view->size() == 300);
+        REQUIRE((*view)[0] == std::byte{2});
+        queue.release();
+        REQUIRE(queue.is_empty());
+    }
+}
+
+TEST_CASE("KoiVarQueue Wrap Around", "[KoiVarQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+    std::vector<std::byte> buffer(SHM_SIZE);
+
+    SECTION("Alternating Send Recv")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+
+        // Sizes which do not divide the ring buffer force wrap records at the end of the ring buffer
+        const std::vector<size_t> sizes = {40, 3000, 700, 5, 1500};
+        for (size_t i = 0; i < 200; ++i)
+        {
+            size_t size = sizes[i % sizes.size()];
+            REQUIRE(queue.send(make_message(size, static_cast<unsigned char>(i))) == KoiQueueRet::OK);
+            auto length = queue.recv(buffer);
+            REQUIRE(length.has_value());
+            REQUIRE(length.value() == size);
+            if (size > 0)
+            {
+                REQUIRE(buffer[0] == static_cast<std::byte>(i));
+                REQUIRE(buffer[size - 1] == static_cast<std::byte>(i));
+            }
+        }
+        REQUIRE(queue.is_empty());
+    }
+
+    SECTION("Fill And Drain")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+
+        for (size_t lap = 0; lap < 4; ++lap)
+        {
+            size_t num_sent = 0;
+            while (queue.send(make_message(1000, static_cast<unsigned char>(num_sent))) == KoiQueueRet::OK)
+            {
+                num_sent++;
+            }
+            REQUIRE(num_sent > 0);
+            // One cache line is always kept free for the header of the following record
+            REQUIRE(queue.curr_queue_sz_bytes() <= SHM_SIZE - CACHE_LINE_BYTES);
+
+            for (size_t i = 0; i < num_sent; ++i)
+            {
+                auto length = queue.recv(buffer);
+                REQUIRE(length.has_value());
+                REQUIRE(length.value() == 1000);
+                REQUIRE(buffer[0] == static_cast<std::byte>(i));
+            }
+            REQUIRE_FALSE(queue.recv(buffer).has_value());
+            REQUIRE(queue.is_empty());
+        }
+    }
+
+    SECTION("Max Message Size")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+
+        // A small record first so the max size record always needs a wrap record
+        REQUIRE(queue.send(make_message(1, 1)) == KoiQueueRet::OK);
+        REQUIRE(queue.send(make_message(queue.max_message_sz(), 2)) == KoiQueueRet::QUEUE_FULL);
+        REQUIRE(queue.recv(buffer).value() == 1);
+        REQUIRE(queue.send(make_message(queue.max_message_sz(), 2)) == KoiQueueRet::OK);
+        REQUIRE(queue.recv(buffer).value() == queue.max_message_sz());
+        REQUIRE(queue.is_empty());
+    }
+}
+
+TEST_CASE("KoiVarQueue Error Handling", "[KoiVarQueue][SingleThread]")
+{
+    const std::string shm_name = generate_unique_shm_name();
+
+    SECTION("Message Too Large")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(queue.send(make_message(queue.max_message_sz() + 1, 0)), std::invalid_argument);
+    }
+
+    SECTION("Buffer Too Small")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+        REQUIRE(queue.send(make_message(64, 3)) == KoiQueueRet::OK);
+
+        std::vector<std::byte> small_buffer(63);
+        REQUIRE_THROWS_AS(queue.recv(small_buffer), std::length_error);
+        // The message stays queued
+        std::vector<std::byte> buffer(64);
+        REQUIRE(queue.recv(buffer).value() == 64);
+    }
+
+    SECTION("Valid byte buffer sizes")
+    {
+        REQUIRE_THROWS_AS(KoiVarQueueRAII(shm_name, CACHE_LINE_BYTES), std::invalid_argument);
+        REQUIRE_THROWS_AS(KoiVarQueueRAII(shm_name, CACHE_LINE_BYTES * 6), std::invalid_argument);
+    }
+
+    SECTION("Mismatched size on attach")
+    {
+        KoiVarQueueRAII queue(shm_name, SHM_SIZE);
+        REQUIRE_THROWS_AS(KoiVarQueueRAII(shm_name, SHM_SIZE * 2), std::runtime_error);
+    }
+}